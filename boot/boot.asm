@@ -6,6 +6,10 @@ disk_error_kernel:
 
 %include "kernel_sectors.inc"
 
+E820_MAP equ 0x500      ; Mapa de memoria para el kernel (include/e820.h)
+E820_MAX equ 32
+SMAP     equ 0x534D4150 ; 'SMAP'
+
 start:
     cli
     xor ax, ax
@@ -31,6 +35,35 @@ start:
     or al, 00000010b
     out 0x92, al
 
+    ; Mapa de memoria E820: número de entradas en E820_MAP y las entradas
+    ; de 24 bytes detrás. Con error o sin soporte queda a cero y el kernel
+    ; supone lo mínimo.
+    xor ax, ax
+    mov es, ax
+    mov di, E820_MAP + 4
+    xor ebx, ebx
+    xor bp, bp
+.e820_next:
+    mov eax, 0xE820
+    mov edx, SMAP
+    mov ecx, 24
+    mov dword [es:di + 20], 1 ; Atributo ACPI 3.0 válido si el BIOS da 20 bytes
+    int 0x15
+    jc .e820_done
+    cmp eax, SMAP
+    jne .e820_done
+    jcxz .e820_skip           ; Entrada vacía
+    inc bp
+    add di, 24
+.e820_skip:
+    test ebx, ebx             ; Última entrada
+    jz .e820_done
+    cmp bp, E820_MAX
+    jb .e820_next
+.e820_done:
+    mov word [E820_MAP], bp
+    mov word [E820_MAP + 2], 0
+
     ; Saltar al kernel en modo protegido
     jmp 0x0000:kernel_entry
 
@@ -0,0 +1,606 @@
+#include "bcache.h"
+#include "blkdev.h"
+#include "fsmem.h"
+#include "string.h"
+
+// Dispositivo del volumen (el primero registrado en la capa de bloques)
+static blkdev_t *bcache_dev;
+
+static bcache_buf_t bcache_bufs[BCACHE_MAX_BUFS];
+static bcache_buf_t *bcache_hash[BCACHE_HASH_SIZE];
+static uint32_t bcache_nbufs;
+
+// Tamaño de bloque del volumen y sectores del dispositivo por bloque
+static uint32_t bcache_bsize;
+static uint32_t bcache_spb;
+
+// Lista LRU: lru_head es el más reciente, lru_tail el candidato a desalojo
+static bcache_buf_t *lru_head;
+static bcache_buf_t *lru_tail;
+
+// Lecturas anticipadas en vuelo: la racha va directa a los buffers, un
+// fragmento por bloque, en una sola petición
+typedef struct
+{
+    bcache_buf_t *bufs[BCACHE_RA_MAX];
+    uint32_t count;
+    volatile uint8_t busy;
+    blk_request_t req;
+} bcache_ra_req_t;
+
+static bcache_ra_req_t bcache_ra_reqs[BCACHE_RA_INFLIGHT];
+static uint32_t bcache_ra_max;
+
+static bcache_stats_t bcache_stats;
+static uint8_t bcache_initialized = 0;
+
+// --- Acceso al dispositivo ---
+// Lo que el dispositivo no puede leer (fuera de su capacidad) se lee como ceros
+static void bcache_dev_read(uint32_t block_num, uint32_t count, void *buffer)
+{
+    bcache_stats.dev_reads++;
+    if (!bcache_dev ||
+        blkdev_read(bcache_dev, (uint64_t)block_num * bcache_spb, count * bcache_spb, buffer) != 0)
+        memset(buffer, 0, count * bcache_bsize);
+}
+
+// -1 si el dispositivo no aceptó la escritura: quien la pidió conserva los datos
+static int bcache_dev_write(uint32_t block_num, uint32_t count, const void *buffer)
+{
+    bcache_stats.dev_writes++;
+    if (bcache_dev &&
+        blkdev_write(bcache_dev, (uint64_t)block_num * bcache_spb, count * bcache_spb, buffer) != 0)
+    {
+        bcache_stats.write_errors++;
+        return -1;
+    }
+    return 0;
+}
+
+// --- Lectura anticipada asíncrona ---
+// Aviso de fin del driver; puede llegar desde la interrupción, así que solo
+// marca los buffers (la LRU y la tabla hash solo las toca el hilo principal)
+static void bcache_ra_done(void *ctx, int status)
+{
+    bcache_ra_req_t *req = (bcache_ra_req_t *)ctx;
+    for (uint32_t i = 0; i < req->count; i++)
+    {
+        req->bufs[i]->io_error = status != 0;
+        req->bufs[i]->loading = 0;
+    }
+    req->busy = 0;
+}
+
+static bcache_ra_req_t *bcache_ra_req_get(void)
+{
+    for (;;)
+    {
+        for (uint32_t i = 0; i < BCACHE_RA_INFLIGHT; i++)
+        {
+            if (!bcache_ra_reqs[i].busy)
+                return &bcache_ra_reqs[i];
+        }
+        blkdev_wait(bcache_dev);
+    }
+}
+
+// Lee block_num.. en los buffers bufs (marcados loading). Si el dispositivo
+// acepta la petición, los buffers se completan al llegar el aviso.
+static void bcache_ra_read(uint32_t block_num, bcache_buf_t **bufs, uint32_t n)
+{
+    if (bcache_dev)
+    {
+        bcache_ra_req_t *ra = bcache_ra_req_get();
+        blk_request_t *req = &ra->req;
+        for (uint32_t j = 0; j < n; j++)
+        {
+            ra->bufs[j] = bufs[j];
+            req->iov[j].buf = bufs[j]->data;
+            req->iov[j].bytes = bcache_bsize;
+        }
+        ra->count = n;
+        ra->busy = 1;
+
+        req->pooled = 0;
+        req->write = 0;
+        req->lba = (uint64_t)block_num * bcache_spb;
+        req->count = n * bcache_spb;
+        req->iovcnt = n;
+        req->done = bcache_ra_done;
+        req->ctx = ra;
+        if (blkdev_submit(bcache_dev, req) == 0)
+        {
+            bcache_stats.dev_reads++;
+            bcache_stats.ra_async++;
+            return;
+        }
+        ra->busy = 0;
+    }
+
+    // Sin dispositivo o petición que no acepta: bloque a bloque
+    for (uint32_t j = 0; j < n; j++)
+    {
+        bcache_dev_read(block_num + j, 1, bufs[j]->data);
+        bufs[j]->loading = 0;
+    }
+}
+
+// Espera a que llegue el contenido de un buffer anticipado
+static void bcache_wait_loaded(bcache_buf_t *buf)
+{
+    if (!buf->loading && !buf->io_error)
+        return;
+
+    if (buf->loading)
+    {
+        bcache_stats.io_waits++;
+        while (buf->loading)
+            blkdev_wait(bcache_dev);
+    }
+    if (buf->io_error)
+    {
+        buf->io_error = 0;
+        bcache_dev_read(buf->block_num, 1, buf->data);
+    }
+}
+
+// Espera a todas las lecturas anticipadas (antes de reutilizar su memoria)
+static void bcache_ra_drain(void)
+{
+    for (uint32_t i = 0; i < BCACHE_RA_INFLIGHT; i++)
+    {
+        while (bcache_ra_reqs[i].busy)
+            blkdev_wait(bcache_dev);
+    }
+}
+
+// --- Lista LRU ---
+static void lru_unlink(bcache_buf_t *buf)
+{
+    if (buf->lru_prev)
+        buf->lru_prev->lru_next = buf->lru_next;
+    else
+        lru_head = buf->lru_next;
+
+    if (buf->lru_next)
+        buf->lru_next->lru_prev = buf->lru_prev;
+    else
+        lru_tail = buf->lru_prev;
+
+    buf->lru_prev = buf->lru_next = NULL;
+}
+
+static void lru_push_front(bcache_buf_t *buf)
+{
+    buf->lru_prev = NULL;
+    buf->lru_next = lru_head;
+    if (lru_head)
+        lru_head->lru_prev = buf;
+    lru_head = buf;
+    if (!lru_tail)
+        lru_tail = buf;
+}
+
+// --- Tabla hash ---
+static inline uint32_t bcache_hash_of(uint32_t block_num)
+{
+    return block_num & (BCACHE_HASH_SIZE - 1);
+}
+
+static void hash_remove(bcache_buf_t *buf)
+{
+    bcache_buf_t **pp = &bcache_hash[bcache_hash_of(buf->block_num)];
+    while (*pp)
+    {
+        if (*pp == buf)
+        {
+            *pp = buf->hash_next;
+            break;
+        }
+        pp = &(*pp)->hash_next;
+    }
+    buf->hash_next = NULL;
+}
+
+static void hash_insert(bcache_buf_t *buf)
+{
+    uint32_t h = bcache_hash_of(buf->block_num);
+    buf->hash_next = bcache_hash[h];
+    bcache_hash[h] = buf;
+}
+
+static bcache_buf_t *hash_lookup(uint32_t block_num)
+{
+    for (bcache_buf_t *b = bcache_hash[bcache_hash_of(block_num)]; b; b = b->hash_next)
+    {
+        if (b->valid && b->block_num == block_num)
+            return b;
+    }
+    return NULL;
+}
+
+// Primer uso de un bloque traído por lectura anticipada
+static inline void bcache_touch(bcache_buf_t *buf)
+{
+    bcache_wait_loaded(buf);
+    if (buf->prefetched)
+    {
+        buf->prefetched = 0;
+        bcache_stats.ra_hits++;
+    }
+}
+
+// --- Gestión de buffers ---
+uint32_t bcache_mem_size(uint32_t block_size)
+{
+    return MIN(BCACHE_MAX_BUFS, BCACHE_MEM_SIZE / block_size) * block_size;
+}
+
+void bcache_quiesce(void)
+{
+    bcache_ra_drain();
+    bcache_initialized = 0;
+}
+
+int bcache_init(uint32_t block_size)
+{
+    // Ningún DMA puede seguir escribiendo en los buffers anteriores
+    bcache_ra_drain();
+
+    uint32_t nbufs = bcache_mem_size(block_size) / block_size;
+    uint8_t *data = fsmem_alloc(nbufs * block_size);
+    if (!data)
+        return -1;
+
+    bcache_dev = blkdev_root();
+    bcache_bsize = block_size;
+    bcache_spb = block_size / BLK_SECTOR_SIZE;
+    bcache_nbufs = nbufs;
+    bcache_ra_max = MIN(BCACHE_RA_MAX, BCACHE_RA_BYTES / block_size);
+
+    memset(bcache_hash, 0, sizeof(bcache_hash));
+    lru_head = lru_tail = NULL;
+    for (uint32_t i = 0; i < nbufs; i++)
+    {
+        bcache_bufs[i].data = data + i * block_size;
+        bcache_bufs[i].valid = 0;
+        bcache_bufs[i].dirty = 0;
+        bcache_bufs[i].prefetched = 0;
+        bcache_bufs[i].pinned = 0;
+        bcache_bufs[i].loading = 0;
+        bcache_bufs[i].io_error = 0;
+        bcache_bufs[i].refcount = 0;
+        bcache_bufs[i].hash_next = NULL;
+        lru_push_front(&bcache_bufs[i]);
+    }
+    bcache_initialized = 1;
+    return 0;
+}
+
+uint32_t bcache_block_size(void)
+{
+    return bcache_bsize;
+}
+
+// Busca el buffer libre menos usado recientemente y lo desvincula de su bloque
+static bcache_buf_t *bcache_evict(void)
+{
+    for (bcache_buf_t *b = lru_tail; b; b = b->lru_prev)
+    {
+        if (b->refcount != 0 || b->pinned || b->loading)
+            continue;
+
+        if (b->valid)
+        {
+            b->io_error = 0;
+            // Si no se puede escribir sigue sucio en la caché y se prueba
+            // con el siguiente candidato
+            if (b->dirty)
+            {
+                if (bcache_dev_write(b->block_num, 1, b->data) != 0)
+                    continue;
+                bcache_stats.writebacks++;
+                b->dirty = 0;
+            }
+            if (b->prefetched)
+                bcache_stats.ra_wasted++;
+            hash_remove(b);
+            b->valid = 0;
+            b->prefetched = 0;
+            bcache_stats.evictions++;
+        }
+        return b;
+    }
+    return NULL;
+}
+
+// Devuelve el buffer de block_num con una referencia; *hit indica si ya estaba
+static bcache_buf_t *bcache_lookup(uint32_t block_num, int *hit)
+{
+    if (!bcache_initialized)
+        bcache_init(FS_MIN_BLOCK_SIZE);
+
+    bcache_buf_t *buf = hash_lookup(block_num);
+    if (buf)
+    {
+        bcache_stats.hits++;
+        bcache_touch(buf);
+        *hit = 1;
+    }
+    else
+    {
+        buf = bcache_evict();
+        if (!buf)
+            return NULL;
+        bcache_stats.misses++;
+        buf->block_num = block_num;
+        buf->valid = 1;
+        buf->dirty = 0;
+        hash_insert(buf);
+        *hit = 0;
+    }
+
+    buf->refcount++;
+    lru_unlink(buf);
+    lru_push_front(buf);
+    return buf;
+}
+
+bcache_buf_t *bcache_get(uint32_t block_num)
+{
+    int hit;
+    bcache_buf_t *buf = bcache_lookup(block_num, &hit);
+    if (buf && !hit)
+        bcache_dev_read(block_num, 1, buf->data);
+    return buf;
+}
+
+bcache_buf_t *bcache_get_zero(uint32_t block_num)
+{
+    int hit;
+    bcache_buf_t *buf = bcache_lookup(block_num, &hit);
+    if (buf)
+        memset(buf->data, 0, bcache_bsize);
+    return buf;
+}
+
+void bcache_mark_dirty(bcache_buf_t *buf)
+{
+    if (buf)
+        buf->dirty = 1;
+}
+
+void bcache_release(bcache_buf_t *buf)
+{
+    if (buf && buf->refcount > 0)
+        buf->refcount--;
+}
+
+void bcache_pin(bcache_buf_t *buf)
+{
+    if (buf)
+        buf->pinned = 1;
+}
+
+void bcache_unpin(uint32_t block_num)
+{
+    bcache_buf_t *buf = hash_lookup(block_num);
+    if (buf)
+        buf->pinned = 0;
+}
+
+// --- E/S directa de rachas ---
+// Los bloques que están en caché (posiblemente más nuevos que el disco) se
+// copian desde ella; cada subracha que falta es una sola petición.
+int bcache_read_blocks(uint32_t start, uint32_t count, void *buffer)
+{
+    if (!bcache_initialized)
+        bcache_init(FS_MIN_BLOCK_SIZE);
+
+    uint8_t *out = (uint8_t *)buffer;
+    uint32_t i = 0;
+    while (i < count)
+    {
+        bcache_buf_t *b = hash_lookup(start + i);
+        if (b)
+        {
+            bcache_stats.hits++;
+            bcache_touch(b);
+            memcpy(out + i * bcache_bsize, b->data, bcache_bsize);
+            i++;
+            continue;
+        }
+
+        uint32_t n = 1;
+        while (i + n < count && !hash_lookup(start + i + n))
+            n++;
+        bcache_dev_read(start + i, n, out + i * bcache_bsize);
+        bcache_stats.direct_blocks += n;
+        i += n;
+    }
+    return 0;
+}
+
+// Escribe la racha directamente; las copias en caché se actualizan para que
+// no queden obsoletas ni se reescriban al desalojarlas. Si la escritura
+// falla no se tocan: -1 y la caché sigue como estaba.
+int bcache_write_blocks(uint32_t start, uint32_t count, const void *buffer)
+{
+    if (!bcache_initialized)
+        bcache_init(FS_MIN_BLOCK_SIZE);
+    if (count == 0)
+        return 0;
+
+    if (bcache_dev_write(start, count, buffer) != 0)
+        return -1;
+    bcache_stats.direct_blocks += count;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        bcache_buf_t *b = hash_lookup(start + i);
+        if (b)
+        {
+            // Que la lectura anticipada no pise luego lo recién escrito
+            while (b->loading)
+                blkdev_wait(bcache_dev);
+            b->io_error = 0;
+            memcpy(b->data, (const uint8_t *)buffer + i * bcache_bsize, bcache_bsize);
+            b->dirty = 0;
+        }
+    }
+    return 0;
+}
+
+// --- Lectura anticipada ---
+int bcache_prefetch(uint32_t start, uint32_t count)
+{
+    if (!bcache_initialized)
+        bcache_init(FS_MIN_BLOCK_SIZE);
+
+    // No dejar que la lectura anticipada desaloje más de media caché
+    count = MIN(count, bcache_nbufs / 2);
+
+    uint32_t loaded = 0;
+    uint32_t i = 0;
+    while (i < count)
+    {
+        if (hash_lookup(start + i))
+        {
+            i++;
+            continue;
+        }
+
+        uint32_t n = 1;
+        while (i + n < count && n < bcache_ra_max && !hash_lookup(start + i + n))
+            n++;
+
+        // Los buffers entran ya en la caché, marcados como en carga: no se
+        // desalojan y quien los use espera a que llegue su contenido
+        bcache_buf_t *bufs[BCACHE_RA_MAX];
+        uint32_t got;
+        for (got = 0; got < n; got++)
+        {
+            bcache_buf_t *b = bcache_evict();
+            if (!b)
+                break;
+            b->block_num = start + i + got;
+            b->valid = 1;
+            b->dirty = 0;
+            b->prefetched = 1;
+            b->loading = 1;
+            hash_insert(b);
+            lru_unlink(b);
+            lru_push_front(b);
+            bufs[got] = b;
+        }
+        if (got == 0)
+            return loaded;
+
+        bcache_ra_read(start + i, bufs, got);
+        bcache_stats.ra_blocks += got;
+        loaded += got;
+        if (got < n)
+            return loaded;
+        i += n;
+    }
+    return loaded;
+}
+
+// --- Escritura de los bloques sucios ---
+// Cada buffer enviado lleva su propio aviso; el aviso puede llegar desde la
+// interrupción, así que solo anota el resultado y dirty se decide después,
+// en el hilo principal, cuando ya no queda nada en vuelo
+typedef struct
+{
+    volatile uint32_t completed;
+    volatile uint32_t failed;
+} bcache_wb_batch_t;
+
+typedef struct
+{
+    bcache_wb_batch_t *batch;
+    volatile int status;
+} bcache_wb_t;
+
+static bcache_wb_t bcache_wb[BCACHE_MAX_BUFS];
+
+static void bcache_wb_done(void *ctx, int status)
+{
+    bcache_wb_t *wb = (bcache_wb_t *)ctx;
+    wb->status = status;
+    if (status)
+        wb->batch->failed++;
+    wb->batch->completed++;
+}
+
+// Todas las escrituras se encolan con tapón y luego se esperan juntas: la
+// capa de bloques las ordena y fusiona las de bloques contiguos
+int bcache_sync(void)
+{
+    bcache_ra_drain();
+
+    bcache_wb_batch_t batch = {0, 0};
+    uint32_t submitted = 0;
+    blkdev_plug(bcache_dev);
+    for (uint32_t i = 0; i < bcache_nbufs; i++)
+    {
+        bcache_buf_t *b = &bcache_bufs[i];
+        if (!b->valid || !b->dirty || b->pinned)
+            continue;
+
+        bcache_wb[i].batch = &batch;
+        bcache_wb[i].status = 0;
+        if (bcache_dev)
+        {
+            blk_request_t *req = blkdev_get_request(bcache_dev);
+            req->write = 1;
+            req->lba = (uint64_t)b->block_num * bcache_spb;
+            req->count = bcache_spb;
+            req->iov[0].buf = b->data;
+            req->iov[0].bytes = bcache_bsize;
+            req->iovcnt = 1;
+            req->done = bcache_wb_done;
+            req->ctx = &bcache_wb[i];
+            if (blkdev_submit(bcache_dev, req) == 0)
+                submitted++;
+            else
+                bcache_wb[i].status = -1; // Rechazada: no habrá aviso
+        }
+        bcache_stats.dev_writes++;
+    }
+    blkdev_unplug(bcache_dev);
+
+    while (batch.completed != submitted)
+        blkdev_wait(bcache_dev);
+
+    // Nada ha cambiado desde el envío: los mismos buffers, con su resultado
+    int written = 0;
+    uint32_t failed = 0;
+    for (uint32_t i = 0; i < bcache_nbufs; i++)
+    {
+        bcache_buf_t *b = &bcache_bufs[i];
+        if (!b->valid || !b->dirty || b->pinned)
+            continue;
+        if (bcache_wb[i].status != 0)
+        {
+            failed++;
+            continue;
+        }
+        b->dirty = 0;
+        bcache_stats.writebacks++;
+        written++;
+    }
+    bcache_stats.write_errors += failed;
+    return failed ? -1 : written;
+}
+
+void bcache_get_stats(bcache_stats_t *out)
+{
+    if (out)
+        *out = bcache_stats;
+}
+
+void bcache_reset_stats(void)
+{
+    memset(&bcache_stats, 0, sizeof(bcache_stats));
+}
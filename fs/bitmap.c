@@ -0,0 +1,71 @@
+#include "bitmap.h"
+
+// Busca el primer bit cuyo valor es 'want' recorriendo palabra a palabra:
+// las palabras que no contienen ninguno se descartan con una comparación.
+static uint32_t bitmap_find(const uint32_t *words, uint32_t start, uint32_t end, int want)
+{
+    uint32_t skip = want ? 0 : 0xFFFFFFFFu;
+    uint32_t bit = start;
+
+    while (bit < end)
+    {
+        uint32_t w = words[bit / BITMAP_WORD_BITS];
+        if (!want)
+            w = ~w;
+        // Descartar los bits anteriores a 'bit' dentro de la palabra
+        w &= 0xFFFFFFFFu << (bit % BITMAP_WORD_BITS);
+
+        if (w != 0)
+        {
+            uint32_t found = (bit & ~(BITMAP_WORD_BITS - 1)) + (uint32_t)__builtin_ctz(w);
+            return found < end ? found : end;
+        }
+
+        bit = (bit & ~(BITMAP_WORD_BITS - 1)) + BITMAP_WORD_BITS;
+
+        // Palabras completas sin candidatos
+        while (bit + BITMAP_WORD_BITS <= end && words[bit / BITMAP_WORD_BITS] == skip)
+            bit += BITMAP_WORD_BITS;
+    }
+    return end;
+}
+
+uint32_t bitmap_find_zero(const uint32_t *words, uint32_t start, uint32_t end)
+{
+    return bitmap_find(words, start, end, 0);
+}
+
+uint32_t bitmap_find_one(const uint32_t *words, uint32_t start, uint32_t end)
+{
+    return bitmap_find(words, start, end, 1);
+}
+
+void bitmap_set_range(uint32_t *words, uint32_t start, uint32_t count)
+{
+    uint32_t bit = start, end = start + count;
+
+    while (bit < end && bit % BITMAP_WORD_BITS)
+        bitmap_set(words, bit++);
+    while (bit + BITMAP_WORD_BITS <= end)
+    {
+        words[bit / BITMAP_WORD_BITS] = 0xFFFFFFFFu;
+        bit += BITMAP_WORD_BITS;
+    }
+    while (bit < end)
+        bitmap_set(words, bit++);
+}
+
+void bitmap_clear_range(uint32_t *words, uint32_t start, uint32_t count)
+{
+    uint32_t bit = start, end = start + count;
+
+    while (bit < end && bit % BITMAP_WORD_BITS)
+        bitmap_clear(words, bit++);
+    while (bit + BITMAP_WORD_BITS <= end)
+    {
+        words[bit / BITMAP_WORD_BITS] = 0;
+        bit += BITMAP_WORD_BITS;
+    }
+    while (bit < end)
+        bitmap_clear(words, bit++);
+}
@@ -0,0 +1,219 @@
+#include "dirhash.h"
+#include "fsmem.h"
+#include "string.h"
+
+// Entrada de la tabla: el nombre no se copia, se compara con el de la
+// posición del directorio cuando coincide el hash. inode_num 0 (la raíz,
+// que no está en el directorio) marca un hueco. Sin lápidas: al borrar se
+// recolocan las entradas siguientes de la cadena, así que una búsqueda
+// fallida se detiene en el primer hueco aunque se haya creado y borrado
+// mucho.
+typedef struct
+{
+    uint32_t hash;
+    uint32_t inode_num;
+    uint32_t slot;
+} dirhash_entry_t;
+
+static dirhash_entry_t *table;
+static dirhash_match_t dirhash_match;
+static uint32_t table_size; // Potencia de 2
+static uint32_t used_count;
+static dirhash_stats_t dirhash_stats;
+
+// Pila de posiciones libres del directorio + marca por posición
+static uint32_t *free_stack;
+static uint32_t free_top;
+static uint8_t *slot_free;
+static uint32_t max_slots;
+static uint32_t tail_slot;
+
+// FNV-1a de 32 bits
+static uint32_t dirhash_hash(const char *name)
+{
+    uint32_t h = 2166136261u;
+    while (*name)
+    {
+        h ^= (uint8_t)*name++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static uint32_t dirhash_table_size(uint32_t max_entries)
+{
+    uint32_t size = 16;
+    while (size < 2 * max_entries)
+        size <<= 1;
+    return size;
+}
+
+uint32_t dirhash_mem_size(uint32_t max_entries, uint32_t entries_per_block)
+{
+    uint32_t slots = max_entries + entries_per_block;
+    return fsmem_size(dirhash_table_size(max_entries) * sizeof(dirhash_entry_t)) +
+           fsmem_size(slots * sizeof(uint32_t)) + fsmem_size(slots);
+}
+
+int dirhash_init(uint32_t max_entries, uint32_t entries_per_block, dirhash_match_t match)
+{
+    uint32_t size = dirhash_table_size(max_entries);
+    uint32_t slots = max_entries + entries_per_block;
+    dirhash_match = match;
+    table = fsmem_alloc(size * sizeof(dirhash_entry_t));
+    free_stack = fsmem_alloc(slots * sizeof(uint32_t));
+    slot_free = fsmem_alloc(slots);
+    if (!table || !free_stack || !slot_free)
+    {
+        table_size = max_slots = 0;
+        return FS_ERROR_NO_SPACE;
+    }
+
+    table_size = size;
+    max_slots = slots;
+    dirhash_reset();
+    return FS_SUCCESS;
+}
+
+void dirhash_reset(void)
+{
+    if (table)
+        memset(table, 0, table_size * sizeof(dirhash_entry_t));
+    if (slot_free)
+        memset(slot_free, 0, max_slots);
+    used_count = 0;
+    free_top = 0;
+    tail_slot = 0;
+}
+
+// Devuelve la entrada con ese nombre o NULL; sondeo lineal
+static dirhash_entry_t *dirhash_find(const char *name, uint32_t h)
+{
+    dirhash_entry_t *found = NULL;
+    uint32_t n = 0;
+    for (uint32_t i = h & (table_size - 1); n < table_size; i = (i + 1) & (table_size - 1))
+    {
+        dirhash_entry_t *e = &table[i];
+        n++;
+        if (e->inode_num == 0)
+            break;
+        if (e->hash == h && dirhash_match(e->slot, name))
+        {
+            found = e;
+            break;
+        }
+    }
+
+    dirhash_stats.lookups++;
+    dirhash_stats.probes += n;
+    if (n > dirhash_stats.max_probes)
+        dirhash_stats.max_probes = n;
+    return found;
+}
+
+int dirhash_insert(const char *name, uint32_t inode_num, uint32_t slot)
+{
+    if (inode_num == 0)
+        return FS_ERROR_INVALID_PARAM;
+    uint32_t h = dirhash_hash(name);
+    if (dirhash_find(name, h))
+        return FS_ERROR_ALREADY_EXISTS;
+
+    for (uint32_t n = 0, i = h & (table_size - 1); n < table_size; n++, i = (i + 1) & (table_size - 1))
+    {
+        dirhash_entry_t *e = &table[i];
+        if (e->inode_num != 0)
+            continue;
+
+        e->hash = h;
+        e->inode_num = inode_num;
+        e->slot = slot;
+        used_count++;
+        return FS_SUCCESS;
+    }
+    return FS_ERROR_NO_SPACE;
+}
+
+int dirhash_remove(const char *name)
+{
+    dirhash_entry_t *e = dirhash_find(name, dirhash_hash(name));
+    if (!e)
+        return FS_ERROR_NOT_FOUND;
+
+    // Borrado con desplazamiento hacia atrás: cada entrada posterior de la
+    // cadena cuya posición ideal no cae entre el hueco y ella pasa al hueco
+    uint32_t mask = table_size - 1;
+    uint32_t hole = (uint32_t)(e - table);
+    for (uint32_t i = (hole + 1) & mask; table[i].inode_num != 0; i = (i + 1) & mask)
+    {
+        uint32_t home = table[i].hash & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+            table[hole] = table[i];
+            hole = i;
+        }
+    }
+    table[hole].inode_num = 0;
+    used_count--;
+    return FS_SUCCESS;
+}
+
+int dirhash_lookup(const char *name, uint32_t *inode_num, uint32_t *slot)
+{
+    dirhash_entry_t *e = dirhash_find(name, dirhash_hash(name));
+    if (!e)
+        return FS_ERROR_NOT_FOUND;
+    if (inode_num)
+        *inode_num = e->inode_num;
+    if (slot)
+        *slot = e->slot;
+    return FS_SUCCESS;
+}
+
+uint32_t dirhash_count(void)
+{
+    return used_count;
+}
+
+void dirhash_get_stats(dirhash_stats_t *out)
+{
+    if (out)
+        *out = dirhash_stats;
+}
+
+void dirhash_reset_stats(void)
+{
+    memset(&dirhash_stats, 0, sizeof(dirhash_stats));
+}
+
+void dirhash_set_tail(uint32_t tail)
+{
+    tail_slot = tail;
+}
+
+void dirhash_put_free_slot(uint32_t slot)
+{
+    if (slot >= max_slots || slot_free[slot])
+        return;
+    slot_free[slot] = 1;
+    free_stack[free_top++] = slot;
+}
+
+int dirhash_take_free_slot(uint32_t *slot)
+{
+    if (free_top > 0)
+    {
+        *slot = free_stack[--free_top];
+        slot_free[*slot] = 0;
+        return FS_SUCCESS;
+    }
+    if (tail_slot >= max_slots)
+        return FS_ERROR_NO_SPACE;
+    *slot = tail_slot++;
+    return FS_SUCCESS;
+}
+
+int dirhash_is_free_slot(uint32_t slot)
+{
+    return slot < max_slots && (slot_free[slot] || slot >= tail_slot);
+}
@@ -1,145 +1,411 @@
 #include "fs.h"
-#include "ahci.h"
+#include "bcache.h"
+#include "dirhash.h"
+#include "journal.h"
+#include "fsmem.h"
+#include "io.h"
 #include "stdio.h"
 #include "string.h"
 #include "file.h"
+#include "timer.h"
+#include "slab.h"
 
-// Variables globales del sistema de archivos
+// Variables globales del sistema de archivos. Los mapas de bits y la tabla
+// de inodos se dimensionan con la geometría del volumen al montarlo.
 static superblock_t superblock;
-static block_bitmap_t block_bitmap;
-static inode_bitmap_t inode_bitmap;
-static inode_t inodes[MAX_FILES];
+static uint32_t *block_bitmap; // superblock.total_blocks bits
+static uint32_t *inode_bitmap; // superblock.total_inodes bits
+static inode_t *inodes;        // superblock.total_inodes inodos
+static uint32_t fs_bsize;      // superblock.block_size
 
 /* Canary para detectar sobrescrituras accidentales en BSS/stack */
 static uint32_t fs_canary = 0xCAFEBABE;
 
-// Driver AHCI global (declared elsewhere)
-extern ahci_device_t *ahci_dev;
+// Pistas rotatorias: la siguiente búsqueda empieza donde terminó la anterior
+static uint32_t block_hint;
+static uint32_t inode_hint;
 
 // Flag de inicialización
 static uint8_t fs_initialized = 0;
 
-// Tabla de archivos abiertos
-static global_file_entry_t file_table[MAX_OPEN_FILES];
+// Tabla de archivos abiertos: el descriptor indexa la tabla y cada entrada
+// abierta es un objeto de file_cache (NULL = libre)
+static global_file_entry_t *file_table[MAX_OPEN_FILES];
+static slab_cache_t *file_cache;
+
+// Prototipos privados
+static void fs_build_dir_index(void);
+static void file_wb_flush_inode(uint32_t inode_num);
+static void file_wb_flush_all(void);
+static void file_wb_discard_inode(uint32_t inode_num);
+static int fs_dir_slot_matches(uint32_t slot, const char *name);
+static void fs_reset_open_files(void);
+
+// --- Seguimiento de metadatos sucios ---
+// Un flag por bloque de metadatos en disco; fs_flush_metadata solo escribe
+// los bloques marcados, así una operación cuesta O(bloques tocados).
+static uint8_t sb_dirty;
+static uint8_t *block_bitmap_dirty; // superblock.block_bitmap_blocks
+static uint8_t *inode_bitmap_dirty; // superblock.inode_bitmap_blocks
+static uint8_t *inode_block_dirty;  // superblock.inode_table_blocks
+
+// Contadores de escritura de metadatos
+static fs_stats_t fs_stats;
+
+static void fs_mark_all_dirty(void)
+{
+    sb_dirty = 1;
+    memset(block_bitmap_dirty, 1, superblock.block_bitmap_blocks);
+    memset(inode_bitmap_dirty, 1, superblock.inode_bitmap_blocks);
+    memset(inode_block_dirty, 1, superblock.inode_table_blocks);
+}
+
+static void fs_clear_dirty(void)
+{
+    sb_dirty = 0;
+    memset(block_bitmap_dirty, 0, superblock.block_bitmap_blocks);
+    memset(inode_bitmap_dirty, 0, superblock.inode_bitmap_blocks);
+    memset(inode_block_dirty, 0, superblock.inode_table_blocks);
+}
 
-// Buffer estático para operaciones de lectura/escritura de bloques
-static uint8_t fs_io_buffer[BLOCK_SIZE];
-// Buffer estático auxiliar para operaciones que no deben reusar fs_io_buffer
-static uint8_t fs_block_buffer[BLOCK_SIZE];
+// Bloques del mapa de bloques tocados en la operación en curso y cuántos
+// reservó fs_begin_op para ello
+static uint32_t op_bitmap_blocks;
+static uint32_t op_bitmap_budget;
 
-// --- Funciones internas de lectura/escritura de bloques ---
-static void fs_read_block(uint32_t block_num, void *buffer)
+static inline void fs_mark_block_bit_dirty(uint32_t block_num)
 {
-    if (ahci_dev)
-    {
-        ahci_read_block(ahci_dev, block_num, buffer);
-        return;
-    }
+    uint8_t *flag = &block_bitmap_dirty[(block_num / 8) / fs_bsize];
+    if (!*flag)
+        op_bitmap_blocks++;
+    *flag = 1;
+}
 
-    /* Fallback: leer desde almacenamiento en memoria (fs_storage) si no hay AHCI */
-    extern uint8_t fs_storage[];
-    if (!buffer)
-        return;
-    uint8_t *src = fs_storage + (block_num * BLOCK_SIZE);
-    /* poke E9 with a small marker for read
-       (helps QEMU userspace trace) */
-    __asm__ volatile("outb %%al, %0" : : "Nd"(0xE9), "a"(0x52));
-    for (int i = 0; i < BLOCK_SIZE; i++)
-        ((uint8_t *)buffer)[i] = src[i];
+static inline void fs_mark_inode_bit_dirty(uint32_t inode_num)
+{
+    inode_bitmap_dirty[(inode_num / 8) / fs_bsize] = 1;
 }
 
-static void fs_write_block(uint32_t block_num, const void *buffer)
+void fs_mark_inode_dirty(uint32_t inode_num)
 {
-    if (ahci_dev)
-    {
-        ahci_write_block(ahci_dev, block_num, buffer);
-        return;
-    }
+    if (inode_num < superblock.total_inodes)
+        inode_block_dirty[inode_num / FS_INODES_PER_BLOCK(fs_bsize)] = 1;
+}
 
-    /* Fallback: escribir en almacenamiento en memoria (fs_storage) si no hay AHCI */
-    extern uint8_t fs_storage[];
-    if (!buffer)
+// Escribe una estructura más pequeña que un bloque, rellenando con ceros.
+// -1 si la caché no tiene buffer libre: el bloque sigue marcado y se
+// vuelve a intentar en el siguiente flush.
+static int fs_write_meta_block(uint32_t block_num, const void *src, uint32_t len)
+{
+    bcache_buf_t *buf = bcache_get_zero(block_num);
+    if (!buf)
+        return -1;
+    memcpy(buf->data, src, len);
+    bcache_mark_dirty(buf);
+    journal_add(buf);
+    bcache_release(buf);
+    return 0;
+}
+
+// Lee un bloque y copia solo los primeros len bytes (evita desbordar dst)
+static void fs_read_meta_block(uint32_t block_num, void *dst, uint32_t len)
+{
+    bcache_buf_t *buf = bcache_get(block_num);
+    if (!buf)
         return;
-    uint8_t *dst = fs_storage + (block_num * BLOCK_SIZE);
-    /* poke E9 with a small marker for write */
-    __asm__ volatile("outb %%al, %0" : : "Nd"(0xE9), "a"(0x57));
-    for (int i = 0; i < BLOCK_SIZE; i++)
-        dst[i] = ((uint8_t *)buffer)[i];
+    memcpy(dst, buf->data, len);
+    bcache_release(buf);
+}
+
+// --- Geometría ---
+static inline uint32_t fs_bitmap_bytes(uint32_t bits)
+{
+    return BITMAP_WORDS(bits) * sizeof(uint32_t);
+}
+
+static int fs_valid_geometry(uint32_t block_size, uint32_t total_blocks, uint32_t total_inodes)
+{
+    if (block_size < FS_MIN_BLOCK_SIZE || block_size > FS_MAX_BLOCK_SIZE ||
+        (block_size & (block_size - 1)) != 0)
+        return 0;
+    // Los sectores del volumen y los bytes de la tabla de inodos caben en 32 bits
+    if (total_blocks == 0 || total_blocks > 0xFFFFFFFFu / (block_size / FS_MIN_BLOCK_SIZE))
+        return 0;
+    return total_inodes >= 2 && total_inodes <= 0xFFFFFFFFu / sizeof(inode_t);
+}
+
+// Calcula la posición de cada área de metadatos a partir de la geometría
+static void fs_compute_layout(superblock_t *sb, uint32_t journal_blocks)
+{
+    uint32_t bs = sb->block_size;
+    uint32_t per_block = FS_INODES_PER_BLOCK(bs);
+
+    sb->block_bitmap_start = FS_BLOCK_BITMAP_BLOCK;
+    sb->block_bitmap_blocks = (fs_bitmap_bytes(sb->total_blocks) + bs - 1) / bs;
+    sb->inode_bitmap_start = sb->block_bitmap_start + sb->block_bitmap_blocks;
+    sb->inode_bitmap_blocks = (fs_bitmap_bytes(sb->total_inodes) + bs - 1) / bs;
+    sb->inode_table_start = sb->inode_bitmap_start + sb->inode_bitmap_blocks;
+    sb->inode_table_blocks = (sb->total_inodes + per_block - 1) / per_block;
+    sb->journal_start = journal_blocks ? sb->inode_table_start + sb->inode_table_blocks : 0;
+    sb->journal_blocks = journal_blocks;
+    sb->first_data_block = sb->inode_table_start + sb->inode_table_blocks + journal_blocks;
+}
+
+// Memoria de trabajo: lo más grande son los dos mapas de fs_check
+static uint32_t fs_scratch_size(const superblock_t *sb)
+{
+    return fs_bitmap_bytes(sb->total_blocks) + fs_bitmap_bytes(sb->total_inodes) + 2 * ARENA_ALIGN;
+}
+
+// Pool de fsmem que necesita el volumen: caché, tablas, índice del
+// directorio, área de paso del diario y memoria de trabajo de esta CPU. 0
+// si no cabe en 32 bits.
+static uint32_t fs_mem_size(const superblock_t *sb)
+{
+    uint32_t bs = sb->block_size;
+    uint64_t size = fsmem_size(bcache_mem_size(bs));
+    size += fsmem_size(fs_bitmap_bytes(sb->total_blocks));
+    size += fsmem_size(fs_bitmap_bytes(sb->total_inodes));
+    size += fsmem_size(sb->total_inodes * sizeof(inode_t));
+    size += fsmem_size(sb->block_bitmap_blocks) + fsmem_size(sb->inode_bitmap_blocks) +
+            fsmem_size(sb->inode_table_blocks);
+    size += dirhash_mem_size(sb->total_inodes, FS_DIR_ENTRIES_PER_BLOCK(bs));
+    size += fsmem_size(JOURNAL_STAGE_SIZE);
+    uint32_t scratch = fs_scratch_size(sb);
+    size += fsmem_size(scratch > FSMEM_SCRATCH_MIN ? scratch : FSMEM_SCRATCH_MIN);
+    return size < 0xFFFFFFFFu - FSMEM_ALIGN ? (uint32_t)size : 0;
+}
+
+// Pide el pool a la medida de sb y rehace la caché con su tamaño de bloque
+static int fs_alloc_cache(const superblock_t *sb, uint32_t mem_size)
+{
+    bcache_quiesce();
+    if (mem_size == 0 || fsmem_reset(mem_size) != 0)
+        return FS_ERROR_NO_SPACE;
+    return bcache_init(sb->block_size) == 0 ? FS_SUCCESS : FS_ERROR_NO_SPACE;
+}
+
+// Reserva en fsmem las estructuras que dependen de la geometría
+static int fs_alloc_tables(void)
+{
+    block_bitmap = fsmem_alloc(fs_bitmap_bytes(superblock.total_blocks));
+    inode_bitmap = fsmem_alloc(fs_bitmap_bytes(superblock.total_inodes));
+    inodes = fsmem_alloc(superblock.total_inodes * sizeof(inode_t));
+    block_bitmap_dirty = fsmem_alloc(superblock.block_bitmap_blocks);
+    inode_bitmap_dirty = fsmem_alloc(superblock.inode_bitmap_blocks);
+    inode_block_dirty = fsmem_alloc(superblock.inode_table_blocks);
+    if (!block_bitmap || !inode_bitmap || !inodes ||
+        !block_bitmap_dirty || !inode_bitmap_dirty || !inode_block_dirty)
+        return FS_ERROR_NO_SPACE;
+
+    int r = dirhash_init(superblock.total_inodes, FS_DIR_ENTRIES_PER_BLOCK(fs_bsize), fs_dir_slot_matches);
+    if (r != FS_SUCCESS)
+        return r;
+    return fsmem_scratch_setup(fs_scratch_size(&superblock)) == 0 ? FS_SUCCESS : FS_ERROR_NO_SPACE;
 }
 
 // --- Guardar y cargar metadatos ---
-static void fs_save_metadata(void)
+static uint32_t fs_flush_metadata(void)
 {
-    uint8_t *buffer = fs_io_buffer;
+    uint32_t written = 0;
 
-    printf("fs_save_metadata: writing superblock -> block 0\n");
-    fs_write_block(0, buffer);
-    /* comprobar canario tras escribir superblock */
-    if (fs_canary != 0xCAFEBABE)
+    if (sb_dirty && fs_write_meta_block(FS_SUPERBLOCK_BLOCK, &superblock, sizeof(superblock)) == 0)
     {
-        printf("fs_save_metadata: CANARY CORRUPTED after superblock write: 0x%x\n", fs_canary);
-        __asm__ volatile("outb %%al, %0" : : "Nd"(0xE9), "a"(0x43));
+        sb_dirty = 0;
+        written++;
     }
-    printf("fs_save_metadata: writing block bitmap -> block 1\n");
-    fs_write_block(1, &block_bitmap);
-    /* comprobar canario tras escribir block bitmap */
-    if (fs_canary != 0xCAFEBABE)
+
+    uint32_t bytes = fs_bitmap_bytes(superblock.total_blocks);
+    for (uint32_t i = 0; i < superblock.block_bitmap_blocks; i++)
     {
-        printf("fs_save_metadata: CANARY CORRUPTED after bitmap write: 0x%x\n", fs_canary);
-        __asm__ volatile("outb %%al, %0" : : "Nd"(0xE9), "a"(0x43));
+        if (!block_bitmap_dirty[i])
+            continue;
+        uint32_t len = MIN(fs_bsize, bytes - i * fs_bsize);
+        if (fs_write_meta_block(superblock.block_bitmap_start + i, (uint8_t *)block_bitmap + i * fs_bsize, len) != 0)
+            continue;
+        block_bitmap_dirty[i] = 0;
+        written++;
     }
-    printf("fs_save_metadata: writing inode bitmap -> block 2\n");
-    fs_write_block(2, &inode_bitmap);
 
-    int inodes_per_block = BLOCK_SIZE / sizeof(inode_t);
-    for (int i = 0; i < MAX_FILES; i++)
+    bytes = fs_bitmap_bytes(superblock.total_inodes);
+    for (uint32_t i = 0; i < superblock.inode_bitmap_blocks; i++)
     {
-        int blk = 3 + i / inodes_per_block;
-        int offset = i % inodes_per_block;
-
-        if (offset == 0)
-            memset(buffer, 0, BLOCK_SIZE);
+        if (!inode_bitmap_dirty[i])
+            continue;
+        uint32_t len = MIN(fs_bsize, bytes - i * fs_bsize);
+        if (fs_write_meta_block(superblock.inode_bitmap_start + i, (uint8_t *)inode_bitmap + i * fs_bsize, len) != 0)
+            continue;
+        inode_bitmap_dirty[i] = 0;
+        written++;
+    }
 
-        memcpy(buffer + offset * sizeof(inode_t), &inodes[i], sizeof(inode_t));
+    uint32_t per_block = FS_INODES_PER_BLOCK(fs_bsize);
+    for (uint32_t i = 0; i < superblock.inode_table_blocks; i++)
+    {
+        if (!inode_block_dirty[i])
+            continue;
+        uint32_t first = i * per_block;
+        uint32_t count = MIN(per_block, superblock.total_inodes - first);
+        if (fs_write_meta_block(superblock.inode_table_start + i, &inodes[first], count * sizeof(inode_t)) != 0)
+            continue;
+        inode_block_dirty[i] = 0;
+        written++;
+    }
 
-        if (offset == inodes_per_block - 1 || i == MAX_FILES - 1)
-        {
-            printf("fs_save_metadata: writing inode block %u (blk=%d, offset=%d)\n", i / inodes_per_block, blk, offset);
-            fs_write_block(blk, buffer);
-            /* check canary after each inode block write */
-            if (fs_canary != 0xCAFEBABE)
-            {
-                printf("fs_save_metadata: CANARY CORRUPTED after inode block %u: 0x%x\n", i / inodes_per_block, fs_canary);
-                __asm__ volatile("outb %%al, %0" : : "Nd"(0xE9), "a"(0x43));
-            }
-            printf("fs_save_metadata: finished inode block %u\n", i / inodes_per_block);
-        }
+    /* comprobar canario tras escribir los metadatos */
+    if (fs_canary != 0xCAFEBABE)
+    {
+        printf("fs_flush_metadata: CANARY CORRUPTED: 0x%x\n", fs_canary);
+        outb(0xE9, 0x43);
     }
+    return written;
+}
+
+// Bloques de metadatos que cualquier operación puede añadir al diario,
+// aparte del mapa de bloques: superbloque, mapa de inodos, bloques de
+// inodos del archivo y de la raíz, bloque del directorio y bloque indirecto
+#define FS_OP_FIXED_BLOCKS 6
+// Bloques del mapa de bloques que puede tocar una escritura al crecer
+#define FS_OP_WRITE_BITMAP_BLOCKS 4
+
+// Abre una operación antes de tocar nada en memoria, reservando en el
+// diario sus bloques fijos y bitmap_blocks del mapa de bloques
+static int fs_begin_op(uint32_t bitmap_blocks)
+{
+    int r = journal_begin_op(FS_OP_FIXED_BLOCKS + bitmap_blocks);
+    if (r == -2)
+        return FS_ERROR_NO_SPACE;
+    if (r != 0)
+        return FS_ERROR_IO;
+    op_bitmap_blocks = 0;
+    op_bitmap_budget = bitmap_blocks;
+    return FS_SUCCESS;
+}
+
+// Cierra una operación: un único flush coalescido a la caché, que el diario
+// agrupa con las operaciones siguientes en un mismo commit
+static void fs_end_op(void)
+{
+    uint32_t written = fs_flush_metadata();
+    journal_end_op();
+
+    fs_stats.ops++;
+    fs_stats.meta_blocks_written += written;
+    fs_stats.last_op_blocks = written;
+    if (written > fs_stats.max_op_blocks)
+        fs_stats.max_op_blocks = written;
+}
+
+// Lee el superbloque. Los volúmenes anteriores a la geometría configurable
+// no guardan la disposición: se calcula igual que entonces.
+static void fs_load_superblock(void)
+{
+    fs_read_meta_block(FS_SUPERBLOCK_BLOCK, &superblock, sizeof(superblock));
+    if (superblock.magic == FS_MAGIC && superblock.inode_table_start == 0)
+        fs_compute_layout(&superblock, superblock.journal_blocks);
 }
 
 static void fs_load_metadata(void)
 {
-    uint8_t *buffer = fs_io_buffer;
+    fs_load_superblock();
+
+    uint32_t bytes = fs_bitmap_bytes(superblock.total_blocks);
+    for (uint32_t i = 0; i < superblock.block_bitmap_blocks; i++)
+    {
+        uint32_t len = MIN(fs_bsize, bytes - i * fs_bsize);
+        fs_read_meta_block(superblock.block_bitmap_start + i, (uint8_t *)block_bitmap + i * fs_bsize, len);
+    }
+
+    bytes = fs_bitmap_bytes(superblock.total_inodes);
+    for (uint32_t i = 0; i < superblock.inode_bitmap_blocks; i++)
+    {
+        uint32_t len = MIN(fs_bsize, bytes - i * fs_bsize);
+        fs_read_meta_block(superblock.inode_bitmap_start + i, (uint8_t *)inode_bitmap + i * fs_bsize, len);
+    }
 
-    fs_read_block(0, &superblock);
+    uint32_t per_block = FS_INODES_PER_BLOCK(fs_bsize);
+    for (uint32_t i = 0; i < superblock.inode_table_blocks; i++)
+    {
+        uint32_t first = i * per_block;
+        uint32_t count = MIN(per_block, superblock.total_inodes - first);
+        fs_read_meta_block(superblock.inode_table_start + i, &inodes[first], count * sizeof(inode_t));
+    }
+
+    fs_clear_dirty();
+}
+
+// Monta el volumen: el superbloque está en el primer sector sea cual sea el
+// tamaño de bloque, así que se lee con la caché en bloques mínimos y luego
+// se rehace con el tamaño del volumen.
+static int fs_mount(void)
+{
+    superblock_t probe = {.block_size = FS_MIN_BLOCK_SIZE};
+    if (fs_alloc_cache(&probe, bcache_mem_size(FS_MIN_BLOCK_SIZE)) != FS_SUCCESS)
+        return FS_ERROR_NO_SPACE;
+    fs_load_superblock();
 
     if (superblock.magic != FS_MAGIC)
-        return;
+        return FS_ERROR_NOT_FOUND;
+    if (!fs_valid_geometry(superblock.block_size, superblock.total_blocks, superblock.total_inodes))
+        return FS_ERROR_INVALID_PARAM;
 
-    fs_read_block(1, &block_bitmap);
-    fs_read_block(2, &inode_bitmap);
+    // Ahora sí, el pool a la medida del volumen
+    if (fs_alloc_cache(&superblock, fs_mem_size(&superblock)) != FS_SUCCESS)
+    {
+        printf("fs_init: no hay memoria para la geometria del volumen\n");
+        return FS_ERROR_NO_SPACE;
+    }
+    fs_bsize = superblock.block_size;
+    if (fs_alloc_tables() != FS_SUCCESS)
+        return FS_ERROR_NO_SPACE;
 
-    int inodes_per_block = BLOCK_SIZE / sizeof(inode_t);
-    for (int i = 0; i < MAX_FILES; i++)
+    // Reaplicar las transacciones con commit que no llegaron a su sitio
+    int replayed = journal_recover(superblock.journal_start, superblock.journal_blocks,
+                                   superblock.total_blocks);
+    if (replayed < 0)
     {
-        int blk = 3 + i / inodes_per_block;
-        int offset = i % inodes_per_block;
+        printf("fs_init: no se pudo recuperar el diario\n");
+        return FS_ERROR_IO;
+    }
+    if (replayed > 0)
+        printf("fs_init: diario: %d transacciones reaplicadas\n", replayed);
 
-        if (offset == 0)
-            fs_read_block(blk, buffer);
+    fs_load_metadata();
+    return FS_SUCCESS;
+}
 
-        memcpy(&inodes[i], buffer + offset * sizeof(inode_t), sizeof(inode_t));
-    }
+int fs_sync(void)
+{
+    if (!fs_initialized)
+        return FS_ERROR_NOT_INITIALIZED;
+    file_wb_flush_all();
+    fs_end_op();
+    if (journal_commit() < 0 || journal_checkpoint() != 0)
+        return FS_ERROR_IO;
+    return FS_SUCCESS;
+}
+
+// Deja todo en disco y olvida el volumen: el siguiente fs_init lo vuelve a
+// leer desde el dispositivo
+int fs_unmount(void)
+{
+    int ret = fs_sync();
+    if (ret != FS_SUCCESS)
+        return ret;
+    fs_reset_open_files();
+    fs_initialized = 0;
+    return FS_SUCCESS;
+}
+
+void fs_get_stats(fs_stats_t *out)
+{
+    if (out)
+        *out = fs_stats;
+}
+
+void fs_reset_stats(void)
+{
+    memset(&fs_stats, 0, sizeof(fs_stats));
 }
 
 // --- Inicialización del FS ---
@@ -148,160 +414,792 @@ int fs_init(void)
     if (fs_initialized)
         return FS_SUCCESS;
 
-    fs_load_metadata();
-
-    if (superblock.magic != FS_MAGIC)
+    int ret = fs_mount();
+    if (ret == FS_ERROR_NOT_FOUND)
     {
         printf("Formateando FS...\n");
         return fs_format();
     }
+    if (ret != FS_SUCCESS)
+    {
+        printf("fs_init: no se puede montar el volumen (%d)\n", ret);
+        return ret;
+    }
 
+    fs_build_dir_index();
+    fs_reset_open_files();
     fs_initialized = 1;
-
-    // Inicializar tabla de archivos
-    for (int i = 0; i < MAX_OPEN_FILES; i++)
-        file_table[i].in_use = 0;
-
     return FS_SUCCESS;
 }
 
 // --- Formateo del FS ---
 int fs_format(void)
+{
+    fs_geometry_t geo = {FS_DEFAULT_BLOCK_SIZE, FS_DEFAULT_BLOCKS, FS_DEFAULT_INODES,
+                         FS_DEFAULT_JOURNAL_BLOCKS};
+    return fs_format_geometry(&geo);
+}
+
+int fs_format_geometry(const fs_geometry_t *geo)
 {
     printf("fs_format: start\n");
     /* debug poke to I/O port 0xE9 for QEMU debug console */
+    outb(0xE9, 'S');
+    if (!geo || !fs_valid_geometry(geo->block_size, geo->total_blocks, geo->total_inodes))
+        return FS_ERROR_INVALID_PARAM;
+
+    // Lo que hubiera montado se descarta: la caché y las tablas se rehacen
+    // con la nueva geometría
+    fs_initialized = 0;
+    fs_reset_open_files();
+    journal_format(0, 0); // Sin diario mientras se escriben los metadatos iniciales
+
+    memset(&superblock, 0, sizeof(superblock));
+    superblock.magic = FS_MAGIC;
+    superblock.total_blocks = geo->total_blocks;
+    superblock.total_inodes = geo->total_inodes;
+    superblock.block_size = geo->block_size;
+    superblock.inode_size = sizeof(inode_t);
+    fs_compute_layout(&superblock, geo->journal_blocks);
+    if (superblock.first_data_block >= superblock.total_blocks)
+        return FS_ERROR_NO_SPACE;
+    if (fs_alloc_cache(&superblock, fs_mem_size(&superblock)) != FS_SUCCESS)
     {
-        unsigned char _c = 'S';
-        __asm__ volatile("outb %%al, %0" : : "Nd"(0xE9), "a"(_c));
+        printf("fs_format: no hay memoria para la geometria\n");
+        return FS_ERROR_NO_SPACE;
     }
-    memset(&superblock, 0, sizeof(superblock));
-    memset(&block_bitmap, 0, sizeof(block_bitmap));
-    memset(&inode_bitmap, 0, sizeof(inode_bitmap));
-    memset(inodes, 0, sizeof(inodes));
+    superblock.free_blocks = superblock.total_blocks - superblock.first_data_block;
+    superblock.free_inodes = superblock.total_inodes - 1;
 
-    superblock.magic = FS_MAGIC;
-    superblock.total_blocks = MAX_BLOCKS;
-    superblock.free_blocks = MAX_BLOCKS - 10;
-    superblock.total_inodes = MAX_FILES;
-    superblock.free_inodes = MAX_FILES - 1;
-    superblock.first_data_block = 10;
-    superblock.block_size = BLOCK_SIZE;
-    superblock.inode_size = INODE_SIZE;
-
-    for (int i = 0; i < 10; i++)
-        block_bitmap.bitmap[i / 8] |= (1 << (i % 8));
-
-    inode_bitmap.bitmap[0] |= 1;
+    fs_bsize = superblock.block_size;
+    if (fs_alloc_tables() != FS_SUCCESS)
+    {
+        printf("fs_format: la geometria no cabe en la memoria del FS\n");
+        return FS_ERROR_NO_SPACE;
+    }
+
+    bitmap_set_range(block_bitmap, 0, superblock.first_data_block);
+    bitmap_set(inode_bitmap, 0);
+    block_hint = 0;
+    inode_hint = 0;
     inodes[0].type = FILE_TYPE_DIRECTORY;
     inodes[0].size = 0;
     inodes[0].links = 1;
     inodes[0].permissions = 0755;
 
-    printf("fs_format: about to save metadata (restored)\n");
-    fs_save_metadata();
-    printf("fs_format: metadata saved (restored)\n");
+    fs_mark_all_dirty();
+    fs_end_op();
+    if (bcache_sync() < 0 || journal_format(superblock.journal_start, superblock.journal_blocks) < 0)
+        return FS_ERROR_IO;
+    dirhash_reset();
     fs_initialized = 1;
 
     printf("FS formateado correctamente\n");
     return FS_SUCCESS;
 }
 
-// --- Bloques/Inodos ---
-uint32_t fs_allocate_block(void)
-{
-    for (uint32_t i = superblock.first_data_block; i < superblock.total_blocks; i++)
-    {
-        int byte_index = i / 8;
-        int bit_index = i % 8;
-        if (!(block_bitmap.bitmap[byte_index] & (1 << bit_index)))
+// --- Bloques/Inodos ---
+// Busca una racha libre de hasta count bloques en [from, to). Devuelve el
+// inicio de la primera racha completa, o de la más larga vista si no hay.
+static int fs_find_free_run(uint32_t from, uint32_t to, uint32_t count,
+                            uint32_t *best_start, uint32_t *best_len)
+{
+    uint32_t bit = from;
+    while (bit < to)
+    {
+        uint32_t start = bitmap_find_zero(block_bitmap, bit, to);
+        if (start >= to)
+            break;
+        uint32_t stop = bitmap_find_one(block_bitmap, start, MIN(to, start + count));
+        uint32_t len = stop - start;
+        if (len > *best_len)
+        {
+            *best_start = start;
+            *best_len = len;
+        }
+        if (len >= count)
+            return 1;
+        bit = stop;
+    }
+    return 0;
+}
+
+// Asigna hasta count bloques contiguos, empezando a buscar en goal (o en la
+// pista si goal es 0). Devuelve el primer bloque y en *allocated cuántos.
+uint32_t fs_allocate_blocks(uint32_t goal, uint32_t count, uint32_t *allocated)
+{
+    uint32_t first = superblock.first_data_block;
+    uint32_t total = superblock.total_blocks;
+    uint32_t best_start = 0, best_len = 0;
+
+    *allocated = 0;
+    if (count == 0 || superblock.free_blocks == 0)
+        return 0;
+
+    if (goal < first || goal >= total)
+        goal = block_hint;
+    if (goal < first || goal >= total)
+        goal = first;
+
+    if (!fs_find_free_run(goal, total, count, &best_start, &best_len))
+        fs_find_free_run(first, goal, count, &best_start, &best_len);
+    if (best_len == 0)
+        return 0;
+
+    bitmap_set_range(block_bitmap, best_start, best_len);
+    superblock.free_blocks -= best_len;
+    sb_dirty = 1;
+    for (uint32_t b = best_start; b < best_start + best_len; b++)
+        fs_mark_block_bit_dirty(b);
+
+    block_hint = best_start + best_len;
+    *allocated = best_len;
+    return best_start;
+}
+
+uint32_t fs_allocate_block(void)
+{
+    uint32_t allocated;
+    return fs_allocate_blocks(0, 1, &allocated);
+}
+
+void fs_free_block(uint32_t block_num)
+{
+    if (block_num < superblock.first_data_block || block_num >= superblock.total_blocks)
+        return;
+    if (!bitmap_test(block_bitmap, block_num))
+        return;
+
+    bitmap_clear(block_bitmap, block_num);
+    superblock.free_blocks++;
+    sb_dirty = 1;
+    fs_mark_block_bit_dirty(block_num);
+}
+
+void fs_free_blocks(uint32_t start, uint32_t count)
+{
+    if (start < superblock.first_data_block || start + count > superblock.total_blocks)
+        return;
+
+    bitmap_clear_range(block_bitmap, start, count);
+    superblock.free_blocks += count;
+    sb_dirty = 1;
+    for (uint32_t b = start; b < start + count; b++)
+        fs_mark_block_bit_dirty(b);
+}
+
+uint32_t fs_allocate_inode(void)
+{
+    uint32_t total = superblock.total_inodes;
+    uint32_t start = (inode_hint > 0 && inode_hint < total) ? inode_hint : 1;
+
+    uint32_t i = bitmap_find_zero(inode_bitmap, start, total);
+    if (i >= total)
+    {
+        i = bitmap_find_zero(inode_bitmap, 1, start);
+        if (i >= start)
+            return 0;
+    }
+
+    bitmap_set(inode_bitmap, i);
+    superblock.free_inodes--;
+    sb_dirty = 1;
+    fs_mark_inode_bit_dirty(i);
+    inode_hint = i + 1;
+    return i;
+}
+
+void fs_free_inode(uint32_t inode_num)
+{
+    if (inode_num == 0 || inode_num >= superblock.total_inodes)
+        return;
+
+    bitmap_clear(inode_bitmap, inode_num);
+    superblock.free_inodes++;
+
+    memset(&inodes[inode_num], 0, sizeof(inode_t));
+    sb_dirty = 1;
+    fs_mark_inode_bit_dirty(inode_num);
+    fs_mark_inode_dirty(inode_num);
+}
+
+// --- Obtener inodo ---
+inode_t *fs_get_inode(uint32_t inode_num)
+{
+    if (inode_num >= superblock.total_inodes)
+        return NULL;
+    return &inodes[inode_num];
+}
+
+// --- Mapa de extensiones ---
+// Lee la extensión idx del inodo (directa o del bloque indirecto)
+static int fs_get_extent(const inode_t *inode, uint32_t idx, fs_extent_t *out)
+{
+    if (idx < FS_INODE_EXTENTS)
+    {
+        *out = inode->extents[idx];
+        return FS_SUCCESS;
+    }
+
+    idx -= FS_INODE_EXTENTS;
+    if (idx >= FS_INDIRECT_EXTENTS(fs_bsize) || inode->indirect_block == 0)
+        return FS_ERROR_NOT_FOUND;
+
+    bcache_buf_t *bbuf = bcache_get(inode->indirect_block);
+    if (!bbuf)
+        return FS_ERROR_NO_SPACE;
+    *out = ((fs_extent_t *)bbuf->data)[idx];
+    bcache_release(bbuf);
+    return FS_SUCCESS;
+}
+
+// Escribe la extensión idx, asignando el bloque indirecto si hace falta
+static int fs_set_extent(uint32_t inode_num, inode_t *inode, uint32_t idx, const fs_extent_t *ext)
+{
+    if (idx < FS_INODE_EXTENTS)
+    {
+        inode->extents[idx] = *ext;
+        fs_mark_inode_dirty(inode_num);
+        return FS_SUCCESS;
+    }
+
+    idx -= FS_INODE_EXTENTS;
+    if (idx >= FS_INDIRECT_EXTENTS(fs_bsize))
+        return FS_ERROR_NO_SPACE;
+
+    bcache_buf_t *bbuf;
+    if (inode->indirect_block == 0)
+    {
+        uint32_t blk = fs_allocate_block();
+        if (blk == 0)
+            return FS_ERROR_NO_SPACE;
+        bbuf = bcache_get_zero(blk);
+        if (!bbuf)
+        {
+            fs_free_block(blk);
+            return FS_ERROR_NO_SPACE;
+        }
+        inode->indirect_block = blk;
+        fs_mark_inode_dirty(inode_num);
+    }
+    else
+        bbuf = bcache_get(inode->indirect_block);
+    if (!bbuf)
+        return FS_ERROR_NO_SPACE;
+
+    ((fs_extent_t *)bbuf->data)[idx] = *ext;
+    bcache_mark_dirty(bbuf);
+    journal_add(bbuf);
+    bcache_release(bbuf);
+    return FS_SUCCESS;
+}
+
+// Traduce un bloque lógico a físico. En *run devuelve cuántos bloques
+// contiguos quedan en la extensión a partir de lblock (0 si no está mapeado).
+uint32_t fs_bmap(const inode_t *inode, uint32_t lblock, uint32_t *run)
+{
+    uint32_t base = 0;
+    fs_extent_t ext;
+
+    for (uint32_t i = 0; i < inode->extent_count; i++)
+    {
+        if (fs_get_extent(inode, i, &ext) != FS_SUCCESS)
+            break;
+        if (lblock < base + ext.length)
+        {
+            if (run)
+                *run = base + ext.length - lblock;
+            return ext.start + (lblock - base);
+        }
+        base += ext.length;
+    }
+
+    if (run)
+        *run = 0;
+    return 0;
+}
+
+// Bloques mapeados por el inodo
+uint32_t fs_inode_blocks(const inode_t *inode)
+{
+    uint32_t total = 0;
+    fs_extent_t ext;
+
+    for (uint32_t i = 0; i < inode->extent_count; i++)
+    {
+        if (fs_get_extent(inode, i, &ext) != FS_SUCCESS)
+            break;
+        total += ext.length;
+    }
+    return total;
+}
+
+// Bloques del mapa de bloques que cubren [start, start + count)
+static inline uint32_t fs_bitmap_span(uint32_t start, uint32_t count)
+{
+    uint32_t per_block = fs_bsize * 8;
+    return (start + count - 1) / per_block - start / per_block + 1;
+}
+
+// Añade hasta count bloques al final del archivo, contiguos a la última
+// extensión cuando es posible. Devuelve cuántos se añadieron. No pasa de
+// lo reservado en el diario para el mapa de bloques: una racha de n bloques
+// toca como mucho (n - 1) / (8 * fs_bsize) + 2 de ellos, y uno se guarda
+// para un bloque indirecto nuevo.
+static uint32_t fs_extend_inode(uint32_t inode_num, inode_t *inode, uint32_t count)
+{
+    fs_extent_t last = {0, 0};
+    uint32_t added = 0;
+
+    if (inode->extent_count > 0)
+        fs_get_extent(inode, inode->extent_count - 1, &last);
+
+    while (added < count)
+    {
+        if (op_bitmap_blocks + 2 > op_bitmap_budget)
+            break;
+        uint32_t left = op_bitmap_budget - op_bitmap_blocks - 1;
+        uint32_t want = MIN(count - added, (left - 1) * fs_bsize * 8 + 1);
+
+        uint32_t got;
+        uint32_t goal = last.length ? last.start + last.length : 0;
+        uint32_t start = fs_allocate_blocks(goal, want, &got);
+        if (got == 0)
+            break;
+
+        if (last.length && start == last.start + last.length)
+        {
+            last.length += got;
+            fs_set_extent(inode_num, inode, inode->extent_count - 1, &last);
+        }
+        else
+        {
+            fs_extent_t ext = {start, got};
+            if (fs_set_extent(inode_num, inode, inode->extent_count, &ext) != FS_SUCCESS)
+            {
+                fs_free_blocks(start, got);
+                break;
+            }
+            inode->extent_count++;
+            fs_mark_inode_dirty(inode_num);
+            last = ext;
+        }
+        added += got;
+    }
+    return added;
+}
+
+// Quita los últimos count bloques del archivo: deshace un fs_extend_inode
+// cuyos bloques no se llegaron a usar
+static void fs_shrink_inode(uint32_t inode_num, inode_t *inode, uint32_t count)
+{
+    fs_extent_t last;
+
+    while (count > 0 && inode->extent_count > 0)
+    {
+        uint32_t idx = inode->extent_count - 1;
+        if (fs_get_extent(inode, idx, &last) != FS_SUCCESS)
+            break;
+        uint32_t n = MIN(count, last.length);
+        fs_free_blocks(last.start + last.length - n, n);
+        last.length -= n;
+        count -= n;
+
+        if (last.length == 0)
+            last.start = 0;
+        fs_set_extent(inode_num, inode, idx, &last);
+        if (last.length == 0)
+        {
+            inode->extent_count--;
+            fs_mark_inode_dirty(inode_num);
+        }
+    }
+}
+
+// Bloques del mapa de bloques que toca liberar los del inodo
+static uint32_t fs_inode_bitmap_span(const inode_t *inode)
+{
+    uint32_t span = inode->indirect_block != 0;
+    fs_extent_t ext;
+
+    for (uint32_t i = 0; i < inode->extent_count; i++)
+    {
+        if (fs_get_extent(inode, i, &ext) == FS_SUCCESS && ext.length != 0)
+            span += fs_bitmap_span(ext.start, ext.length);
+    }
+    return MIN(span, superblock.block_bitmap_blocks);
+}
+
+// Libera todos los bloques del inodo (datos y bloque indirecto)
+static void fs_release_inode_blocks(uint32_t inode_num, inode_t *inode)
+{
+    fs_extent_t ext;
+
+    for (uint32_t i = 0; i < inode->extent_count; i++)
+    {
+        if (fs_get_extent(inode, i, &ext) == FS_SUCCESS)
+            fs_free_blocks(ext.start, ext.length);
+    }
+    if (inode->indirect_block != 0)
+    {
+        // El diario podría reaplicar copias antiguas del bloque indirecto
+        // sobre datos de su próximo dueño: commit y checkpoint antes de reusarlo
+        fs_free_block(inode->indirect_block);
+        journal_barrier();
+    }
+
+    inode->extent_count = 0;
+    inode->indirect_block = 0;
+    memset(inode->extents, 0, sizeof(inode->extents));
+    fs_mark_inode_dirty(inode_num);
+}
+
+// --- Índice del directorio raíz ---
+// El índice no guarda los nombres: los compara con la entrada del directorio
+static int fs_dir_slot_matches(uint32_t slot, const char *name)
+{
+    uint32_t per_block = FS_DIR_ENTRIES_PER_BLOCK(fs_bsize);
+    bcache_buf_t *bbuf = bcache_get(fs_bmap(fs_get_inode(0), slot / per_block, NULL));
+    if (!bbuf)
+        return 0;
+    const dir_entry_t *entry = (const dir_entry_t *)bbuf->data + slot % per_block;
+    int match = entry->inode_num != 0 && strncmp(entry->filename, name, MAX_FILENAME) == 0;
+    bcache_release(bbuf);
+    return match;
+}
+
+// Reconstruye el índice hash a partir de los bloques del directorio raíz
+static void fs_build_dir_index(void)
+{
+    inode_t *root_inode = fs_get_inode(0);
+    uint32_t nblocks = fs_inode_blocks(root_inode);
+
+    dirhash_reset();
+    dirhash_set_tail(nblocks * FS_DIR_ENTRIES_PER_BLOCK(fs_bsize));
+
+    for (uint32_t blk_idx = 0; blk_idx < nblocks; blk_idx++)
+    {
+        bcache_buf_t *bbuf = bcache_get(fs_bmap(root_inode, blk_idx, NULL));
+        if (!bbuf)
+            return;
+
+        dir_entry_t *entries = (dir_entry_t *)bbuf->data;
+        for (uint32_t i = 0; i < FS_DIR_ENTRIES_PER_BLOCK(fs_bsize); i++)
+        {
+            uint32_t slot = blk_idx * FS_DIR_ENTRIES_PER_BLOCK(fs_bsize) + i;
+            if (entries[i].inode_num != 0)
+                dirhash_insert(entries[i].filename, entries[i].inode_num, slot);
+            else
+                dirhash_put_free_slot(slot);
+        }
+        bcache_release(bbuf);
+    }
+}
+
+// Verifica que el índice coincide con las entradas en disco.
+// Devuelve el número de inconsistencias encontradas.
+int fs_check_dir_index(void)
+{
+    inode_t *root_inode = fs_get_inode(0);
+    if (!root_inode)
+        return FS_ERROR_NOT_INITIALIZED;
+
+    int errors = 0;
+    uint32_t live = 0;
+
+    uint32_t nblocks = fs_inode_blocks(root_inode);
+    for (uint32_t blk_idx = 0; blk_idx < nblocks; blk_idx++)
+    {
+        bcache_buf_t *bbuf = bcache_get(fs_bmap(root_inode, blk_idx, NULL));
+        if (!bbuf)
+            return errors + 1;
+
+        dir_entry_t *entries = (dir_entry_t *)bbuf->data;
+        for (uint32_t i = 0; i < FS_DIR_ENTRIES_PER_BLOCK(fs_bsize); i++)
+        {
+            uint32_t slot = blk_idx * FS_DIR_ENTRIES_PER_BLOCK(fs_bsize) + i;
+            uint32_t ino, islot;
+
+            if (entries[i].inode_num == 0)
+            {
+                if (!dirhash_is_free_slot(slot))
+                {
+                    printf("fsck: slot %u vacio no esta en la lista libre\n", slot);
+                    errors++;
+                }
+                continue;
+            }
+
+            live++;
+            if (dirhash_lookup(entries[i].filename, &ino, &islot) != FS_SUCCESS)
+            {
+                printf("fsck: '%s' no esta en el indice\n", entries[i].filename);
+                errors++;
+            }
+            else if (ino != entries[i].inode_num || islot != slot)
+            {
+                printf("fsck: '%s' indice=(%u,%u) disco=(%u,%u)\n", entries[i].filename,
+                       ino, islot, entries[i].inode_num, slot);
+                errors++;
+            }
+            if (dirhash_is_free_slot(slot))
+            {
+                printf("fsck: slot %u ocupado marcado como libre\n", slot);
+                errors++;
+            }
+        }
+        bcache_release(bbuf);
+    }
+
+    if (live != dirhash_count())
+    {
+        printf("fsck: indice con %u entradas, directorio con %u\n", dirhash_count(), live);
+        errors++;
+    }
+    return errors;
+}
+
+// --- Verificación del volumen ---
+static uint32_t fs_count_set(const uint32_t *words, uint32_t bits)
+{
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < bits; i++)
+        n += bitmap_test(words, i);
+    return n;
+}
+
+// Anota en seen una racha de bloques de owner. Los bloques que ya estaban
+// anotados pertenecen a dos dueños.
+static int fs_check_claim(uint32_t *seen, uint32_t start, uint32_t count, uint32_t owner)
+{
+    if (start < superblock.first_data_block || start >= superblock.total_blocks ||
+        count > superblock.total_blocks - start)
+    {
+        printf("fsck: inodo %u: racha %u+%u fuera del area de datos\n", owner, start, count);
+        return 1;
+    }
+
+    int errors = 0;
+    for (uint32_t b = start; b < start + count; b++)
+    {
+        if (bitmap_test(seen, b))
+        {
+            printf("fsck: bloque %u asignado dos veces (inodo %u)\n", b, owner);
+            errors++;
+        }
+        bitmap_set(seen, b);
+    }
+    return errors;
+}
+
+// Recorre los inodos asignados y anota sus bloques en seen
+static int fs_check_inodes(uint32_t *seen)
+{
+    int errors = 0;
+    uint32_t max_extents = FS_INODE_EXTENTS + FS_INDIRECT_EXTENTS(fs_bsize);
+
+    for (uint32_t i = 0; i < superblock.total_inodes; i++)
+    {
+        inode_t *inode = &inodes[i];
+        if (!bitmap_test(inode_bitmap, i))
+        {
+            if (inode->type != 0 || inode->extent_count != 0 || inode->indirect_block != 0)
+            {
+                printf("fsck: inodo %u libre pero con contenido\n", i);
+                errors++;
+            }
+            continue;
+        }
+
+        if (i == 0 ? inode->type != FILE_TYPE_DIRECTORY
+                   : inode->type != FILE_TYPE_REGULAR && inode->type != FILE_TYPE_DIRECTORY)
+        {
+            printf("fsck: inodo %u de tipo desconocido %u\n", i, inode->type);
+            errors++;
+        }
+        if (inode->extent_count > max_extents ||
+            (inode->extent_count > FS_INODE_EXTENTS && inode->indirect_block == 0))
+        {
+            printf("fsck: inodo %u con %u extensiones\n", i, inode->extent_count);
+            errors++;
+            continue;
+        }
+
+        if (inode->indirect_block != 0)
+            errors += fs_check_claim(seen, inode->indirect_block, 1, i);
+
+        uint32_t blocks = 0;
+        fs_extent_t ext;
+        for (uint32_t e = 0; e < inode->extent_count; e++)
+        {
+            if (fs_get_extent(inode, e, &ext) != FS_SUCCESS || ext.length == 0)
+            {
+                printf("fsck: inodo %u: extension %u invalida\n", i, e);
+                errors++;
+                continue;
+            }
+            errors += fs_check_claim(seen, ext.start, ext.length, i);
+            blocks += ext.length;
+        }
+
+        if ((uint64_t)inode->size > (uint64_t)blocks * fs_bsize)
         {
-            block_bitmap.bitmap[byte_index] |= (1 << bit_index);
-            superblock.free_blocks--;
-            fs_save_metadata();
-            return i;
+            printf("fsck: inodo %u: %u bytes en %u bloques\n", i, inode->size, blocks);
+            errors++;
         }
     }
-    return 0;
+    return errors;
 }
 
-void fs_free_block(uint32_t block_num)
+// Comprueba las entradas del directorio raíz y anota en linked sus inodos
+static int fs_check_dir_entries(uint32_t *linked)
 {
-    if (block_num >= superblock.total_blocks)
-        return;
-    int byte_index = block_num / 8;
-    int bit_index = block_num % 8;
-
-    block_bitmap.bitmap[byte_index] &= ~(1 << bit_index);
-    superblock.free_blocks++;
-    fs_save_metadata();
-}
+    inode_t *root_inode = fs_get_inode(0);
+    uint32_t per_block = FS_DIR_ENTRIES_PER_BLOCK(fs_bsize);
+    uint32_t nblocks = fs_inode_blocks(root_inode);
+    uint32_t live = 0;
+    int errors = 0;
 
-uint32_t fs_allocate_inode(void)
-{
-    for (uint32_t i = 1; i < superblock.total_inodes; i++)
+    for (uint32_t blk_idx = 0; blk_idx < nblocks; blk_idx++)
     {
-        int byte_index = i / 8;
-        int bit_index = i % 8;
+        bcache_buf_t *bbuf = bcache_get(fs_bmap(root_inode, blk_idx, NULL));
+        if (!bbuf)
+            return errors + 1;
 
-        if (!(inode_bitmap.bitmap[byte_index] & (1 << bit_index)))
+        dir_entry_t *entries = (dir_entry_t *)bbuf->data;
+        for (uint32_t i = 0; i < per_block; i++)
         {
-            inode_bitmap.bitmap[byte_index] |= (1 << bit_index);
-            superblock.free_inodes--;
-            fs_save_metadata();
-            return i;
+            dir_entry_t *entry = &entries[i];
+            uint32_t ino = entry->inode_num;
+            if (ino == 0)
+                continue;
+            live++;
+
+            uint32_t len = 0;
+            while (len < MAX_FILENAME && entry->filename[len] != '\0')
+                len++;
+            if (len == 0 || len == MAX_FILENAME || len != entry->name_len)
+            {
+                printf("fsck: slot %u: nombre invalido\n", blk_idx * per_block + i);
+                errors++;
+                continue;
+            }
+
+            if (ino >= superblock.total_inodes || !bitmap_test(inode_bitmap, ino))
+            {
+                printf("fsck: '%s' apunta al inodo %u, que no esta asignado\n", entry->filename, ino);
+                errors++;
+                continue;
+            }
+            if (bitmap_test(linked, ino))
+            {
+                printf("fsck: inodo %u con mas de una entrada ('%s')\n", ino, entry->filename);
+                errors++;
+            }
+            bitmap_set(linked, ino);
+            if (entry->file_type != inodes[ino].type)
+            {
+                printf("fsck: '%s' de tipo %u, su inodo %u\n", entry->filename,
+                       entry->file_type, inodes[ino].type);
+                errors++;
+            }
         }
+        bcache_release(bbuf);
     }
-    return 0;
+
+    if (root_inode->size != live * sizeof(dir_entry_t))
+    {
+        printf("fsck: directorio raiz de %u bytes con %u entradas\n", root_inode->size, live);
+        errors++;
+    }
+    return errors;
 }
 
-void fs_free_inode(uint32_t inode_num)
+// Comprueba el volumen montado: disposición del superbloque, inodos y sus
+// extensiones, mapas de bits y contadores frente a lo que realmente está en
+// uso, y el directorio raíz junto con su índice. Devuelve el número de
+// inconsistencias encontradas.
+int fs_check(void)
 {
-    if (inode_num == 0 || inode_num >= superblock.total_inodes)
-        return;
-
-    int byte_index = inode_num / 8;
-    int bit_index = inode_num % 8;
+    if (!fs_initialized)
+        return FS_ERROR_NOT_INITIALIZED;
 
-    inode_bitmap.bitmap[byte_index] &= ~(1 << bit_index);
-    superblock.free_inodes++;
+    // Los datos diferidos asignan bloques al vaciarse: que estén en su sitio
+    file_wb_flush_all();
 
-    memset(&inodes[inode_num], 0, sizeof(inode_t));
-    fs_save_metadata();
-}
+    int errors = 0;
+    superblock_t layout = superblock;
+    fs_compute_layout(&layout, superblock.journal_blocks);
+    if (memcmp(&layout, &superblock, sizeof(superblock)) != 0)
+    {
+        printf("fsck: la disposicion del superbloque no cuadra con su geometria\n");
+        errors++;
+    }
 
-// --- Obtener inodo ---
-inode_t *fs_get_inode(uint32_t inode_num)
-{
-    if (inode_num >= superblock.total_inodes)
-        return NULL;
-    return &inodes[inode_num];
-}
+    arena_t *scratch = fsmem_scratch();
+    arena_scope_t scope = arena_begin(scratch);
+    uint32_t *seen = arena_zalloc(scratch, fs_bitmap_bytes(superblock.total_blocks));
+    uint32_t *linked = arena_zalloc(scratch, fs_bitmap_bytes(superblock.total_inodes));
+    if (!seen || !linked)
+    {
+        arena_end(scope);
+        return FS_ERROR_NO_SPACE;
+    }
 
-// --- Funciones de archivo ---
-int fs_find_file(const char *filename, uint32_t *inode_num)
-{
-    inode_t *root_inode = fs_get_inode(0);
-    if (!root_inode)
-        return FS_ERROR_NOT_INITIALIZED;
+    bitmap_set_range(seen, 0, superblock.first_data_block);
+    errors += fs_check_inodes(seen);
 
-    for (int block_idx = 0; block_idx < 12 && root_inode->blocks[block_idx] != 0; block_idx++)
+    for (uint32_t b = 0; b < superblock.total_blocks; b++)
     {
-        uint8_t *buffer = fs_block_buffer;
-        fs_read_block(root_inode->blocks[block_idx], buffer);
+        int used = bitmap_test(block_bitmap, b);
+        if (used && !bitmap_test(seen, b))
+        {
+            printf("fsck: bloque %u marcado en uso sin propietario\n", b);
+            errors++;
+        }
+        else if (!used && bitmap_test(seen, b))
+        {
+            printf("fsck: bloque %u en uso marcado libre\n", b);
+            errors++;
+        }
+    }
 
-        dir_entry_t *entries = (dir_entry_t *)buffer;
-        int entries_per_block = BLOCK_SIZE / sizeof(dir_entry_t);
+    uint32_t used_blocks = fs_count_set(block_bitmap, superblock.total_blocks);
+    if (superblock.free_blocks != superblock.total_blocks - used_blocks)
+    {
+        printf("fsck: superbloque con %u bloques libres, mapa con %u\n",
+               superblock.free_blocks, superblock.total_blocks - used_blocks);
+        errors++;
+    }
+    uint32_t used_inodes = fs_count_set(inode_bitmap, superblock.total_inodes);
+    if (superblock.free_inodes != superblock.total_inodes - used_inodes)
+    {
+        printf("fsck: superbloque con %u inodos libres, mapa con %u\n",
+               superblock.free_inodes, superblock.total_inodes - used_inodes);
+        errors++;
+    }
 
-        for (int i = 0; i < entries_per_block; i++)
+    errors += fs_check_dir_entries(linked);
+    for (uint32_t i = 1; i < superblock.total_inodes; i++)
+    {
+        if (bitmap_test(inode_bitmap, i) && !bitmap_test(linked, i))
         {
-            if (entries[i].inode_num != 0 && strcmp(entries[i].filename, filename) == 0)
-            {
-                *inode_num = entries[i].inode_num;
-                return FS_SUCCESS;
-            }
+            printf("fsck: inodo %u asignado sin entrada de directorio\n", i);
+            errors++;
         }
     }
-    return FS_ERROR_NOT_FOUND;
+
+    errors += fs_check_dir_index();
+    arena_end(scope);
+    return errors;
+}
+
+// --- Funciones de archivo ---
+int fs_find_file(const char *filename, uint32_t *inode_num)
+{
+    if (!fs_get_inode(0))
+        return FS_ERROR_NOT_INITIALIZED;
+    return dirhash_lookup(filename, inode_num, NULL);
 }
 
 int fs_create_file(const char *filename, uint32_t type)
@@ -315,59 +1213,110 @@ int fs_create_file(const char *filename, uint32_t type)
     if (fs_find_file(filename, &existing_inode) == FS_SUCCESS)
         return FS_ERROR_ALREADY_EXISTS;
 
+    // Un bloque nuevo para el directorio y quizá su bloque indirecto
+    int r = fs_begin_op(2);
+    if (r != FS_SUCCESS)
+        return r;
+
+    uint32_t slot;
+    if (dirhash_take_free_slot(&slot) != FS_SUCCESS)
+        return FS_ERROR_NO_SPACE;
+
     uint32_t new_inode_num = fs_allocate_inode();
     if (new_inode_num == 0)
+    {
+        dirhash_put_free_slot(slot);
         return FS_ERROR_NO_SPACE;
+    }
 
     inode_t *new_inode = fs_get_inode(new_inode_num);
     new_inode->type = type;
     new_inode->size = 0;
     new_inode->links = 1;
     new_inode->permissions = 0644;
+    fs_mark_inode_dirty(new_inode_num);
 
     inode_t *root_inode = fs_get_inode(0);
-    uint8_t *block_buf = fs_block_buffer;
+    uint32_t blk_idx = slot / FS_DIR_ENTRIES_PER_BLOCK(fs_bsize);
+    bcache_buf_t *bbuf = NULL;
 
-    for (int blk_idx = 0; blk_idx < 12; blk_idx++)
+    // Las posiciones de la cola caen en el siguiente bloque del directorio
+    if (blk_idx >= fs_inode_blocks(root_inode))
     {
-        uint32_t blk_num = root_inode->blocks[blk_idx];
-        if (blk_num == 0)
+        if (fs_extend_inode(0, root_inode, 1) == 1)
         {
-            blk_num = fs_allocate_block();
-            if (blk_num == 0)
-            {
-                fs_free_inode(new_inode_num);
-                return FS_ERROR_NO_SPACE;
-            }
-            root_inode->blocks[blk_idx] = blk_num;
-            memset(block_buf, 0, BLOCK_SIZE);
+            bbuf = bcache_get_zero(fs_bmap(root_inode, blk_idx, NULL));
+            if (!bbuf)
+                fs_shrink_inode(0, root_inode, 1);
         }
-        else
-            fs_read_block(blk_num, block_buf);
-
-        dir_entry_t *entries = (dir_entry_t *)block_buf;
-        int entries_per_block = BLOCK_SIZE / sizeof(dir_entry_t);
+    }
+    else
+        bbuf = bcache_get(fs_bmap(root_inode, blk_idx, NULL));
 
-        for (int i = 0; i < entries_per_block; i++)
-        {
-            if (entries[i].inode_num == 0)
-            {
-                entries[i].inode_num = new_inode_num;
-                entries[i].file_type = type;
-                strncpy(entries[i].filename, filename, MAX_FILENAME - 1);
-                entries[i].filename[MAX_FILENAME - 1] = '\0';
-                entries[i].name_len = strlen(entries[i].filename);
-
-                fs_write_block(root_inode->blocks[blk_idx], block_buf);
-                root_inode->size += sizeof(dir_entry_t);
-                fs_save_metadata();
-                return FS_SUCCESS;
-            }
-        }
+    if (!bbuf)
+    {
+        dirhash_put_free_slot(slot);
+        fs_free_inode(new_inode_num);
+        fs_end_op();
+        return FS_ERROR_NO_SPACE;
     }
 
-    fs_free_inode(new_inode_num);
-    return FS_ERROR_NO_SPACE;
+    dir_entry_t *entry = (dir_entry_t *)bbuf->data + slot % FS_DIR_ENTRIES_PER_BLOCK(fs_bsize);
+    entry->inode_num = new_inode_num;
+    entry->file_type = type;
+    strncpy(entry->filename, filename, MAX_FILENAME - 1);
+    entry->filename[MAX_FILENAME - 1] = '\0';
+    entry->name_len = strlen(entry->filename);
+    dirhash_insert(entry->filename, new_inode_num, slot);
+
+    bcache_mark_dirty(bbuf);
+    journal_add(bbuf);
+    bcache_release(bbuf);
+    root_inode->size += sizeof(dir_entry_t);
+    fs_mark_inode_dirty(0);
+    fs_end_op();
+    return FS_SUCCESS;
+}
+
+int fs_delete_file(const char *filename)
+{
+    if (!fs_initialized)
+        fs_init();
+    if (!filename)
+        return FS_ERROR_INVALID_PARAM;
+
+    uint32_t inode_num, slot;
+    if (dirhash_lookup(filename, &inode_num, &slot) != FS_SUCCESS)
+        return FS_ERROR_NOT_FOUND;
+    // Liberar no se puede repartir: un archivo tan fragmentado que su mapa
+    // de bloques no cabe en una transacción no se borra (FS_ERROR_NO_SPACE)
+    int r = fs_begin_op(fs_inode_bitmap_span(fs_get_inode(inode_num)));
+    if (r != FS_SUCCESS)
+        return r;
+
+    inode_t *root_inode = fs_get_inode(0);
+    bcache_buf_t *bbuf = bcache_get(fs_bmap(root_inode, slot / FS_DIR_ENTRIES_PER_BLOCK(fs_bsize), NULL));
+    if (!bbuf)
+        return FS_ERROR_NO_SPACE;
+
+    // El índice compara con el nombre del directorio: se quita antes de borrarlo
+    dirhash_remove(filename);
+    dir_entry_t *entry = (dir_entry_t *)bbuf->data + slot % FS_DIR_ENTRIES_PER_BLOCK(fs_bsize);
+    memset(entry, 0, sizeof(dir_entry_t));
+    bcache_mark_dirty(bbuf);
+    journal_add(bbuf);
+    bcache_release(bbuf);
+
+    file_wb_discard_inode(inode_num);
+    dirhash_put_free_slot(slot);
+    root_inode->size -= sizeof(dir_entry_t);
+    fs_mark_inode_dirty(0);
+
+    fs_release_inode_blocks(inode_num, fs_get_inode(inode_num));
+    fs_free_inode(inode_num);
+
+    fs_end_op();
+    return FS_SUCCESS;
 }
 
 int fs_read_file(int fd, void *buffer, uint32_t size, uint32_t offset)
@@ -378,6 +1327,9 @@ int fs_read_file(int fd, void *buffer, uint32_t size, uint32_t offset)
     if (!file_inode)
         return FS_ERROR_NOT_FOUND;
 
+    // Los datos aún en buffers de escritura diferida deben verse
+    file_wb_flush_inode(fd);
+
     if (offset >= file_inode->size)
         return 0;
     if (offset + size > file_inode->size)
@@ -388,19 +1340,32 @@ int fs_read_file(int fd, void *buffer, uint32_t size, uint32_t offset)
 
     while (bytes_read < size)
     {
-        uint32_t block_index = offset / BLOCK_SIZE;
-        uint32_t block_offset = offset % BLOCK_SIZE;
-        uint32_t bytes_to_read = BLOCK_SIZE - block_offset;
+        uint32_t block_index = offset / fs_bsize;
+        uint32_t block_offset = offset % fs_bsize;
+        uint32_t bytes_to_read = fs_bsize - block_offset;
         if (bytes_to_read > size - bytes_read)
             bytes_to_read = size - bytes_read;
 
-        uint32_t block_num = block_index < 12 ? file_inode->blocks[block_index] : 0;
-        uint8_t *block_buf = fs_block_buffer;
+        uint32_t run;
+        uint32_t block_num = fs_bmap(file_inode, block_index, &run);
+
+        // Bloques completos y contiguos: una sola petición directa al buffer
+        // del llamador, sin pasar por la caché
+        if (block_num != 0 && block_offset == 0 && size - bytes_read >= fs_bsize)
+        {
+            uint32_t nblocks = MIN(run, (size - bytes_read) / fs_bsize);
+            bcache_read_blocks(block_num, nblocks, buf + bytes_read);
+            bytes_read += nblocks * fs_bsize;
+            offset += nblocks * fs_bsize;
+            continue;
+        }
+
+        bcache_buf_t *bbuf = block_num != 0 ? bcache_get(block_num) : NULL;
 
-        if (block_num != 0)
+        if (bbuf)
         {
-            fs_read_block(block_num, block_buf);
-            memcpy(buf + bytes_read, block_buf + block_offset, bytes_to_read);
+            memcpy(buf + bytes_read, bbuf->data + block_offset, bytes_to_read);
+            bcache_release(bbuf);
         }
         else
             memset(buf + bytes_read, 0, bytes_to_read);
@@ -412,52 +1377,145 @@ int fs_read_file(int fd, void *buffer, uint32_t size, uint32_t offset)
     return bytes_read;
 }
 
-int fs_write_file(int fd, const void *buffer, uint32_t size, uint32_t offset)
+// Una operación de escritura: puede quedarse corta si el crecimiento del
+// archivo no cabe en lo reservado en el diario
+static int fs_write_op(uint32_t inode_num, inode_t *file_inode, const uint8_t *buf, uint32_t size, uint32_t offset)
 {
-    if (!fs_initialized)
-        fs_init();
-    inode_t *file_inode = fs_get_inode(fd);
-    if (!file_inode)
-        return FS_ERROR_NOT_FOUND;
-
-    const uint8_t *buf = (const uint8_t *)buffer;
     uint32_t bytes_written = 0;
+    int r = fs_begin_op(FS_OP_WRITE_BITMAP_BLOCKS);
+    if (r != FS_SUCCESS)
+        return r;
+
+    // Reservar de una vez los bloques que faltan hasta el final de la
+    // escritura; quedan a continuación de la última extensión si hay sitio
+    uint32_t mapped = fs_inode_blocks(file_inode);
+    uint32_t last_index = (offset + size - 1) / fs_bsize;
+    uint32_t fresh_start = mapped, fresh_end = mapped;
+    if (last_index >= mapped)
+        fresh_end = mapped + fs_extend_inode(inode_num, file_inode, last_index + 1 - mapped);
+
+    // Los bloques nuevos anteriores al offset son un hueco: se escriben a
+    // cero. Si no hay buffer para alguno, se devuelven todos los nuevos
+    // antes que dejar en el archivo bloques con contenido ajeno.
+    for (uint32_t i = fresh_start; i < fresh_end && i < offset / fs_bsize; i++)
+    {
+        bcache_buf_t *zbuf = bcache_get_zero(fs_bmap(file_inode, i, NULL));
+        if (!zbuf)
+        {
+            fs_shrink_inode(inode_num, file_inode, fresh_end - fresh_start);
+            fs_end_op();
+            return FS_ERROR_NO_SPACE;
+        }
+        bcache_mark_dirty(zbuf);
+        bcache_release(zbuf);
+    }
 
     while (bytes_written < size)
     {
-        uint32_t block_index = offset / BLOCK_SIZE;
-        uint32_t block_offset = offset % BLOCK_SIZE;
-        uint32_t bytes_to_write = BLOCK_SIZE - block_offset;
+        uint32_t block_index = offset / fs_bsize;
+        uint32_t block_offset = offset % fs_bsize;
+        uint32_t bytes_to_write = fs_bsize - block_offset;
         if (bytes_to_write > size - bytes_written)
             bytes_to_write = size - bytes_written;
 
-        uint32_t block_num = file_inode->blocks[block_index];
+        uint32_t run;
+        uint32_t block_num = fs_bmap(file_inode, block_index, &run);
         if (block_num == 0)
+            break;
+
+        // Bloques completos y contiguos: una sola petición directa
+        if (block_offset == 0 && size - bytes_written >= fs_bsize)
         {
-            block_num = fs_allocate_block();
-            if (block_num == 0)
+            uint32_t nblocks = MIN(run, (size - bytes_written) / fs_bsize);
+            if (bcache_write_blocks(block_num, nblocks, buf + bytes_written) != 0)
                 break;
-            file_inode->blocks[block_index] = block_num;
+            bytes_written += nblocks * fs_bsize;
+            offset += nblocks * fs_bsize;
+            continue;
         }
 
-        uint8_t *block_buf = fs_block_buffer;
-        if (block_offset != 0 || bytes_to_write < BLOCK_SIZE)
-            fs_read_block(block_num, block_buf);
+        // Un bloque nuevo o sobrescrito completo no necesita leerse del disco
+        bcache_buf_t *bbuf;
+        if ((block_index >= fresh_start && block_index < fresh_end) || (block_offset == 0 && bytes_to_write == fs_bsize))
+            bbuf = bcache_get_zero(block_num);
+        else
+            bbuf = bcache_get(block_num);
+        if (!bbuf)
+            break;
 
-        memcpy(block_buf + block_offset, buf + bytes_written, bytes_to_write);
-        fs_write_block(block_num, block_buf);
+        memcpy(bbuf->data + block_offset, buf + bytes_written, bytes_to_write);
+        bcache_mark_dirty(bbuf);
+        bcache_release(bbuf);
 
         bytes_written += bytes_to_write;
         offset += bytes_to_write;
     }
 
     if (offset > file_inode->size)
+    {
         file_inode->size = offset;
-    fs_save_metadata();
+        fs_mark_inode_dirty(inode_num);
+    }
+
+    // Lo mismo con los nuevos que quedan tras una escritura corta
+    uint32_t keep = MAX(fresh_start, (file_inode->size + fs_bsize - 1) / fs_bsize);
+    if (fresh_end > keep)
+        fs_shrink_inode(inode_num, file_inode, fresh_end - keep);
+    fs_end_op();
     return bytes_written;
 }
 
+int fs_write_file(int fd, const void *buffer, uint32_t size, uint32_t offset)
+{
+    if (!fs_initialized)
+        fs_init();
+    inode_t *file_inode = fs_get_inode(fd);
+    if (!file_inode)
+        return FS_ERROR_NOT_FOUND;
+
+    // Las escrituras grandes van en varias operaciones, cada una entera en
+    // una transacción del diario
+    const uint8_t *buf = (const uint8_t *)buffer;
+    uint32_t done = 0;
+    while (done < size)
+    {
+        int n = fs_write_op(fd, file_inode, buf + done, size - done, offset + done);
+        if (n < 0 && done == 0)
+            return n;
+        if (n <= 0)
+            break;
+        done += n;
+    }
+    return done;
+}
+
 // --- Tabla de archivos ---
+// Estado de una entrada recién abierta; los objetos libres de la caché lo
+// conservan, así que abrir solo rellena inodo y modo
+static void file_entry_ctor(void *obj)
+{
+    global_file_entry_t *f = (global_file_entry_t *)obj;
+    memset(f, 0, sizeof(*f));
+    f->wb = -1;
+}
+
+static global_file_entry_t *file_entry_alloc(void)
+{
+    if (!file_cache)
+        file_cache = slab_cache_create("file", sizeof(global_file_entry_t), 0, file_entry_ctor);
+    return file_cache ? (global_file_entry_t *)slab_alloc(file_cache) : NULL;
+}
+
+static void file_entry_free(int fd)
+{
+    global_file_entry_t *f = file_table[fd];
+    if (!f)
+        return;
+    file_table[fd] = NULL;
+    file_entry_ctor(f);
+    slab_free(file_cache, f);
+}
+
 int file_open(const char *filename, uint32_t flags)
 {
     if (!fs_initialized)
@@ -476,88 +1534,348 @@ int file_open(const char *filename, uint32_t flags)
 
     for (int i = 0; i < MAX_OPEN_FILES; i++)
     {
-        if (!file_table[i].in_use)
+        if (file_table[i])
+            continue;
+        global_file_entry_t *f = file_entry_alloc();
+        if (!f)
+            return -1;
+        f->inode_num = inode_num;
+        f->flags = flags;
+        file_table[i] = f;
+        return i;
+    }
+    return -1;
+}
+
+// --- Escritura diferida ---
+// Las escrituras pequeñas y contiguas se acumulan en un buffer del pool y
+// los bloques se asignan al vaciarlo (asignación diferida), de una vez y
+// contiguos. Se vacía al cerrar, en fsync, cuando el pool se agota, cuando
+// los datos superan WB_MAX_AGE_TICKS o antes de que alguien lea el archivo.
+
+typedef struct
+{
+    uint8_t in_use;
+    int fd;          // Archivo abierto dueño del buffer
+    uint32_t offset; // Posición en el archivo de data[0]
+    uint32_t len;    // Bytes pendientes
+    uint64_t since;  // Tick de la escritura pendiente más antigua
+    uint8_t data[WB_BUFFER_SIZE];
+} file_wb_t;
+
+static file_wb_t wb_pool[WB_BUFFERS];
+
+// Escribe los primeros upto bytes del buffer y conserva el resto al
+// principio. Si la escritura se queda corta solo se descarta lo escrito: lo
+// demás sigue pendiente para el siguiente intento.
+static int file_wb_write(file_wb_t *wb, uint32_t upto)
+{
+    if (upto == 0)
+        return 0;
+
+    int written = fs_write_file(file_table[wb->fd]->inode_num, wb->data, upto, wb->offset);
+    uint32_t done = written > 0 ? MIN((uint32_t)written, upto) : 0;
+    memmove(wb->data, wb->data + done, wb->len - done);
+    wb->offset += done;
+    wb->len -= done;
+    fs_stats.wb_flushes++;
+    return done == upto ? 0 : -1;
+}
+
+static void file_wb_release(int fd)
+{
+    global_file_entry_t *f = file_table[fd];
+    if (f->wb < 0)
+        return;
+    wb_pool[f->wb].in_use = 0;
+    f->wb = -1;
+}
+
+// Vacía por completo el buffer del archivo abierto y lo devuelve al pool.
+// Si no se pudo escribir todo, el buffer se queda con lo pendiente.
+static int file_wb_flush(int fd)
+{
+    global_file_entry_t *f = file_table[fd];
+    if (f->wb < 0)
+        return 0;
+
+    file_wb_t *wb = &wb_pool[f->wb];
+    if (file_wb_write(wb, wb->len) != 0)
+        return -1;
+    file_wb_release(fd);
+    return 0;
+}
+
+static void file_wb_flush_inode(uint32_t inode_num)
+{
+    for (int i = 0; i < WB_BUFFERS; i++)
+    {
+        if (wb_pool[i].in_use && file_table[wb_pool[i].fd]->inode_num == inode_num)
+            file_wb_flush(wb_pool[i].fd);
+    }
+}
+
+static void file_wb_flush_all(void)
+{
+    for (int i = 0; i < WB_BUFFERS; i++)
+    {
+        if (wb_pool[i].in_use)
+            file_wb_flush(wb_pool[i].fd);
+    }
+}
+
+// El archivo se borra: los datos pendientes ya no tienen dónde ir
+static void file_wb_discard_inode(uint32_t inode_num)
+{
+    for (int i = 0; i < WB_BUFFERS; i++)
+    {
+        if (wb_pool[i].in_use && file_table[wb_pool[i].fd]->inode_num == inode_num)
         {
-            file_table[i].inode_num = inode_num;
-            file_table[i].position = 0;
-            file_table[i].flags = flags;
-            file_table[i].in_use = 1;
-            return i;
+            file_table[wb_pool[i].fd]->wb = -1;
+            wb_pool[i].in_use = 0;
         }
     }
-    return -1;
+}
+
+// Asigna un buffer al archivo; si el pool está agotado vacía el más antiguo.
+// NULL si ese no se pudo escribir (sigue siendo de su archivo).
+static file_wb_t *file_wb_acquire(int fd)
+{
+    int victim = -1;
+    for (int i = 0; i < WB_BUFFERS; i++)
+    {
+        if (!wb_pool[i].in_use)
+        {
+            victim = i;
+            break;
+        }
+        if (victim < 0 || wb_pool[i].since < wb_pool[victim].since)
+            victim = i;
+    }
+
+    file_wb_t *wb = &wb_pool[victim];
+    if (wb->in_use && file_wb_flush(wb->fd) != 0)
+        return NULL;
+
+    wb->in_use = 1;
+    wb->fd = fd;
+    wb->offset = file_table[fd]->position;
+    wb->len = 0;
+    wb->since = timer_ticks();
+    file_table[fd]->wb = victim;
+    return wb;
+}
+
+// Cierra todos los archivos sin escribir lo pendiente (el volumen cambia)
+static void fs_reset_open_files(void)
+{
+    for (int i = 0; i < MAX_OPEN_FILES; i++)
+        file_entry_free(i);
+    for (int i = 0; i < WB_BUFFERS; i++)
+        wb_pool[i].in_use = 0;
+}
+
+int file_fsync(int fd)
+{
+    if (fd < 0 || fd >= MAX_OPEN_FILES || !file_table[fd])
+        return -1;
+    int ret = file_wb_flush(fd);
+    fs_sync();
+    return ret;
+}
+
+// Vacía los buffers con datos pendientes desde hace más de WB_MAX_AGE_TICKS
+// y hace commit de la transacción del diario si lleva demasiado abierta
+void file_flush_expired(uint64_t now)
+{
+    for (int i = 0; i < WB_BUFFERS; i++)
+    {
+        if (wb_pool[i].in_use && now - wb_pool[i].since >= WB_MAX_AGE_TICKS)
+            file_wb_flush(wb_pool[i].fd);
+    }
+    journal_commit_expired(now);
 }
 
 int file_close(int fd)
 {
-    if (fd < 0 || fd >= MAX_OPEN_FILES || !file_table[fd].in_use)
+    if (fd < 0 || fd >= MAX_OPEN_FILES || !file_table[fd])
         return -1;
-    file_table[fd].in_use = 0;
-    return 0;
+    int ret = file_wb_flush(fd);
+    // Lo que no se pudo escribir se pierde con el descriptor
+    file_wb_release(fd);
+    file_entry_free(fd);
+    return ret;
+}
+
+// --- Lectura anticipada ---
+// Carga en caché los bloques lógicos [first, first + count) del inodo,
+// una petición por racha física contigua, sin esperar a que lleguen
+static void fs_readahead(inode_t *inode, uint32_t first, uint32_t count)
+{
+    uint32_t mapped = fs_inode_blocks(inode);
+    uint32_t end = MIN(first + count, mapped);
+
+    while (first < end)
+    {
+        uint32_t run;
+        uint32_t block_num = fs_bmap(inode, first, &run);
+        if (block_num == 0)
+            break;
+        run = MIN(run, end - first);
+        bcache_prefetch(block_num, run);
+        first += run;
+    }
+}
+
+// Ajusta la ventana según el patrón de acceso y anticipa los bloques
+// siguientes a la lectura [pos, pos + bytes)
+static void file_update_readahead(global_file_entry_t *f, uint32_t pos, uint32_t bytes)
+{
+    inode_t *inode = fs_get_inode(f->inode_num);
+    if (!inode || bytes == 0)
+        return;
+
+    uint32_t first = pos / fs_bsize;
+    uint32_t last = (pos + bytes - 1) / fs_bsize;
+
+    // Secuencial si continúa donde terminó la anterior (o en su último bloque)
+    if (first == f->ra_next || (f->ra_next > 0 && first == f->ra_next - 1))
+        f->ra_window = f->ra_window ? MIN(f->ra_window * 2, RA_MAX_WINDOW) : RA_MIN_WINDOW;
+    else
+    {
+        f->ra_window /= 2;
+        f->ra_end = 0;
+    }
+    f->ra_next = last + 1;
+
+    if (f->ra_window == 0)
+        return;
+
+    // Solo se pide otro lote cuando queda menos de media ventana anticipada
+    uint32_t start = MAX(f->ra_end, last + 1);
+    uint32_t target = last + 1 + f->ra_window;
+    if (start - (last + 1) >= f->ra_window / 2 || start >= target)
+        return;
+
+    fs_readahead(inode, start, target - start);
+    f->ra_end = target;
 }
 
 int file_read(int fd, void *buffer, uint32_t count)
 {
-    if (fd < 0 || fd >= MAX_OPEN_FILES || !file_table[fd].in_use)
+    if (fd < 0 || fd >= MAX_OPEN_FILES || !file_table[fd])
         return -1;
-    int bytes = fs_read_file(file_table[fd].inode_num, buffer, count, file_table[fd].position);
-    file_table[fd].position += bytes;
+    uint32_t pos = file_table[fd]->position;
+    int bytes = fs_read_file(file_table[fd]->inode_num, buffer, count, pos);
+    if (bytes > 0)
+    {
+        file_table[fd]->position += bytes;
+        file_update_readahead(file_table[fd], pos, bytes);
+    }
     return bytes;
 }
 
 int file_write(int fd, const void *buffer, uint32_t count)
 {
-    if (fd < 0 || fd >= MAX_OPEN_FILES || !file_table[fd].in_use)
+    if (fd < 0 || fd >= MAX_OPEN_FILES || !file_table[fd])
         return -1;
-    if (!(file_table[fd].flags & (O_WRONLY | O_RDWR)))
+    if (!(file_table[fd]->flags & (O_WRONLY | O_RDWR)))
         return -1;
-    int bytes = fs_write_file(file_table[fd].inode_num, buffer, count, file_table[fd].position);
-    file_table[fd].position += bytes;
-    return bytes;
+
+    global_file_entry_t *f = file_table[fd];
+    const uint8_t *src = (const uint8_t *)buffer;
+
+    // Una escritura que no continúa el buffer actual lo vacía primero
+    if (f->wb >= 0 && f->position != wb_pool[f->wb].offset + wb_pool[f->wb].len)
+    {
+        if (file_wb_flush(fd) != 0)
+            return -1;
+    }
+
+    // Las escrituras grandes ya salen en rachas completas: van directas
+    if (f->wb < 0 && count >= WB_BUFFER_SIZE)
+    {
+        int bytes = fs_write_file(f->inode_num, buffer, count, f->position);
+        if (bytes > 0)
+            f->position += bytes;
+        return bytes;
+    }
+
+    // Lo copiado al buffer ya está aceptado (y la posición avanzada): si
+    // luego falla la escritura se devuelve lo aceptado, que sigue pendiente
+    // en el buffer, y -1 solo si no se aceptó nada
+    uint32_t done = 0;
+    while (done < count)
+    {
+        file_wb_t *wb = f->wb >= 0 ? &wb_pool[f->wb] : file_wb_acquire(fd);
+        if (!wb)
+            break;
+        uint32_t n = MIN(count - done, WB_BUFFER_SIZE - wb->len);
+
+        memcpy(wb->data + wb->len, src + done, n);
+        wb->len += n;
+        done += n;
+        f->position += n;
+
+        // Buffer lleno: escribir los bloques completos y conservar la cola
+        if (wb->len == WB_BUFFER_SIZE)
+        {
+            uint32_t end = wb->offset + wb->len;
+            if (file_wb_write(wb, end - end % fs_bsize - wb->offset) != 0)
+                break;
+        }
+    }
+
+    if (done == 0 && count != 0)
+        return -1;
+    fs_stats.wb_writes++;
+    return done;
 }
 
 int file_seek(int fd, uint32_t offset, int whence)
 {
-    if (fd < 0 || fd >= MAX_OPEN_FILES || !file_table[fd].in_use)
+    if (fd < 0 || fd >= MAX_OPEN_FILES || !file_table[fd])
         return -1;
-    inode_t *inode = fs_get_inode(file_table[fd].inode_num);
+    inode_t *inode = fs_get_inode(file_table[fd]->inode_num);
     if (!inode)
         return -1;
+    file_wb_flush_inode(file_table[fd]->inode_num);
 
     switch (whence)
     {
     case SEEK_SET:
-        file_table[fd].position = offset;
+        file_table[fd]->position = offset;
         break;
     case SEEK_CUR:
-        file_table[fd].position += offset;
+        file_table[fd]->position += offset;
         break;
     case SEEK_END:
-        file_table[fd].position = inode->size + offset;
+        file_table[fd]->position = inode->size + offset;
         break;
     default:
         return -1;
     }
 
-    if (file_table[fd].position > inode->size)
-        file_table[fd].position = inode->size;
+    if (file_table[fd]->position > inode->size)
+        file_table[fd]->position = inode->size;
 
-    return file_table[fd].position;
+    return file_table[fd]->position;
 }
 
 int file_tell(int fd)
 {
-    if (fd < 0 || fd >= MAX_OPEN_FILES || !file_table[fd].in_use)
+    if (fd < 0 || fd >= MAX_OPEN_FILES || !file_table[fd])
         return -1;
-    return file_table[fd].position;
+    return file_table[fd]->position;
 }
 
 int file_eof(int fd)
 {
-    if (fd < 0 || fd >= MAX_OPEN_FILES || !file_table[fd].in_use)
+    if (fd < 0 || fd >= MAX_OPEN_FILES || !file_table[fd])
         return 1;
-    inode_t *inode = fs_get_inode(file_table[fd].inode_num);
+    inode_t *inode = fs_get_inode(file_table[fd]->inode_num);
     if (!inode)
         return 1;
-    return file_table[fd].position >= inode->size;
+    file_wb_flush_inode(file_table[fd]->inode_num);
+    return file_table[fd]->position >= inode->size;
 }
@@ -0,0 +1,110 @@
+#include "fsmem.h"
+#include "cpu.h"
+#include "stdio.h"
+#include "string.h"
+
+#ifdef HOST_BUILD
+#include <stdlib.h>
+#else
+#include "page.h"
+#endif
+
+static uint8_t *fsmem_pool;
+static uint32_t fsmem_pool_size;
+static uint32_t fsmem_top;
+
+static arena_t fsmem_scratch_arenas[CPU_MAX];
+static uint32_t fsmem_scratch_size;
+
+// --- Memoria del pool ---
+#ifdef HOST_BUILD
+static void *fsmem_backing_alloc(uint32_t size)
+{
+    return malloc(size);
+}
+
+static void fsmem_backing_free(void *mem, uint32_t size)
+{
+    (void)size;
+    free(mem);
+}
+#else
+// Páginas contiguas: el pool es un único tramo con el mapa de identidad
+static void *fsmem_backing_alloc(uint32_t size)
+{
+    return page_alloc_contig((size + PAGE_SIZE - 1) >> PAGE_SHIFT);
+}
+
+static void fsmem_backing_free(void *mem, uint32_t size)
+{
+    page_free_contig(mem, (size + PAGE_SIZE - 1) >> PAGE_SHIFT);
+}
+#endif
+
+int fsmem_reset(uint32_t size)
+{
+    fsmem_top = 0;
+    fsmem_scratch_size = 0;
+    memset(fsmem_scratch_arenas, 0, sizeof(fsmem_scratch_arenas));
+
+    size = fsmem_size(size);
+    if (fsmem_pool && size <= fsmem_pool_size)
+        return 0;
+    if (fsmem_pool)
+        fsmem_backing_free(fsmem_pool, fsmem_pool_size);
+    fsmem_pool = size ? fsmem_backing_alloc(size) : NULL;
+    fsmem_pool_size = fsmem_pool ? size : 0;
+    return fsmem_pool || !size ? 0 : -1;
+}
+
+void *fsmem_alloc(uint32_t size)
+{
+    size = fsmem_size(size);
+    if (size > fsmem_pool_size - fsmem_top)
+        return NULL;
+
+    void *p = fsmem_pool + fsmem_top;
+    fsmem_top += size;
+    memset(p, 0, size);
+    return p;
+}
+
+uint32_t fsmem_used(void)
+{
+    return fsmem_top;
+}
+
+uint32_t fsmem_available(void)
+{
+    return fsmem_pool_size - fsmem_top;
+}
+
+// --- Memoria de trabajo ---
+int fsmem_scratch_setup(uint32_t size)
+{
+    fsmem_scratch_size = size < FSMEM_SCRATCH_MIN ? FSMEM_SCRATCH_MIN : size;
+    return fsmem_scratch() ? 0 : -1;
+}
+
+arena_t *fsmem_scratch(void)
+{
+    arena_t *a = &fsmem_scratch_arenas[cpu_id()];
+    if (!a->base)
+    {
+        void *mem = fsmem_scratch_size ? fsmem_alloc(fsmem_scratch_size) : NULL;
+        if (!mem)
+            return NULL;
+        arena_init(a, "fs-scratch", mem, fsmem_scratch_size);
+    }
+    return a;
+}
+
+void fsmem_print_stats(void)
+{
+    printf("fsmem: %u de %u bytes del pool en uso\n", fsmem_top, fsmem_pool_size);
+    for (uint32_t cpu = 0; cpu < CPU_MAX; cpu++)
+    {
+        if (fsmem_scratch_arenas[cpu].base)
+            arena_print_stats(&fsmem_scratch_arenas[cpu]);
+    }
+}
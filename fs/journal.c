@@ -0,0 +1,392 @@
+#include "journal.h"
+#include "fsmem.h"
+#include "timer.h"
+#include "stdio.h"
+#include "string.h"
+
+// Estado del área del diario (enabled = 0 en imágenes sin diario)
+static uint8_t journal_enabled = 0;
+static uint32_t journal_start;
+static uint32_t journal_nblocks;
+static uint32_t journal_head; // Siguiente bloque libre (relativo al área)
+static uint32_t journal_seq;  // Secuencia de la próxima transacción
+static uint32_t journal_bsize;
+static uint32_t journal_tx_max; // Bloques por transacción con este tamaño de bloque
+
+// Transacción abierta
+static uint32_t tx_blocks[JOURNAL_TX_MAX];
+static uint32_t tx_count;
+static uint32_t tx_ops;
+static uint64_t tx_since;
+static uint8_t tx_barrier;
+
+// Descriptor + copias se escriben juntos en una sola petición
+static uint8_t *journal_stage;
+
+static journal_stats_t journal_stats;
+
+// FNV-1a, como dirhash. Cubre el descriptor y las copias: un destino
+// corrupto invalida la transacción igual que una copia corrupta.
+static uint32_t journal_checksum(const uint8_t *data, uint32_t len)
+{
+    uint32_t h = 2166136261u;
+    for (uint32_t i = 0; i < len; i++)
+    {
+        h ^= data[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Los bloques sueltos salen del arena de trabajo; puede estar ocupado por
+// quien llama, así que cada reserva se comprueba. Si la cabecera no llega
+// al disco el área sigue llena: -1 y journal_head no cambia.
+static int journal_write_header(void)
+{
+    arena_t *scratch = fsmem_scratch();
+    arena_scope_t scope = arena_begin(scratch);
+    journal_header_t *hdr = (journal_header_t *)arena_zalloc(scratch, journal_bsize);
+    if (!hdr)
+    {
+        arena_end(scope);
+        return -1;
+    }
+    hdr->magic = JOURNAL_MAGIC;
+    hdr->seq = journal_seq;
+    int ret = bcache_write_blocks(journal_start, 1, hdr);
+    if (ret == 0)
+        journal_head = 1;
+    arena_end(scope);
+    return ret;
+}
+
+// Queda sitio en el área para una transacción máxima
+static inline int journal_has_room(void)
+{
+    return journal_head + journal_tx_max + 2 <= journal_nblocks;
+}
+
+// Destino válido para una copia: los metadatos fijos (superbloque, mapas,
+// inodos) quedan antes del área; directorio y bloques indirectos, después
+static inline int journal_valid_target(uint32_t block, uint32_t volume_blocks)
+{
+    return block < journal_start ||
+           (block >= journal_start + journal_nblocks && block < volume_blocks);
+}
+
+// --- Formateo y recuperación ---
+// Prepara el estado para el área [start, start + nblocks). Devuelve 1 si
+// está lista, 0 si el volumen no tiene un área utilizable (sin diario) y
+// -1 si no hay memoria para ella.
+static int journal_setup(uint32_t start, uint32_t nblocks)
+{
+    journal_start = start;
+    journal_nblocks = nblocks;
+    tx_count = tx_ops = 0;
+    tx_barrier = 0;
+    journal_enabled = 0;
+
+    journal_bsize = bcache_block_size();
+    if (journal_bsize == 0)
+        return -1;
+    journal_tx_max = MIN(JOURNAL_TX_MAX, JOURNAL_STAGE_SIZE / journal_bsize - 1);
+    if (nblocks <= journal_tx_max + 2)
+        return 0;
+
+    // La memoria de fsmem se renueva en cada montaje; los bloques sueltos
+    // (cabecera, commit) salen de la memoria de trabajo de cada operación
+    journal_stage = fsmem_alloc(JOURNAL_STAGE_SIZE);
+    return journal_stage && fsmem_scratch() ? 1 : -1;
+}
+
+int journal_format(uint32_t start, uint32_t nblocks)
+{
+    int r = journal_setup(start, nblocks);
+    if (r <= 0)
+        return r;
+
+    // Si el área ya tenía un diario, sus transacciones tienen secuencias
+    // menores que seq + nblocks: saltar por encima para no reaplicarlas nunca
+    arena_t *scratch = fsmem_scratch();
+    arena_scope_t scope = arena_begin(scratch);
+    journal_header_t *hdr = (journal_header_t *)arena_alloc(scratch, journal_bsize);
+    if (!hdr)
+    {
+        arena_end(scope);
+        return -1;
+    }
+    journal_enabled = 1;
+    bcache_read_blocks(start, 1, hdr);
+    journal_seq = hdr->magic == JOURNAL_MAGIC ? hdr->seq + nblocks : 1;
+    arena_end(scope);
+    return journal_write_header();
+}
+
+int journal_recover(uint32_t start, uint32_t nblocks, uint32_t volume_blocks)
+{
+    int r = journal_setup(start, nblocks);
+    if (r <= 0)
+        return r;
+
+    // Un bloque para la cabecera y después para cada commit
+    arena_t *scratch = fsmem_scratch();
+    arena_scope_t scope = arena_begin(scratch);
+    uint8_t *blk = arena_alloc(scratch, journal_bsize);
+    if (!blk)
+    {
+        arena_end(scope);
+        return -1;
+    }
+    bcache_read_blocks(start, 1, blk);
+    journal_header_t *hdr = (journal_header_t *)blk;
+    if (hdr->magic != JOURNAL_MAGIC)
+    {
+        arena_end(scope);
+        journal_seq = 1;
+        journal_enabled = 1;
+        return journal_write_header();
+    }
+
+    uint32_t seq = hdr->seq;
+    uint32_t pos = 1;
+    int replayed = 0;
+
+    // Reaplicar en orden las transacciones completas; la primera incompleta
+    // (o de una vuelta anterior del área) marca el final
+    for (;;)
+    {
+        journal_desc_t *desc = (journal_desc_t *)journal_stage;
+        if (pos + 2 > nblocks)
+            break;
+        bcache_read_blocks(start + pos, 1, desc);
+        if (desc->magic != JOURNAL_DESC_MAGIC || desc->seq != seq ||
+            desc->count == 0 || desc->count > journal_tx_max ||
+            pos + desc->count + 2 > nblocks)
+            break;
+
+        uint32_t count = desc->count;
+        bcache_read_blocks(start + pos + count + 1, 1, blk);
+        journal_commit_t *commit = (journal_commit_t *)blk;
+        if (commit->magic != JOURNAL_COMMIT_MAGIC || commit->seq != seq || commit->count != count)
+            break;
+        uint32_t checksum = commit->checksum;
+
+        bcache_read_blocks(start + pos + 1, count, journal_stage + journal_bsize);
+        if (journal_checksum(journal_stage, (count + 1) * journal_bsize) != checksum)
+            break;
+
+        // Con el checksum bien, un destino imposible solo puede ser un
+        // diario corrupto: se para ahí, sin escribir nada de esta transacción
+        uint32_t i;
+        for (i = 0; i < count && journal_valid_target(desc->blocks[i], volume_blocks); i++)
+            ;
+        if (i != count)
+        {
+            printf("journal: transaccion %u con destino %u no valido\n", seq, desc->blocks[i]);
+            break;
+        }
+
+        // Si algo no llega a su sitio la cabecera se queda como estaba: el
+        // siguiente montaje vuelve a reaplicar desde el principio
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (bcache_write_blocks(desc->blocks[i], 1, journal_stage + (i + 1) * journal_bsize) != 0)
+            {
+                arena_end(scope);
+                return -1;
+            }
+        }
+
+        pos += count + 2;
+        seq++;
+        replayed++;
+    }
+
+    arena_end(scope);
+
+    // Todo está en su sitio: empezar el área de nuevo tras lo reaplicado
+    journal_seq = seq;
+    journal_enabled = 1;
+    if (journal_write_header() != 0)
+        return -1;
+    journal_stats.replayed += replayed;
+    return replayed;
+}
+
+// --- Transacción abierta ---
+// Todo se decide antes de que la operación cambie nada: el commit de lo
+// anterior si no cabe entera, y con la transacción vacía, el reintento de
+// un checkpoint que falló
+int journal_begin_op(uint32_t blocks)
+{
+    if (!journal_enabled)
+        return 0;
+    if (blocks > journal_tx_max)
+        return -2;
+    if (tx_count + blocks > journal_tx_max && journal_commit() < 0)
+        return -1;
+    if (tx_count == 0 && !journal_has_room() && journal_checkpoint() != 0)
+        return -1;
+    return 0;
+}
+
+void journal_add(bcache_buf_t *buf)
+{
+    if (!journal_enabled || !buf || buf->pinned)
+        return;
+
+    // journal_begin_op reservó sitio para la operación entera: si aun así
+    // no cabe, la reserva estaba mal calculada. Un commit aquí partiría la
+    // operación; el bloque se queda sin fijar y se avisa.
+    if (tx_count == journal_tx_max)
+    {
+        printf("journal: bloque %u fuera de la reserva de la operacion\n", buf->block_num);
+        return;
+    }
+
+    if (tx_count == 0)
+        tx_since = timer_ticks();
+    bcache_pin(buf);
+    tx_blocks[tx_count++] = buf->block_num;
+}
+
+void journal_barrier(void)
+{
+    tx_barrier = 1;
+}
+
+void journal_end_op(void)
+{
+    if (!journal_enabled)
+        return;
+    if (tx_count != 0)
+        tx_ops++;
+
+    // Si no se completa, la barrera sigue pendiente para la siguiente
+    if (tx_barrier)
+    {
+        if (journal_commit() >= 0 && journal_checkpoint() == 0)
+            tx_barrier = 0;
+        return;
+    }
+
+    // Agrupar: commit cuando hay bastantes operaciones o cuando la
+    // transacción pasa de la mitad y la siguiente podría no caber
+    if (tx_ops >= JOURNAL_BATCH_OPS || tx_count > journal_tx_max / 2)
+        journal_commit();
+}
+
+// --- Commit y checkpoint ---
+// Si algún bloque no llega a su sitio, la cabecera no se reescribe: las
+// transacciones del área siguen siendo la única copia de esos cambios
+int journal_checkpoint(void)
+{
+    // La transacción abierta primero (ver journal_commit)
+    if (journal_enabled && tx_count != 0 && journal_commit() < 0)
+        return -1;
+    if (bcache_sync() < 0)
+        return -1;
+    if (!journal_enabled)
+        return 0;
+    if (journal_write_header() != 0)
+        return -1;
+    journal_stats.checkpoints++;
+    return 0;
+}
+
+int journal_commit(void)
+{
+    if (!journal_enabled || tx_count == 0)
+        return 0;
+
+    // Tras un checkpoint fallido el área puede no tener sitio: la
+    // transacción sigue abierta y fijada hasta que lo haya
+    if (journal_head + tx_count + 2 > journal_nblocks)
+        return -1;
+
+    // Sin memoria para el registro de commit no se escribe nada: la
+    // transacción sigue abierta y el siguiente commit lo reintenta
+    arena_t *scratch = fsmem_scratch();
+    arena_scope_t scope = arena_begin(scratch);
+    journal_commit_t *commit = (journal_commit_t *)arena_zalloc(scratch, journal_bsize);
+    if (!commit)
+    {
+        arena_end(scope);
+        return -1;
+    }
+
+    journal_desc_t *desc = (journal_desc_t *)journal_stage;
+    memset(journal_stage, 0, journal_bsize);
+    desc->magic = JOURNAL_DESC_MAGIC;
+    desc->seq = journal_seq;
+    desc->count = tx_count;
+
+    for (uint32_t i = 0; i < tx_count; i++)
+    {
+        // Fijado: siempre está en la caché
+        bcache_buf_t *buf = bcache_get(tx_blocks[i]);
+        if (!buf)
+        {
+            arena_end(scope);
+            return -1;
+        }
+        desc->blocks[i] = tx_blocks[i];
+        memcpy(journal_stage + (i + 1) * journal_bsize, buf->data, journal_bsize);
+        bcache_release(buf);
+    }
+
+    // Primero descriptor y copias; el commit va en una petición posterior
+    // para que nunca llegue al disco antes que los datos que valida
+    if (bcache_write_blocks(journal_start + journal_head, tx_count + 1, journal_stage) != 0)
+    {
+        arena_end(scope);
+        return -1;
+    }
+
+    commit->magic = JOURNAL_COMMIT_MAGIC;
+    commit->seq = journal_seq;
+    commit->count = tx_count;
+    commit->checksum = journal_checksum(journal_stage, (tx_count + 1) * journal_bsize);
+    int ret = bcache_write_blocks(journal_start + journal_head + tx_count + 1, 1, commit);
+    arena_end(scope);
+    if (ret != 0)
+        return -1;
+
+    // Con el commit en disco los bloques ya pueden ir a su sitio cuando sea
+    for (uint32_t i = 0; i < tx_count; i++)
+        bcache_unpin(tx_blocks[i]);
+
+    journal_stats.commits++;
+    journal_stats.ops += tx_ops;
+    journal_stats.blocks += tx_count + 2;
+
+    journal_head += tx_count + 2;
+    journal_seq++;
+    tx_count = 0;
+    tx_ops = 0;
+
+    // Si la transacción más grande ya no cabe, se vacía el área ahora, sin
+    // nada fijado: con una transacción abierta, bcache_sync no escribiría
+    // sus buffers, que también llevan cambios de transacciones anteriores,
+    // y la cabecera nueva descartaría esas transacciones del diario
+    if (!journal_has_room())
+        journal_checkpoint();
+    return 1;
+}
+
+void journal_commit_expired(uint64_t now)
+{
+    if (journal_enabled && tx_count != 0 && now - tx_since >= JOURNAL_MAX_AGE_TICKS)
+        journal_commit();
+}
+
+void journal_get_stats(journal_stats_t *out)
+{
+    if (out)
+        *out = journal_stats;
+}
+
+void journal_reset_stats(void)
+{
+    memset(&journal_stats, 0, sizeof(journal_stats));
+}
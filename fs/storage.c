@@ -1,4 +1,4 @@
 #include "fs.h"
 
-// Almacén global para simulación de disco (utilizado por ahci.c)
-uint8_t fs_storage[MAX_BLOCKS * BLOCK_SIZE];
+// Almacén global del disco en RAM (kernel/drivers/ramdisk.c)
+uint8_t fs_storage[FS_STORAGE_SIZE];
@@ -0,0 +1,60 @@
+#ifndef _ACPI_H
+#define _ACPI_H
+
+#include "stdint.h"
+
+// --- Tablas ACPI ---
+// Puntero raíz: en los primeros 1 KB de la EBDA o entre 0xE0000 y 0xFFFFF,
+// alineado a 16 bytes
+typedef struct
+{
+    char signature[8];     // "RSD PTR "
+    uint8_t checksum;      // Suma de los 20 primeros bytes
+    char oem_id[6];
+    uint8_t revision;      // 0: ACPI 1.0 (solo RSDT); 2: hay XSDT
+    uint32_t rsdt_address;
+    uint32_t length;       // Desde aquí solo si revision >= 2
+    uint64_t xsdt_address;
+    uint8_t ext_checksum;  // Suma de toda la estructura
+    uint8_t reserved[3];
+} __attribute__((packed)) acpi_rsdp_t;
+
+// Cabecera común de todas las tablas
+typedef struct
+{
+    char signature[4];
+    uint32_t length;       // Cabecera incluida
+    uint8_t revision;
+    uint8_t checksum;      // Suma de los length bytes
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed)) acpi_sdt_header_t;
+
+// MCFG: una entrada por región ECAM (configuración PCIe mapeada en memoria)
+typedef struct
+{
+    uint64_t base;         // Dirección del bus 0 de la región, aunque empiece en otro
+    uint16_t segment;
+    uint8_t start_bus;
+    uint8_t end_bus;
+    uint32_t reserved;
+} __attribute__((packed)) acpi_mcfg_entry_t;
+
+typedef struct
+{
+    acpi_sdt_header_t header;
+    uint64_t reserved;
+    acpi_mcfg_entry_t entries[];
+} __attribute__((packed)) acpi_mcfg_t;
+
+// Busca el RSDP y comprueba RSDT/XSDT. -1 si el firmware no publica ACPI.
+int acpi_init(void);
+
+// Primera tabla con esa firma ("MCFG", "APIC"...) y checksum correcto, o
+// NULL. Llama a acpi_init si hace falta.
+const acpi_sdt_header_t *acpi_find_table(const char *signature);
+
+#endif
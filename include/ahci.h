@@ -6,11 +6,182 @@
 // Tamaño de bloque típico de disco
 #define AHCI_BLOCK_SIZE 512
 
+// --- Parámetros del driver ---
+#define AHCI_MAX_SLOTS 32          // Ranuras de comando por puerto (máximo de la especificación)
+#define AHCI_PRDT_ENTRIES 32       // Descriptores de DMA (fragmentos) por comando
+#define AHCI_PRD_MAX_BYTES (4u << 20) // Bytes por descriptor (22 bits de cuenta)
+#define AHCI_MAX_CMD_SECTORS 2048  // Sectores por comando (1 MB)
+#define AHCI_BOUNCE_SIZE (64 * 1024) // Buffer para transferencias no alineadas
+#define AHCI_SPIN_TIMEOUT 10000000 // Iteraciones de espera activa antes de rendirse
+#define AHCI_TIMEOUT_TICKS 500     // Espera máxima durmiendo (5 s a 100 Hz)
+
+// --- Registros del HBA (memoria de BAR5) ---
+typedef volatile struct
+{
+    uint32_t clb;       // 0x00 Dirección de la lista de comandos (1 KB alineada)
+    uint32_t clbu;      // 0x04 Parte alta
+    uint32_t fb;        // 0x08 Dirección del área de FIS recibidos (256 B alineada)
+    uint32_t fbu;       // 0x0C Parte alta
+    uint32_t is;        // 0x10 Estado de interrupción
+    uint32_t ie;        // 0x14 Habilitación de interrupciones
+    uint32_t cmd;       // 0x18 Comando y estado
+    uint32_t rsv0;      // 0x1C
+    uint32_t tfd;       // 0x20 Task file (estado y error del dispositivo)
+    uint32_t sig;       // 0x24 Firma del dispositivo
+    uint32_t ssts;      // 0x28 SStatus
+    uint32_t sctl;      // 0x2C SControl
+    uint32_t serr;      // 0x30 SError
+    uint32_t sact;      // 0x34 SActive (NCQ)
+    uint32_t ci;        // 0x38 Comandos emitidos
+    uint32_t sntf;      // 0x3C Notificación SNotification
+    uint32_t fbs;       // 0x40 Conmutación basada en FIS
+    uint32_t rsv1[11];  // 0x44
+    uint32_t vendor[4]; // 0x70
+} hba_port_t;
+
+typedef volatile struct
+{
+    uint32_t cap;          // 0x00 Capacidades
+    uint32_t ghc;          // 0x04 Control global
+    uint32_t is;           // 0x08 Estado de interrupción (un bit por puerto)
+    uint32_t pi;           // 0x0C Puertos implementados
+    uint32_t vs;           // 0x10 Versión
+    uint32_t ccc_ctl;      // 0x14
+    uint32_t ccc_pts;      // 0x18
+    uint32_t em_loc;       // 0x1C
+    uint32_t em_ctl;       // 0x20
+    uint32_t cap2;         // 0x24
+    uint32_t bohc;         // 0x28 Traspaso BIOS/SO
+    uint8_t rsv[0xA0 - 0x2C];
+    uint8_t vendor[0x100 - 0xA0];
+    hba_port_t ports[32];  // 0x100
+} hba_mem_t;
+
+// Bits de registros usados por el driver
+#define AHCI_GHC_HR (1u << 0)   // Reset del HBA
+#define AHCI_GHC_IE (1u << 1)   // Interrupciones globales
+#define AHCI_GHC_AE (1u << 31)  // Modo AHCI
+#define AHCI_CAP_NCS(cap) ((((cap) >> 8) & 0x1F) + 1) // Ranuras de comando
+#define AHCI_CAP_SNCQ (1u << 30) // El HBA admite NCQ
+
+#define AHCI_PxCMD_ST (1u << 0)   // Arrancar el procesado de la lista
+#define AHCI_PxCMD_SUD (1u << 1)  // Spin-up
+#define AHCI_PxCMD_POD (1u << 2)  // Power on
+#define AHCI_PxCMD_FRE (1u << 4)  // Recepción de FIS
+#define AHCI_PxCMD_FR (1u << 14)  // Recepción de FIS en marcha
+#define AHCI_PxCMD_CR (1u << 15)  // Lista de comandos en marcha
+
+#define AHCI_PxIS_DHRS (1u << 0)  // FIS D2H recibido (fin de comando DMA)
+#define AHCI_PxIS_PSS (1u << 1)   // FIS PIO Setup (fin de IDENTIFY)
+#define AHCI_PxIS_SDBS (1u << 3)  // FIS Set Device Bits (fin de comandos NCQ)
+#define AHCI_PxIS_TFES (1u << 30) // Error en el task file
+#define AHCI_PxIE_DEFAULT (AHCI_PxIS_DHRS | AHCI_PxIS_PSS | AHCI_PxIS_SDBS | AHCI_PxIS_TFES)
+#define AHCI_PxTFD_ERR 0x01
+#define AHCI_PxTFD_DRQ 0x08
+#define AHCI_PxTFD_BSY 0x80
+
+#define AHCI_SSTS_DET_PRESENT 3 // Dispositivo presente y comunicación establecida
+#define AHCI_SSTS_IPM_ACTIVE 1
+#define AHCI_SIG_ATA 0x00000101
+
+// --- Estructuras en memoria compartidas con el HBA ---
+// Cabecera de comando (32 por puerto, en la lista de comandos)
+typedef struct
+{
+    uint16_t flags;  // CFL (bits 0-4), A, W (bit 6), P, R, B, C, PMP
+    uint16_t prdtl;  // Entradas de la PRDT
+    uint32_t prdbc;  // Bytes transferidos (lo escribe el HBA)
+    uint32_t ctba;   // Tabla de comando (128 B alineada)
+    uint32_t ctbau;
+    uint32_t rsv[4];
+} __attribute__((packed)) ahci_cmd_header_t;
+
+#define AHCI_CMD_WRITE (1u << 6)
+
+// Descriptor de región física (scatter-gather)
+typedef struct
+{
+    uint32_t dba;  // Dirección del buffer (par)
+    uint32_t dbau;
+    uint32_t rsv;
+    uint32_t dbc;  // Bytes - 1 (bit 0 a 1); bit 31 = interrupción al acabar
+} __attribute__((packed)) ahci_prd_t;
+
+// Tabla de comando: FIS a enviar y PRDT
+typedef struct
+{
+    uint8_t cfis[64];
+    uint8_t acmd[16];
+    uint8_t rsv[48];
+    ahci_prd_t prdt[AHCI_PRDT_ENTRIES];
+} __attribute__((packed)) ahci_cmd_table_t;
+
+// FIS registro host -> dispositivo
+typedef struct
+{
+    uint8_t type;    // FIS_TYPE_REG_H2D
+    uint8_t flags;   // Bit 7: es un comando
+    uint8_t command;
+    uint8_t feature_lo;
+    uint8_t lba0, lba1, lba2;
+    uint8_t device;
+    uint8_t lba3, lba4, lba5;
+    uint8_t feature_hi;
+    uint8_t count_lo, count_hi;
+    uint8_t icc;
+    uint8_t control;
+    uint8_t rsv[4];
+} __attribute__((packed)) ahci_fis_h2d_t;
+
+#define FIS_TYPE_REG_H2D 0x27
+
+// Comandos ATA
+#define ATA_CMD_READ_DMA_EXT 0x25
+#define ATA_CMD_WRITE_DMA_EXT 0x35
+#define ATA_CMD_READ_FPDMA_QUEUED 0x60
+#define ATA_CMD_WRITE_FPDMA_QUEUED 0x61
+#define ATA_CMD_IDENTIFY 0xEC
+
+// Fragmento de buffer de una petición
+typedef struct
+{
+    void *buf;
+    uint32_t bytes; // Bytes del fragmento (par, en dirección par)
+} ahci_iovec_t;
+
+// Contadores del driver
+typedef struct
+{
+    uint32_t commands; // Comandos emitidos
+    uint32_t sectors;  // Sectores transferidos
+    uint32_t errors;   // Comandos terminados con error
+    uint32_t bounced;  // Transferencias por el buffer intermedio
+    uint32_t max_inflight; // Máximo de comandos en vuelo a la vez
+    uint32_t interrupts;   // Interrupciones del puerto atendidas
+    uint32_t callbacks;    // Finalizaciones entregadas por callback
+} ahci_stats_t;
+
+// Aviso de fin de una petición asíncrona: status 0 si acabó bien, -1 si
+// falló. Puede llamarse desde la interrupción: no debe dormir ni esperar.
+typedef void (*ahci_done_fn)(void *ctx, int status);
+
 // Dispositivo AHCI
 typedef struct
 {
     uint64_t bar5; // Dirección base de la memoria mapeada
     uint8_t port;  // Puerto AHCI
+    hba_mem_t *hba;           // Registros del HBA
+    hba_port_t *regs;         // Registros del puerto en uso
+    uint32_t nslots;          // Ranuras que implementa el HBA
+    uint32_t busy;            // Ranuras emitidas pendientes de retirar
+    uint8_t ncq;              // Lecturas/escrituras con FPDMA QUEUED
+    uint32_t queue_depth;     // Ranuras usadas a la vez (cola NCQ del disco)
+    uint64_t sectors;         // Capacidad del disco
+    uint8_t irq;              // Línea del PIC (0xFF: sin interrupción, se sondea)
+    uint8_t irq_on;           // Las finalizaciones llegan por interrupción
+    uint32_t done;            // Retiradas sin callback que nadie ha recogido
+    uint32_t failed;          // De esas, las que acabaron con error
+    ahci_stats_t stats;
 } ahci_device_t;
 
 // Inicializa el controlador AHCI y detecta dispositivos SATA
@@ -22,4 +193,43 @@ int ahci_read_block(ahci_device_t *dev, uint32_t lba, void *buffer);
 // Escribir un bloque (512 bytes) al disco AHCI
 int ahci_write_block(ahci_device_t *dev, uint32_t lba, const void *buffer);
 
+// Leer/escribir count bloques contiguos. Las transferencias grandes se
+// reparten en varios comandos que están en vuelo a la vez.
+int ahci_read_blocks(ahci_device_t *dev, uint32_t lba, uint32_t count, void *buffer);
+int ahci_write_blocks(ahci_device_t *dev, uint32_t lba, uint32_t count, const void *buffer);
+
+// --- Interfaz asíncrona ---
+// Emite un comando de lectura/escritura de los sectores [lba, lba + count)
+// sobre los fragmentos iov (su suma debe ser count sectores). Devuelve la
+// ranura usada, o -1 si no hay ninguna libre o la petición no cabe.
+int ahci_submit(ahci_device_t *dev, int write, uint64_t lba, uint32_t count,
+                const ahci_iovec_t *iov, uint32_t iovcnt);
+
+// Como ahci_submit, pero el fin se avisa llamando a done(ctx, status) y la
+// ranura no hay que esperarla ni recogerla. iov solo se lee aquí; los
+// buffers tienen que seguir vivos hasta el aviso.
+int ahci_submit_async(ahci_device_t *dev, int write, uint64_t lba, uint32_t count,
+                      const ahci_iovec_t *iov, uint32_t iovcnt, ahci_done_fn done, void *ctx);
+
+// Retira las ranuras que el HBA ya completó y devuelve las emitidas con
+// ahci_submit que nadie había recogido (las erróneas, también en *failed).
+// Con la interrupción activa las retira ella y esto solo las recoge.
+uint32_t ahci_poll(ahci_device_t *dev, uint32_t *failed);
+
+// Espera a que termine la ranura slot. 0 si acabó bien.
+int ahci_wait(ahci_device_t *dev, int slot);
+
+// Espera a que pase algo: con interrupciones duerme hasta la siguiente,
+// sin ellas retira lo que haya acabado. Quien llama vuelve a comprobar su
+// condición; si el aviso llegó justo antes, el despertar es el tick del PIT.
+void ahci_sleep(ahci_device_t *dev);
+
+void ahci_get_stats(ahci_stats_t *out);
+
+#ifdef AHCI_BENCH
+// Lecturas secuenciales grandes para medir MB/s y barrido de profundidad
+// de cola (QD1..QD32) con lecturas aleatorias de 4 KB, con y sin NCQ
+void ahci_bench(void);
+#endif
+
 #endif
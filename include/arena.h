@@ -0,0 +1,47 @@
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include "stdint.h"
+
+// --- Arenas ---
+// Memoria de trabajo de vida corta: reservar es avanzar un puntero y todo
+// lo reservado dentro de un ámbito se libera de una vez al cerrarlo. La
+// memoria la pone quien crea el arena (alineada a ARENA_ALIGN). Los ámbitos
+// se anidan y se cierran en orden inverso; un arena no se comparte entre
+// CPUs ni se usa desde interrupciones.
+#define ARENA_ALIGN 16
+
+typedef struct
+{
+    const char *name;
+    uint8_t *base;
+    uint32_t size;
+    uint32_t top;       // Bytes reservados ahora
+    uint32_t high;      // Máximo de top: cuánto ha hecho falta de verdad
+    uint32_t depth;     // Ámbitos abiertos
+    uint32_t max_depth;
+    uint32_t scopes;    // Ámbitos cerrados
+    uint32_t allocs;
+    uint32_t failed;    // Reservas que no cupieron
+} arena_t;
+
+// Lo reservado después de arena_begin vuelve al arena con arena_end
+typedef struct
+{
+    arena_t *arena;
+    uint32_t mark;
+} arena_scope_t;
+
+void arena_init(arena_t *arena, const char *name, void *mem, uint32_t size);
+
+// arena puede ser NULL (sin memoria de trabajo): las reservas fallan
+arena_scope_t arena_begin(arena_t *arena);
+void arena_end(arena_scope_t scope);
+
+// Alineado a ARENA_ALIGN; NULL si no cabe. arena_zalloc lo devuelve a cero.
+void *arena_alloc(arena_t *arena, uint32_t size);
+void *arena_zalloc(arena_t *arena, uint32_t size);
+
+void arena_print_stats(const arena_t *arena);
+
+#endif
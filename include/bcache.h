@@ -0,0 +1,94 @@
+#ifndef _BCACHE_H
+#define _BCACHE_H
+
+#include "stdint.h"
+#include "fs.h"
+
+// Parámetros de la caché de bloques. El número de buffers depende del
+// tamaño de bloque del volumen: BCACHE_MEM_SIZE bytes repartidos entre ellos.
+#define BCACHE_MEM_SIZE (256 * 1024) // Memoria para el contenido de los buffers
+#define BCACHE_MAX_BUFS 256          // Tope de buffers (bloques pequeños)
+#define BCACHE_HASH_SIZE 256         // Cubetas de la tabla hash (potencia de 2)
+#define BCACHE_RA_MAX 32             // Máximo de bloques por petición de lectura anticipada
+#define BCACHE_RA_BYTES (32 * 1024)  // Máximo de bytes por petición de lectura anticipada
+#define BCACHE_RA_INFLIGHT 4         // Peticiones de lectura anticipada en vuelo a la vez
+
+// Buffer de un bloque en caché
+typedef struct bcache_buf
+{
+    uint32_t block_num;            // Bloque de disco que contiene
+    uint8_t valid;                 // El contenido corresponde a block_num
+    uint8_t dirty;                 // Modificado y pendiente de escribir a disco
+    uint8_t prefetched;            // Cargado por lectura anticipada y aún sin usar
+    uint8_t pinned;                // En una transacción del diario sin commit: no va a disco
+    volatile uint8_t loading;      // Lectura anticipada en vuelo: el contenido aún no ha llegado
+    volatile uint8_t io_error;     // La lectura anticipada falló: hay que volver a leerlo
+    uint32_t refcount;             // Usuarios activos (no se desaloja si > 0)
+    struct bcache_buf *hash_next;  // Siguiente en la cadena de la cubeta
+    struct bcache_buf *lru_prev;   // Lista LRU: hacia el más reciente
+    struct bcache_buf *lru_next;   // Lista LRU: hacia el menos reciente
+    uint8_t *data;                 // Contenido del bloque (block_size bytes)
+} bcache_buf_t;
+
+// Contadores de la caché
+typedef struct
+{
+    uint32_t hits;          // Búsquedas resueltas en memoria
+    uint32_t misses;        // Búsquedas que necesitaron el dispositivo
+    uint32_t evictions;     // Buffers válidos reutilizados para otro bloque
+    uint32_t writebacks;    // Bloques sucios escritos al dispositivo
+    uint32_t dev_reads;     // Lecturas emitidas al dispositivo
+    uint32_t dev_writes;    // Escrituras emitidas al dispositivo
+    uint32_t direct_blocks; // Bloques transferidos por E/S directa (sin buffer)
+    uint32_t ra_blocks;     // Bloques cargados por lectura anticipada
+    uint32_t ra_hits;       // Bloques anticipados que luego se usaron
+    uint32_t ra_wasted;     // Bloques anticipados desalojados sin usarse
+    uint32_t ra_async;      // Peticiones anticipadas emitidas sin esperarlas
+    uint32_t io_waits;      // Usos que tuvieron que esperar a una lectura en vuelo
+    uint32_t write_errors;  // Escrituras que el dispositivo no completó (el bloque sigue sucio)
+} bcache_stats_t;
+
+// (Re)inicia la caché para bloques de block_size bytes, descartando su
+// contenido. La memoria sale de fsmem.
+int bcache_init(uint32_t block_size);
+uint32_t bcache_block_size(void);
+// Bytes de fsmem que toma bcache_init con ese tamaño de bloque
+uint32_t bcache_mem_size(uint32_t block_size);
+// Espera a la E/S en vuelo sobre los buffers y deja la caché sin iniciar:
+// antes de liberar la memoria de fsmem que usa
+void bcache_quiesce(void);
+
+// Obtiene un bloque (leyéndolo si no está en caché) y toma una referencia
+bcache_buf_t *bcache_get(uint32_t block_num);
+
+// Obtiene un bloque sin leerlo del disco, con el contenido a cero.
+// Para bloques que se van a sobrescribir completos.
+bcache_buf_t *bcache_get_zero(uint32_t block_num);
+
+void bcache_mark_dirty(bcache_buf_t *buf);
+void bcache_release(bcache_buf_t *buf);
+
+// Fija/libera un buffer en la caché: mientras está fijado no se desaloja ni
+// se escribe a su sitio (lo usa el diario hasta el commit)
+void bcache_pin(bcache_buf_t *buf);
+void bcache_unpin(uint32_t block_num);
+
+// E/S directa de count bloques contiguos entre el dispositivo y buffer,
+// sin pasar por los buffers de la caché (pero coherente con ella).
+// -1 si el dispositivo falla.
+int bcache_read_blocks(uint32_t start, uint32_t count, void *buffer);
+int bcache_write_blocks(uint32_t start, uint32_t count, const void *buffer);
+
+// Lectura anticipada: carga en caché los bloques de la racha que falten.
+// Con un dispositivo asíncrono vuelve sin esperar a los datos; quien use
+// uno de esos bloques antes de que lleguen espera solo por él.
+int bcache_prefetch(uint32_t start, uint32_t count);
+
+// Escribe todos los bloques sucios no fijados al dispositivo. Devuelve
+// cuántos escribió, o -1 si alguno falló (esos siguen sucios en la caché).
+int bcache_sync(void);
+
+void bcache_get_stats(bcache_stats_t *out);
+void bcache_reset_stats(void);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef _BITMAP_H
+#define _BITMAP_H
+
+#include "stdint.h"
+
+// Mapas de bits organizados en palabras de 32 bits. El bit n vive en
+// words[n / 32], bit n % 32: en little-endian coincide con el layout por
+// bytes (bitmap[n / 8] bit n % 8) que ya usa el disco.
+#define BITMAP_WORD_BITS 32
+#define BITMAP_WORDS(bits) (((bits) + BITMAP_WORD_BITS - 1) / BITMAP_WORD_BITS)
+
+static inline int bitmap_test(const uint32_t *words, uint32_t bit)
+{
+    return (words[bit / BITMAP_WORD_BITS] >> (bit % BITMAP_WORD_BITS)) & 1;
+}
+
+static inline void bitmap_set(uint32_t *words, uint32_t bit)
+{
+    words[bit / BITMAP_WORD_BITS] |= 1u << (bit % BITMAP_WORD_BITS);
+}
+
+static inline void bitmap_clear(uint32_t *words, uint32_t bit)
+{
+    words[bit / BITMAP_WORD_BITS] &= ~(1u << (bit % BITMAP_WORD_BITS));
+}
+
+// Primer bit a 0 (o a 1) en [start, end); devuelve end si no hay ninguno
+uint32_t bitmap_find_zero(const uint32_t *words, uint32_t start, uint32_t end);
+uint32_t bitmap_find_one(const uint32_t *words, uint32_t start, uint32_t end);
+
+// Marca/limpia count bits a partir de start
+void bitmap_set_range(uint32_t *words, uint32_t start, uint32_t count);
+void bitmap_clear_range(uint32_t *words, uint32_t start, uint32_t count);
+
+#endif
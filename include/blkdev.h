@@ -0,0 +1,150 @@
+#ifndef _BLKDEV_H
+#define _BLKDEV_H
+
+#include "stdint.h"
+
+// --- Capa de dispositivos de bloques ---
+// Los drivers (AHCI, virtio-blk, NVMe, disco en RAM, imagen del host) se registran aquí y el
+// sistema de archivos les pide E/S por sectores. Cada dispositivo tiene una
+// cola que fusiona peticiones contiguas y las ordena por LBA antes de
+// pasarlas al driver.
+
+#define BLK_SECTOR_SIZE 512
+#define BLK_MAX_DEVICES 8
+#define BLK_NAME_LEN 8
+#define BLK_MAX_IOV 32            // Fragmentos por petición (también tras fusionar)
+#define BLK_NR_REQUESTS 64        // Peticiones del pool de blkdev_get_request
+#define BLK_DEADLINE_TICKS 50     // Espera en cola antes de saltarse el orden (500 ms)
+#define BLK_BOUNCE_SIZE (64 * 1024) // Buffer intermedio para buffers mal alineados
+#define BLK_LAT_BUCKETS 16        // Histograma de latencia: [2^i, 2^(i+1)) us
+
+// Fragmento de buffer de una petición
+typedef struct
+{
+    void *buf;
+    uint32_t bytes;
+} blk_iovec_t;
+
+// Aviso de fin: status 0 si acabó bien, -1 si falló. Puede llamarse desde
+// una interrupción: no debe dormir ni esperar a otra petición.
+typedef void (*blk_done_fn)(void *ctx, int status);
+
+// Petición de E/S. Desde blkdev_submit hasta el aviso pertenece a la capa:
+// al fusionarla con otras pueden cambiar lba, count e iov.
+typedef struct blk_request
+{
+    int write;
+    uint64_t lba;                  // Primer sector
+    uint32_t count;                // Sectores (la suma de iov)
+    blk_iovec_t iov[BLK_MAX_IOV];
+    uint32_t iovcnt;
+    blk_done_fn done;
+    void *ctx;
+
+    // Uso interno de la capa
+    struct blkdev *dev;
+    struct blk_request *next;      // Siguiente en la cola (ordenada por LBA)
+    struct blk_request *merged;    // Peticiones que viajan con esta
+    uint64_t queued_at;            // Tick de llegada (plazo)
+    uint64_t start_us;             // Llegada (latencia)
+    uint8_t pooled;                // Vuelve al pool tras el aviso
+    uint8_t in_use;
+} blk_request_t;
+
+// Contadores de un dispositivo
+typedef struct
+{
+    uint32_t requests;        // Peticiones recibidas
+    uint32_t dispatched;      // Enviadas al driver (tras fusionar)
+    uint32_t merges;          // Peticiones que viajaron dentro de otra
+    uint32_t deadline;        // Despachadas por plazo vencido, fuera de orden
+    uint32_t errors;          // Peticiones terminadas con error
+    uint32_t sectors_read;
+    uint32_t sectors_written;
+    uint32_t max_queued;      // Máximo esperando en cola
+    uint32_t max_inflight;    // Máximo en el driver a la vez
+    uint32_t depth_sum;       // Suma de la profundidad (cola + driver) al llegar cada petición
+    uint32_t lat_us[BLK_LAT_BUCKETS];
+} blkdev_stats_t;
+
+struct blkdev;
+
+// Operaciones del driver
+typedef struct
+{
+    // Empieza la petición; al terminar el driver llama a blkdev_complete.
+    // -1 si ahora no puede aceptarla (la capa la reintenta tras otro fin).
+    int (*submit)(struct blkdev *dev, blk_request_t *req);
+    // Espera a que avance alguna petición en vuelo (NULL: todo es síncrono)
+    void (*wait)(struct blkdev *dev);
+    // Tras una tanda de submit: avisar al dispositivo una sola vez por todas
+    // (timbre, notificación). NULL si submit ya las pone en marcha.
+    void (*commit)(struct blkdev *dev);
+} blkdev_ops_t;
+
+typedef struct blkdev
+{
+    // Lo rellena el driver antes de registrarlo
+    char name[BLK_NAME_LEN];
+    uint64_t sectors;          // Capacidad
+    uint32_t max_sectors;      // Sectores por petición
+    uint32_t max_iov;          // Fragmentos por petición
+    uint32_t max_inflight;     // Peticiones en el driver a la vez
+    uint32_t align;            // Alineación de los fragmentos (potencia de 2)
+    const blkdev_ops_t *ops;
+    void *priv;
+
+    // Cola
+    blk_request_t *queue;      // Pendientes de despachar, por LBA
+    uint32_t queued;
+    uint32_t inflight;
+    uint64_t next_lba;         // Posición del elevador (C-LOOK)
+    uint32_t plugged;          // Con tapón se acumula sin despachar
+    uint8_t dispatching;
+    blkdev_stats_t stats;
+} blkdev_t;
+
+// --- Registro ---
+int blkdev_register(blkdev_t *dev);
+blkdev_t *blkdev_find(const char *name);
+// El primero que se registró: el disco del que arranca el sistema de archivos
+blkdev_t *blkdev_root(void);
+
+// --- E/S asíncrona ---
+// Petición del pool (espera si no hay); vuelve sola al pool tras el aviso
+blk_request_t *blkdev_get_request(blkdev_t *dev);
+// Encola la petición. -1 si es inválida (no habrá aviso; las del pool se
+// devuelven al pool).
+int blkdev_submit(blkdev_t *dev, blk_request_t *req);
+// Lo llama el driver al terminar una petición que aceptó
+void blkdev_complete(blk_request_t *req, int status);
+// Espera a que avance alguna petición del dispositivo
+void blkdev_wait(blkdev_t *dev);
+
+// Tapón: mientras está puesto las peticiones se acumulan (y se fusionan);
+// al quitarlo se despachan en orden
+void blkdev_plug(blkdev_t *dev);
+void blkdev_unplug(blkdev_t *dev);
+
+// --- E/S síncrona ---
+// count sectores desde lba; las transferencias grandes van en varias
+// peticiones en vuelo a la vez
+int blkdev_read(blkdev_t *dev, uint64_t lba, uint32_t count, void *buffer);
+int blkdev_write(blkdev_t *dev, uint64_t lba, uint32_t count, const void *buffer);
+
+// --- Medidas ---
+void blkdev_get_stats(blkdev_t *dev, blkdev_stats_t *out);
+void blkdev_reset_stats(blkdev_t *dev);
+void blkdev_print_stats(blkdev_t *dev);
+
+#ifdef BLK_BENCH
+// Lecturas secuenciales y aleatorias (QD1..QD32) sobre cada dispositivo
+// registrado, por la misma capa: compara virtio-blk, NVMe, AHCI y el disco
+// en RAM
+void blkdev_bench(void);
+#endif
+
+// Disco en RAM sobre fs_storage (kernel/drivers/ramdisk.c)
+int ramdisk_init(void);
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef _CPU_H
+#define _CPU_H
+
+#include "stdint.h"
+
+// Instrucciones de CPU que usan los drivers y las medidas
+
+// Contador de ciclos (TSC)
+static inline uint64_t rdtsc(void)
+{
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t *a, uint32_t *b, uint32_t *c, uint32_t *d)
+{
+    __asm__ volatile("cpuid" : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d) : "a"(leaf), "c"(subleaf));
+}
+
+static inline uint64_t rdmsr(uint32_t msr)
+{
+    uint32_t lo, hi;
+    __asm__ volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value)
+{
+    __asm__ volatile("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+// Espera activa amable con el otro hilo del núcleo (y con QEMU)
+static inline void cpu_relax(void)
+{
+    __asm__ volatile("pause" ::: "memory");
+}
+
+// Barrera del compilador: los accesos a memoria compartida con un
+// dispositivo (DMA) no se reordenan a través de ella
+static inline void barrier(void)
+{
+    __asm__ volatile("" ::: "memory");
+}
+
+// Barrera completa: además ordena una escritura con una lectura posterior,
+// que x86 sí puede adelantar. Con lock en lugar de mfence (no exige SSE2).
+static inline void full_barrier(void)
+{
+    __asm__ volatile("lock; addl $0, (%%esp)" ::: "memory", "cc");
+}
+
+// --- CPUs ---
+// Solo corre la CPU de arranque. Lo que es por CPU se indexa ya con
+// cpu_id(), que devolverá el índice de cada una cuando se levanten las demás.
+#define CPU_MAX 8
+
+static inline uint32_t cpu_id(void)
+{
+    return 0;
+}
+
+// --- Interrupciones ---
+#define CPU_EFLAGS_IF (1u << 9)
+
+#ifdef HOST_BUILD
+// En el host (tools/) no hay interrupciones: todo corre en un solo hilo
+static inline int irqs_enabled(void) { return 0; }
+static inline uint32_t irq_save(void) { return 0; }
+static inline void irq_restore(uint32_t flags) { (void)flags; }
+#else
+
+static inline uint32_t cpu_eflags(void)
+{
+    uint32_t flags;
+    __asm__ volatile("pushfl; popl %0" : "=r"(flags));
+    return flags;
+}
+
+static inline int irqs_enabled(void)
+{
+    return (cpu_eflags() & CPU_EFLAGS_IF) != 0;
+}
+
+// Deshabilita las interrupciones y devuelve el estado anterior para
+// restaurarlo con irq_restore (las secciones se pueden anidar)
+static inline uint32_t irq_save(void)
+{
+    uint32_t flags = cpu_eflags();
+    __asm__ volatile("cli" ::: "memory");
+    return flags;
+}
+
+static inline void irq_restore(uint32_t flags)
+{
+    if (flags & CPU_EFLAGS_IF)
+        __asm__ volatile("sti" ::: "memory");
+}
+#endif // HOST_BUILD
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef _DIRHASH_H
+#define _DIRHASH_H
+
+#include "stdint.h"
+#include "fs.h"
+
+// Índice hash del directorio raíz. No se guarda en disco: se reconstruye al
+// montar a partir de los dir_entry_t, así el formato en disco no cambia.
+
+// El índice no guarda los nombres: cuando coincide el hash pregunta si el
+// de la posición slot del directorio es name (distinto de 0 si lo es)
+typedef int (*dirhash_match_t)(uint32_t slot, const char *name);
+
+// Dimensiona el índice para max_entries nombres (memoria de fsmem). La tabla
+// tiene al menos el doble de entradas; como los huecos se reutilizan antes
+// de crecer, las posiciones no pasan de max_entries más un bloque.
+int dirhash_init(uint32_t max_entries, uint32_t entries_per_block, dirhash_match_t match);
+// Bytes de fsmem que toma dirhash_init
+uint32_t dirhash_mem_size(uint32_t max_entries, uint32_t entries_per_block);
+void dirhash_reset(void);
+
+// Registra/quita un nombre que ocupa la posición slot del directorio. El
+// nombre ya tiene que estar escrito en esa posición (y seguir ahí al
+// quitarlo): las búsquedas lo leen de allí.
+int dirhash_insert(const char *name, uint32_t inode_num, uint32_t slot);
+int dirhash_remove(const char *name);
+int dirhash_lookup(const char *name, uint32_t *inode_num, uint32_t *slot);
+uint32_t dirhash_count(void);
+
+// Entradas de la tabla visitadas por las búsquedas (también las de
+// dirhash_insert para ver si el nombre ya existe)
+typedef struct
+{
+    uint32_t lookups;
+    uint32_t probes;     // Suma de entradas visitadas
+    uint32_t max_probes; // La búsqueda más larga
+} dirhash_stats_t;
+
+void dirhash_get_stats(dirhash_stats_t *out);
+void dirhash_reset_stats(void);
+
+// Posiciones libres del directorio. Las posiciones a partir de la cola
+// (tail) aún no tienen bloque de directorio asignado.
+void dirhash_set_tail(uint32_t tail);
+void dirhash_put_free_slot(uint32_t slot);
+int dirhash_take_free_slot(uint32_t *slot);
+int dirhash_is_free_slot(uint32_t slot);
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef _DIV64_H
+#define _DIV64_H
+
+#include "stdint.h"
+
+// División de 64 bits entre 32 sin libgcc (__udivdi3 no se enlaza): dos
+// divl encadenadas, la parte alta primero. Devuelve el cociente y, si rem
+// no es NULL, el resto.
+static inline uint64_t div64_u32(uint64_t n, uint32_t d, uint32_t *rem)
+{
+    uint32_t hi = (uint32_t)(n >> 32);
+    uint32_t lo = (uint32_t)n;
+    uint32_t q_hi = hi / d;
+    uint32_t r = hi % d;
+    uint32_t q_lo;
+
+    __asm__("divl %4" : "=a"(q_lo), "=d"(r) : "a"(lo), "d"(r), "rm"(d));
+    if (rem)
+        *rem = r;
+    return ((uint64_t)q_hi << 32) | q_lo;
+}
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef _E820_H
+#define _E820_H
+
+#include "stdint.h"
+
+// --- Mapa de memoria del BIOS (int 0x15, eax = 0xE820) ---
+// boot/boot.asm lo deja aquí antes de saltar al kernel: número de entradas
+// (32 bits) y detrás las entradas tal como las devuelve el BIOS
+#define E820_MAP_ADDR 0x500
+#define E820_MAX_ENTRIES 32
+
+#define E820_RAM 1
+#define E820_RESERVED 2
+#define E820_ACPI 3 // Tablas ACPI, reutilizable tras leerlas
+#define E820_NVS 4
+#define E820_BAD 5
+
+typedef struct
+{
+    uint64_t base;
+    uint64_t length;
+    uint32_t type;
+    uint32_t acpi; // ACPI 3.0: bit 0 a cero, entrada que hay que ignorar
+} __attribute__((packed)) e820_entry_t;
+
+typedef struct
+{
+    uint32_t count;
+    e820_entry_t entries[E820_MAX_ENTRIES];
+} __attribute__((packed)) e820_map_t;
+
+// La dirección pasa por un registro: GCC trata las constantes tan bajas
+// como punteros nulos desplazados y avisa del acceso
+static inline const e820_map_t *e820_map(void)
+{
+    uint32_t p = E820_MAP_ADDR;
+    __asm__("" : "+r"(p));
+    return (const e820_map_t *)p;
+}
+
+#endif
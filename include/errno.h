@@ -1,4 +1,11 @@
+// Compilación en el host (tools/): se usa la biblioteca del sistema
+#ifdef HOST_BUILD
+#include_next <errno.h>
+#else
+
 #ifndef _ERRNO_H
 #define _ERRNO_H
 
-#endif
\ No newline at end of file
+#endif
+
+#endif // HOST_BUILD
@@ -2,12 +2,22 @@
 #define _FILE_H
 
 #include "stdint.h"
+#include "fs.h" // FS_MAX_BLOCK_SIZE
 
 // Constantes para archivos
 #define MAX_OPEN_FILES 64 // Global Open File Table (GOFT)
 #define MAX_PROCESS_FD 16 // Máx descriptores por proceso
 #define EOF (-1)
 
+// Lectura anticipada (en bloques)
+#define RA_MIN_WINDOW 4  // Ventana inicial al detectar acceso secuencial
+#define RA_MAX_WINDOW 32 // Tope de la ventana (<= BCACHE_RA_MAX)
+
+// Escritura diferida: buffers compartidos por los archivos abiertos
+#define WB_BUFFERS 8          // Buffers en el pool
+#define WB_BUFFER_SIZE (2 * FS_MAX_BLOCK_SIZE) // Bytes por buffer (al menos un bloque completo al llenarse)
+#define WB_MAX_AGE_TICKS 100  // Antigüedad máxima de datos pendientes (1 s a 100 Hz)
+
 // Modos de apertura de archivo
 #define O_RDONLY 0x01
 #define O_WRONLY 0x02
@@ -23,7 +33,10 @@ typedef struct
     uint32_t position;  // Posición actual en el archivo
     uint32_t flags;     // Banderas de apertura
     uint32_t refcount;  // Cuántos procesos comparten esta entrada
-    uint8_t in_use;     // Entrada activa
+    uint32_t ra_next;   // Bloque lógico que seguiría a la última lectura
+    uint32_t ra_window; // Ventana de lectura anticipada (0 = acceso aleatorio)
+    uint32_t ra_end;    // Primer bloque lógico aún no anticipado
+    int wb;             // Buffer de escritura diferida (-1 = ninguno)
 } global_file_entry_t;
 
 extern global_file_entry_t global_file_table[MAX_OPEN_FILES];
@@ -49,6 +62,8 @@ int file_write(int fd, const void *buffer, uint32_t count);
 int file_seek(int fd, uint32_t offset, int whence);
 int file_tell(int fd);
 int file_eof(int fd);
+int file_fsync(int fd);
+void file_flush_expired(uint64_t now);
 
 // Constantes para file_seek
 #define SEEK_SET 0
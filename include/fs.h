@@ -3,14 +3,25 @@
 
 #include "stdint.h"
 #include "sys/types.h"
+#include "bitmap.h"
 
 // Constantes del sistema de archivos
 #define MAX_FILENAME 32
-#define MAX_FILES 64
-#define BLOCK_SIZE 512
-#define MAX_BLOCKS 1024
 #define INODE_SIZE 64
 
+// Tamaños de bloque admitidos (potencias de 2, múltiplos del sector)
+#define FS_MIN_BLOCK_SIZE 512
+#define FS_MAX_BLOCK_SIZE 4096
+
+// Disco en RAM usado cuando no hay AHCI
+#define FS_STORAGE_SIZE (512 * 1024)
+
+// Geometría por defecto de fs_format(): el disco en RAM en bloques de 512
+#define FS_DEFAULT_BLOCK_SIZE 512
+#define FS_DEFAULT_BLOCKS (FS_STORAGE_SIZE / FS_DEFAULT_BLOCK_SIZE)
+#define FS_DEFAULT_INODES 64
+#define FS_DEFAULT_JOURNAL_BLOCKS 64
+
 // Número mágico del sistema de archivos
 #define FS_MAGIC 0x12345678
 
@@ -29,6 +40,7 @@
 #define FS_ERROR_INVALID_PARAM -3
 #define FS_ERROR_ALREADY_EXISTS -4
 #define FS_ERROR_NOT_INITIALIZED -5
+#define FS_ERROR_IO -6
 
 // Estructura del superbloque
 typedef struct
@@ -41,15 +53,46 @@ typedef struct
     uint32_t first_data_block; // Primer bloque de datos
     uint32_t block_size;       // Tamaño de bloque
     uint32_t inode_size;       // Tamaño de inodo
+    uint32_t journal_start;    // Primer bloque del diario (0 = sin diario)
+    uint32_t journal_blocks;   // Bloques reservados para el diario
+    // Disposición de los metadatos (0 en volúmenes anteriores: se calcula)
+    uint32_t block_bitmap_start;
+    uint32_t block_bitmap_blocks;
+    uint32_t inode_bitmap_start;
+    uint32_t inode_bitmap_blocks;
+    uint32_t inode_table_start;
+    uint32_t inode_table_blocks;
 } superblock_t;
 
+// Geometría elegida al formatear
+typedef struct
+{
+    uint32_t block_size;     // Bytes por bloque (FS_MIN_BLOCK_SIZE..FS_MAX_BLOCK_SIZE)
+    uint32_t total_blocks;   // Bloques del volumen
+    uint32_t total_inodes;   // Inodos (incluido el del directorio raíz)
+    uint32_t journal_blocks; // Bloques del diario (0 = sin diario)
+} fs_geometry_t;
+
+// Extensión: racha de bloques físicos contiguos del archivo
+typedef struct
+{
+    uint32_t start;  // Primer bloque físico
+    uint32_t length; // Número de bloques
+} fs_extent_t;
+
+#define FS_INODE_EXTENTS 6                                 // Extensiones dentro del inodo
+#define FS_INDIRECT_EXTENTS(bs) ((bs) / sizeof(fs_extent_t)) // Extensiones en el bloque indirecto
+
 // Estructura del inodo
+// Las extensiones cubren el archivo en orden lógico y sin huecos: la
+// extensión i empieza en el bloque lógico suma(length de las anteriores).
 typedef struct
 {
-    uint32_t size;           // Tamaño del archivo en bytes
-    uint32_t type;           // Tipo de archivo
-    uint32_t blocks[12];     // Bloques directos
-    uint32_t indirect_block; // Bloque indirecto
+    uint32_t size;                         // Tamaño del archivo en bytes
+    uint32_t type;                         // Tipo de archivo
+    uint32_t extent_count;                 // Extensiones en uso
+    fs_extent_t extents[FS_INODE_EXTENTS]; // Extensiones directas
+    uint32_t indirect_block;               // Bloque con extensiones adicionales
     uint32_t created_time;   // Tiempo de creación
     uint32_t modified_time;  // Tiempo de modificación
     uint32_t permissions;    // Permisos del archivo
@@ -65,21 +108,29 @@ typedef struct
     uint8_t name_len;            // Longitud del nombre
 } dir_entry_t;
 
-// Mapa de bits para bloques libres
-typedef struct
-{
-    uint8_t bitmap[MAX_BLOCKS / 8];
-} block_bitmap_t;
+// Disposición de metadatos en disco: superbloque, mapa de bloques, mapa de
+// inodos, tabla de inodos, diario y datos. Los tamaños dependen de la
+// geometría y quedan guardados en el superbloque.
+#define FS_SUPERBLOCK_BLOCK 0
+#define FS_BLOCK_BITMAP_BLOCK 1
+#define FS_INODES_PER_BLOCK(bs) ((bs) / sizeof(inode_t))
+#define FS_DIR_ENTRIES_PER_BLOCK(bs) ((bs) / sizeof(dir_entry_t))
 
-// Mapa de bits para inodos libres
+// Estadísticas de escritura de metadatos
 typedef struct
 {
-    uint8_t bitmap[MAX_FILES / 8];
-} inode_bitmap_t;
+    uint32_t ops;                 // Operaciones terminadas (cada una hace un flush)
+    uint32_t meta_blocks_written; // Total de bloques de metadatos escritos
+    uint32_t last_op_blocks;      // Bloques escritos por la última operación
+    uint32_t max_op_blocks;       // Máximo de bloques escritos por una operación
+    uint32_t wb_writes;           // Llamadas a file_write absorbidas por un buffer
+    uint32_t wb_flushes;          // Vaciados de buffers de escritura diferida
+} fs_stats_t;
 
 // Funciones del sistema de archivos
 int fs_init(void);
 int fs_format(void);
+int fs_format_geometry(const fs_geometry_t *geo);
 int fs_create_file(const char *filename, uint32_t type);
 int fs_delete_file(const char *filename);
 int fs_open_file(const char *filename);
@@ -88,13 +139,24 @@ int fs_read_file(int fd, void *buffer, uint32_t size, uint32_t offset);
 int fs_write_file(int fd, const void *buffer, uint32_t size, uint32_t offset);
 int fs_get_file_size(const char *filename);
 int fs_list_directory(const char *dirname, dir_entry_t *entries, uint32_t max_entries);
+int fs_sync(void);
+int fs_unmount(void);
+void fs_get_stats(fs_stats_t *out);
+void fs_reset_stats(void);
 
 // Funciones internas
 uint32_t fs_allocate_block(void);
+uint32_t fs_allocate_blocks(uint32_t goal, uint32_t count, uint32_t *allocated);
 void fs_free_block(uint32_t block_num);
+void fs_free_blocks(uint32_t start, uint32_t count);
 uint32_t fs_allocate_inode(void);
 void fs_free_inode(uint32_t inode_num);
 inode_t *fs_get_inode(uint32_t inode_num);
+void fs_mark_inode_dirty(uint32_t inode_num);
+uint32_t fs_bmap(const inode_t *inode, uint32_t lblock, uint32_t *run);
+uint32_t fs_inode_blocks(const inode_t *inode);
 int fs_find_file(const char *filename, uint32_t *inode_num);
+int fs_check_dir_index(void);
+int fs_check(void);
 
 #endif
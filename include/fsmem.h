@@ -0,0 +1,47 @@
+#ifndef _FSMEM_H
+#define _FSMEM_H
+
+#include "stdint.h"
+#include "arena.h"
+#include "fs.h"
+
+// Memoria del sistema de archivos. Las estructuras cuyo tamaño depende de
+// la geometría (mapas de bits, tabla de inodos, buffers de la caché...)
+// salen de un pool que se pide al montar o formatear con el tamaño que
+// necesita ese volumen: páginas contiguas del asignador de marcos en el
+// kernel, malloc en el host.
+#define FSMEM_ALIGN 16
+
+// Lo que ocupa una reserva de size bytes dentro del pool
+static inline uint32_t fsmem_size(uint32_t size)
+{
+    return (size + FSMEM_ALIGN - 1) & ~(FSMEM_ALIGN - 1);
+}
+
+// Libera el pool anterior y pide uno de size bytes (antes de montar o
+// formatear; nadie puede seguir usando lo reservado). -1 si no hay memoria.
+int fsmem_reset(uint32_t size);
+
+// Reserva size bytes alineados a FSMEM_ALIGN y a cero; NULL si no queda sitio
+void *fsmem_alloc(uint32_t size);
+
+uint32_t fsmem_used(void);
+uint32_t fsmem_available(void);
+
+// --- Memoria de trabajo de las operaciones ---
+// Cada CPU tiene su arena, sacado del pool, para los buffers temporales de
+// una operación (un bloque del diario, los mapas de fs_check...): se abre un
+// ámbito con arena_begin(fsmem_scratch()) y se cierra con arena_end. Nada
+// de buffers estáticos compartidos entre operaciones.
+#define FSMEM_SCRATCH_MIN (2 * FS_MAX_BLOCK_SIZE)
+
+// Tamaño de los arenas tras montar o formatear; reserva el de esta CPU
+// (las demás lo sacan del pool la primera vez que lo piden, si queda
+// sitio). -1 si no cabe.
+int fsmem_scratch_setup(uint32_t size);
+// El de esta CPU; NULL antes de fsmem_scratch_setup o si no cabe
+arena_t *fsmem_scratch(void);
+
+void fsmem_print_stats(void);
+
+#endif
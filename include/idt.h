@@ -7,4 +7,32 @@ void pic_remap(void);
 void isr_init(void); // stubs de 0–31
 void irq_init(void); // stubs de 32–47
 
+// --- Líneas IRQ del PIC ---
+#define IRQ_BASE 32  // Vector de la línea 0 tras pic_remap
+#define IRQ_COUNT 16
+#define IRQ_MAX_HANDLERS 4 // Manejadores por línea (las de PCI se comparten)
+
+typedef void (*irq_handler_t)(void);
+
+// Añade un manejador a la línea irq (0-15) y la desenmascara. Con la línea
+// compartida se llama a todos; cada uno comprueba si su dispositivo avisó.
+int irq_register(uint8_t irq, irq_handler_t handler);
+// Quita el manejador; la línea queda enmascarada si no le queda ninguno
+void irq_unregister(uint8_t irq, irq_handler_t handler);
+void irq_unmask(uint8_t irq);
+void irq_mask(uint8_t irq);
+
+// --- Vectores propios (MSI/MSI-X) ---
+// Por encima de las líneas del PIC. Llegan por el APIC local, uno por fuente:
+// el manejador no tiene que averiguar quién avisó.
+#define IRQ_VECTOR_BASE (IRQ_BASE + IRQ_COUNT)
+#define IRQ_VECTOR_COUNT 32
+
+typedef void (*irq_vector_handler_t)(void *arg);
+
+// Reserva un vector para handler(arg), con las interrupciones deshabilitadas
+// y antes del EOI como en las líneas. -1 si no quedan o no hay APIC local.
+int irq_alloc_vector(irq_vector_handler_t handler, void *arg);
+void irq_free_vector(uint8_t vector);
+
 #endif
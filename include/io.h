@@ -10,6 +10,17 @@
  * reemplázalas por las llamadas apropiadas.
  */
 
+#ifdef HOST_BUILD
+// En el host (tools/) no hay puertos: las escrituras se ignoran y las
+// lecturas devuelven todo a 1, como un puerto sin dispositivo
+static inline uint8_t inb(uint16_t port) { (void)port; return 0xFF; }
+static inline void outb(uint16_t port, uint8_t val) { (void)port; (void)val; }
+static inline uint16_t inw(uint16_t port) { (void)port; return 0xFFFF; }
+static inline void outw(uint16_t port, uint16_t val) { (void)port; (void)val; }
+static inline uint32_t inl(uint16_t port) { (void)port; return 0xFFFFFFFFu; }
+static inline void outl(uint16_t port, uint32_t val) { (void)port; (void)val; }
+#else
+
 static inline uint8_t inb(uint16_t port) {
     uint8_t val;
     __asm__ volatile ("inb %w1, %0" : "=a"(val) : "Nd"(port));
@@ -40,4 +51,6 @@ static inline void outl(uint16_t port, uint32_t val) {
     __asm__ volatile ("outl %0, %w1" :: "a"(val), "Nd"(port));
 }
 
+#endif // HOST_BUILD
+
 #endif // _IO_H
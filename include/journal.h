@@ -0,0 +1,95 @@
+#ifndef _JOURNAL_H
+#define _JOURNAL_H
+
+#include "stdint.h"
+#include "bcache.h"
+
+// Diario de metadatos (write-ahead). Ocupa superblock.journal_blocks bloques
+// tras la tabla de inodos:
+//   [cabecera][desc][copias...][commit][desc][copias...][commit]...
+// Las transacciones se añaden en orden; tras el commit que deja sin sitio
+// para una transacción máxima se hace un checkpoint (todo a su sitio) y el
+// área se reutiliza desde el principio. Nunca se vacía a mitad de una, y
+// una operación nunca se reparte entre dos transacciones.
+#define JOURNAL_MAGIC 0x4A524E4C        // Cabecera
+#define JOURNAL_DESC_MAGIC 0x4A444553   // Descriptor de transacción
+#define JOURNAL_COMMIT_MAGIC 0x4A434D54 // Registro de commit
+
+#define JOURNAL_TX_MAX 32              // Bloques por transacción (quedan buffers libres en bcache)
+#define JOURNAL_STAGE_SIZE (64 * 1024) // Área de paso de un commit (limita la transacción con bloques grandes)
+#define JOURNAL_BATCH_OPS 8         // Operaciones agrupadas en un commit
+#define JOURNAL_MAX_AGE_TICKS 50    // Antigüedad máxima de una transacción abierta
+
+// Cabecera del diario (primer bloque del área)
+typedef struct
+{
+    uint32_t magic;
+    uint32_t seq; // Secuencia de la primera transacción válida tras la cabecera
+} journal_header_t;
+
+// Descriptor: bloques de destino de las copias que le siguen
+typedef struct
+{
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t count;
+    uint32_t blocks[JOURNAL_TX_MAX];
+} journal_desc_t;
+
+// Registro de commit: la transacción solo es válida si existe y cuadra
+typedef struct
+{
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t count;
+    uint32_t checksum; // FNV-1a del descriptor y las copias
+} journal_commit_t;
+
+typedef struct
+{
+    uint32_t commits;     // Transacciones escritas
+    uint32_t ops;         // Operaciones incluidas en ellas
+    uint32_t blocks;      // Bloques escritos al diario (incluye desc y commit)
+    uint32_t checkpoints; // Reutilizaciones del área
+    uint32_t replayed;    // Transacciones aplicadas al montar
+} journal_stats_t;
+
+// Prepara un área vacía (formateo) o recupera una existente (montaje).
+// journal_recover devuelve cuántas transacciones se reaplicaron; solo
+// escribe en bloques del volumen (volume_blocks) fuera del área. Las dos
+// devuelven -1 si el dispositivo falla o no hay memoria para el diario: el
+// volumen no se debe usar.
+int journal_format(uint32_t start, uint32_t nblocks);
+int journal_recover(uint32_t start, uint32_t nblocks, uint32_t volume_blocks);
+
+// Principio de una operación que añadirá como mucho blocks bloques, antes
+// de cambiar nada. Si no caben en la transacción abierta se hace commit
+// ahora, nunca a mitad de la operación; si el área se quedó sin sitio por
+// un checkpoint fallido, se reintenta. -1 si el dispositivo falla y -2 si
+// blocks no cabe en ninguna transacción: la operación no debe empezar.
+int journal_begin_op(uint32_t blocks);
+
+// Añade un buffer de metadatos modificado a la transacción abierta. Queda
+// fijado en la caché hasta el commit para que no llegue a disco antes.
+void journal_add(bcache_buf_t *buf);
+
+// Fin de una operación: hace commit cuando se ha agrupado suficiente
+void journal_end_op(void);
+
+// Pide commit y checkpoint al final de la operación en curso (p. ej. al
+// liberar un bloque que el diario aún podría reaplicar)
+void journal_barrier(void);
+
+// 1 si escribió una transacción, 0 si no había nada y -1 si falló (la
+// transacción sigue abierta)
+int journal_commit(void);
+void journal_commit_expired(uint64_t now);
+
+// Escribe todo a su sitio y vacía el diario. -1 si algo no llegó al disco:
+// el diario se conserva entero.
+int journal_checkpoint(void);
+
+void journal_get_stats(journal_stats_t *out);
+void journal_reset_stats(void);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef LAPIC_H
+#define LAPIC_H
+#include <stdint.h>
+
+// --- APIC local ---
+// Recibe los mensajes MSI/MSI-X. El PIC sigue entrando por LINT0 (modo de
+// cable virtual), así que las líneas 0-15 no cambian.
+#define LAPIC_SPURIOUS_VECTOR 0xFF
+#define LAPIC_MSI_ADDRESS 0xFEE00000 // Dirección de los mensajes MSI; bits 12-19: APIC destino
+
+// Habilita el APIC local de esta CPU. -1 si no hay (los vectores propios no
+// se pueden reservar y los drivers se quedan con sus líneas INTx).
+int lapic_init(void);
+int lapic_enabled(void);
+uint8_t lapic_id(void);
+void lapic_eoi(void);
+
+// Dirección y dato de un mensaje MSI con ese vector hacia esta CPU
+uint32_t lapic_msi_address(void);
+uint32_t lapic_msi_data(uint8_t vector);
+
+#ifdef IRQ_BENCH
+// Latencia de la interrupción hasta el manejador: autoenvío por el APIC
+// local frente al PIT entrando por el PIC. Con las interrupciones habilitadas.
+void irq_bench(void);
+#endif
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef _NVME_H
+#define _NVME_H
+
+#include "stdint.h"
+
+// --- Parámetros del driver ---
+#define NVME_PAGE_SIZE 4096           // Página de memoria del controlador (CC.MPS = 0)
+#define NVME_ADMIN_DEPTH 16           // Entradas de la cola de administración
+#define NVME_IO_DEPTH 64              // Entradas de cada cola de E/S (máximo)
+#define NVME_MAX_IO_QUEUES 2          // Parejas de colas de E/S: lecturas y escrituras
+#define NVME_MAX_INFLIGHT 64          // Peticiones de la capa de bloques en vuelo
+#define NVME_MAX_CMD_SECTORS 512      // Sectores por comando (256 KB)
+#define NVME_PRP_ENTRIES 64           // Lista PRP por comando: 256 KB + página inicial
+#define NVME_TIMEOUT_TICKS 500        // Espera máxima de un comando de administración (5 s)
+
+// --- Registros del controlador (BAR0) ---
+typedef volatile struct
+{
+    uint64_t cap;   // 0x00 Capacidades
+    uint32_t vs;    // 0x08 Versión
+    uint32_t intms; // 0x0C Enmascarar interrupciones
+    uint32_t intmc; // 0x10 Desenmascarar interrupciones
+    uint32_t cc;    // 0x14 Configuración
+    uint32_t rsv0;  // 0x18
+    uint32_t csts;  // 0x1C Estado
+    uint32_t nssr;  // 0x20
+    uint32_t aqa;   // 0x24 Tamaños de la cola de administración
+    uint64_t asq;   // 0x28 Cola de envío de administración
+    uint64_t acq;   // 0x30 Cola de finalización de administración
+} __attribute__((packed)) nvme_regs_t;
+
+#define NVME_CAP_MQES(cap) ((uint32_t)((cap) & 0xFFFF) + 1)   // Entradas máximas por cola
+#define NVME_CAP_TO(cap) ((uint32_t)((cap) >> 24) & 0xFF)     // Espera de RDY, en 500 ms
+#define NVME_CAP_DSTRD(cap) ((uint32_t)((cap) >> 32) & 0xF)   // Separación de timbres
+#define NVME_CAP_MPSMIN(cap) ((uint32_t)((cap) >> 48) & 0xF)  // Página mínima: 2^(12 + n)
+
+#define NVME_CC_EN (1u << 0)
+#define NVME_CC_IOSQES (6u << 16) // Entradas de envío de 64 bytes
+#define NVME_CC_IOCQES (4u << 20) // Entradas de finalización de 16 bytes
+#define NVME_CSTS_RDY (1u << 0)
+#define NVME_CSTS_CFS (1u << 1)   // Fallo fatal del controlador
+
+#define NVME_DOORBELL_BASE 0x1000
+
+// --- Comandos ---
+// Entrada de una cola de envío
+typedef struct
+{
+    uint8_t opcode;
+    uint8_t flags;
+    uint16_t cid;   // Identificador que vuelve en la finalización
+    uint32_t nsid;
+    uint64_t rsv;
+    uint64_t mptr;
+    uint64_t prp1;  // Primera página de datos
+    uint64_t prp2;  // Segunda página o lista PRP
+    uint32_t cdw10;
+    uint32_t cdw11;
+    uint32_t cdw12;
+    uint32_t cdw13;
+    uint32_t cdw14;
+    uint32_t cdw15;
+} __attribute__((packed)) nvme_cmd_t;
+
+// Entrada de una cola de finalización
+typedef struct
+{
+    uint32_t result;
+    uint32_t rsv;
+    uint16_t sq_head; // Hasta dónde ha consumido el controlador la cola de envío
+    uint16_t sq_id;
+    uint16_t cid;
+    uint16_t status;  // Bit 0: fase; resto: código de estado (0 = éxito)
+} __attribute__((packed)) nvme_cpl_t;
+
+#define NVME_ADMIN_CREATE_SQ 0x01
+#define NVME_ADMIN_CREATE_CQ 0x05
+#define NVME_ADMIN_IDENTIFY 0x06
+#define NVME_ADMIN_SET_FEATURES 0x09
+
+#define NVME_CMD_WRITE 0x01
+#define NVME_CMD_READ 0x02
+
+#define NVME_IDENTIFY_NS 0x00
+#define NVME_IDENTIFY_CTRL 0x01
+#define NVME_FEAT_NUM_QUEUES 0x07
+
+// --- Estado del driver ---
+struct nvme_io;
+
+// Pareja de colas envío/finalización
+typedef struct
+{
+    uint16_t qid;
+    uint16_t depth;
+    nvme_cmd_t *sq;
+    nvme_cpl_t *cq;
+    volatile uint32_t *sq_db;     // Timbre de cola (tail) de envío
+    volatile uint32_t *cq_db;     // Timbre de cabeza de finalización
+    uint16_t sq_tail;             // Siguiente entrada a escribir
+    uint16_t sq_rung;             // sq_tail en el último timbre
+    uint16_t cq_head;             // Siguiente entrada a leer
+    uint8_t phase;                // Fase que marca las entradas nuevas
+    uint16_t free_cids[NVME_IO_DEPTH];
+    uint16_t nfree;
+    struct nvme_io *cid_io[NVME_IO_DEPTH]; // Petición de cada comando en vuelo
+    uint32_t interrupts;          // Avisos por el vector MSI-X de la cola
+} nvme_queue_t;
+
+// Contadores del driver
+typedef struct
+{
+    uint32_t commands;     // Comandos de E/S emitidos
+    uint32_t split;        // Peticiones que necesitaron varios comandos
+    uint32_t prp_lists;    // Comandos con lista PRP (más de dos páginas)
+    uint32_t sq_doorbells; // Escrituras en timbres de envío
+    uint32_t cq_doorbells; // Escrituras en timbres de finalización
+    uint32_t completions;  // Entradas de finalización recogidas
+    uint32_t interrupts;
+    uint32_t errors;
+} nvme_stats_t;
+
+typedef struct
+{
+    uint64_t bar0;
+    nvme_regs_t *regs;
+    uint32_t dstrd;            // Separación de timbres en bytes
+    uint32_t nsid;             // Espacio de nombres en uso
+    uint64_t sectors;          // Capacidad del espacio de nombres
+    uint32_t max_sectors;      // Por comando (MDTS)
+    uint8_t irq;               // Línea del PIC (0xFF: sin interrupción, se sondea)
+    uint8_t irq_on;
+    uint8_t msix;              // Un vector MSI-X por cola de E/S en lugar de la línea
+    uint8_t vectors[NVME_MAX_IO_QUEUES]; // Vector de cada cola (entrada MSI-X i + 1)
+    uint32_t inflight;         // Peticiones de la capa en vuelo
+    nvme_queue_t admin;
+    nvme_queue_t io[NVME_MAX_IO_QUEUES];
+    uint32_t nio;              // Parejas de E/S creadas
+    nvme_stats_t stats;
+} nvme_device_t;
+
+// Busca el controlador (clase 0x01, subclase 0x08), crea la cola de
+// administración y las de E/S y registra el espacio de nombres 1 en la capa
+// de bloques como "nvme0". -1 si no hay controlador utilizable.
+int nvme_init(void);
+
+void nvme_get_stats(nvme_stats_t *out);
+void nvme_print_stats(void);
+
+#endif
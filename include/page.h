@@ -0,0 +1,85 @@
+#ifndef _PAGE_H
+#define _PAGE_H
+
+#include "stdint.h"
+
+// --- Marcos de página físicos (buddy) ---
+// Bloques de 2^order páginas alineados a su tamaño, con una lista libre por
+// orden: reservar y liberar cuestan O(PAGE_MAX_ORDER). Con el mapa de
+// identidad (paging.h) la dirección devuelta es la física, válida para DMA.
+#define PAGE_SIZE 4096
+#define PAGE_SHIFT 12
+#define PAGE_MAX_ORDER 10 // Bloque mayor: 2^10 páginas (4 MB)
+
+// Almacenes por CPU: pilas de bloques libres de los órdenes pequeños delante
+// de las listas. Reservar y liberar solo tocan el buddy para rellenar o
+// vaciar medio almacén de una vez.
+#define PAGE_MAG_ORDERS 4 // Órdenes 0-3 (hasta 32 KB): slabs y kmalloc grandes
+#define PAGE_MAG_SIZE 32
+#define PAGE_MAG_BATCH 16
+
+// Sin mapa E820 se supone RAM de 1 MB a 16 MB
+#define PAGE_FALLBACK_END 0x1000000
+
+// Estado de cada marco
+typedef struct page
+{
+    struct page *next; // Lista libre de su orden (solo el primero del bloque)
+    struct page *prev;
+    uint8_t order;     // Del bloque que encabeza, libre o reservado
+    uint8_t flags;
+    uint16_t run;      // Con PAGE_CONTIG: páginas de la ejecución
+    void *owner;       // Slab al que pertenece la página (NULL si no es de uno)
+} page_t;
+
+#define PAGE_FREE 0x01     // Encabeza un bloque libre
+#define PAGE_HEAD 0x02     // Encabeza un bloque reservado con page_alloc
+#define PAGE_RESERVED 0x04 // Fuera de la RAM utilizable (BIOS, kernel, tabla)
+#define PAGE_CACHED 0x08   // Con PAGE_HEAD: libre, guardado en un almacén
+#define PAGE_CONTIG 0x10   // Encabeza una ejecución de page_alloc_contig
+
+typedef struct
+{
+    uint32_t total_pages;   // Marcos que gestiona el asignador
+    uint32_t free_pages;    // En las listas del buddy
+    uint32_t cached_pages;  // Libres en los almacenes por CPU
+    uint32_t free_blocks[PAGE_MAX_ORDER + 1];
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t failed;
+    uint32_t splits;        // Bloques partidos para servir un orden menor
+    uint32_t merges;        // Uniones con el compañero al liberar
+    uint32_t refills;       // Lotes del buddy a un almacén
+    uint32_t drains;        // Lotes de un almacén al buddy
+} page_stats_t;
+
+// Lee el mapa E820 y deja libre la RAM por encima del kernel. -1 si no hay
+// memoria utilizable.
+int page_init(void);
+
+// 2^order páginas contiguas, alineadas a su tamaño; NULL si no hay
+void *page_alloc(uint32_t order);
+// Libera un bloque de page_alloc (el orden lo recuerda el asignador)
+void page_free(void *addr);
+// Devuelve al buddy los almacenes de esta CPU
+void page_drain(void);
+
+// Ejecución de count páginas contiguas (buffers de DMA). Lo que sobra hasta
+// la potencia de 2 vuelve a las listas libres al momento. page_free_contig
+// solo acepta la dirección y el count con que se reservó.
+void *page_alloc_contig(uint32_t count);
+void page_free_contig(void *addr, uint32_t count);
+
+// Estado del marco que contiene addr; NULL fuera de la memoria gestionada
+page_t *page_lookup(const void *addr);
+
+void page_get_stats(page_stats_t *out);
+void page_print_stats(void);
+
+#ifdef PAGE_BENCH
+// Pares reservar/liberar con y sin almacén y carga aleatoria de órdenes
+// mezclados
+void page_bench(void);
+#endif
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef _PAGING_H
+#define _PAGING_H
+
+#include "stdint.h"
+
+// --- Paginación de 32 bits ---
+// Mapa de identidad: la dirección virtual es la física, así que los buffers
+// de DMA y los punteros del kernel siguen valiendo tal cual. El kernel va en
+// páginas de 4 MB (PSE) globales, que sobreviven a la recarga de CR3; la
+// demás RAM, en páginas de 4 KB. Los registros de los dispositivos solo son
+// accesibles tras mapearlos con paging_map_mmio, sin caché.
+#define PAGING_LARGE_SIZE 0x400000
+
+// Bits de las entradas del directorio y de las tablas
+#define PTE_PRESENT 0x001
+#define PTE_WRITE 0x002
+#define PTE_PWT 0x008    // Escritura directa
+#define PTE_PCD 0x010    // Sin caché
+#define PTE_ACCESSED 0x020
+#define PTE_DIRTY 0x040
+#define PDE_LARGE 0x080  // Solo en el directorio: página de 4 MB
+#define PTE_GLOBAL 0x100 // No se descarta al recargar CR3 (CR4.PGE)
+
+typedef struct
+{
+    uint32_t large_pages; // Entradas de 4 MB del directorio
+    uint32_t small_pages; // Entradas de 4 KB
+    uint32_t tables;      // Tablas de páginas (un marco cada una)
+    uint32_t mmio_pages;  // De 4 KB, sin caché
+    uint32_t pse;         // La CPU admite páginas de 4 MB
+    uint32_t pge;         // Y entradas globales
+} paging_stats_t;
+
+// Construye el directorio y activa la paginación. Después de page_init (las
+// tablas salen de sus marcos) y antes de tocar cualquier registro MMIO.
+int paging_init(void);
+int paging_enabled(void);
+
+// Mapea [phys, phys + size) en la misma dirección con esos bits y la
+// devuelve; NULL si pasa de 4 GB o no quedan marcos para las tablas. Los
+// tramos de 4 MB enteros y alineados van en una página grande. Lo que ya
+// cubre una página grande del kernel se deja como está. Sin paginación
+// activa devuelve phys sin más.
+void *paging_map(uint64_t phys, uint32_t size, uint32_t flags);
+// Registros de un dispositivo: escritura, sin caché
+void *paging_map_mmio(uint64_t phys, uint32_t size);
+
+void paging_get_stats(paging_stats_t *out);
+void paging_print_stats(void);
+
+#ifdef PAGING_BENCH
+// Recorrido de páginas tras recargar CR3: RAM en páginas grandes globales
+// frente a RAM en páginas de 4 KB
+void paging_bench(void);
+#endif
+
+#endif
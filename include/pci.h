@@ -4,6 +4,28 @@
 
 #include "stdint.h"
 
+#define PCI_MAX_DEVICES 64 // Funciones que guarda la enumeración
+#define PCI_MAX_DRIVERS 8
+#define PCI_MAX_ECAM 4     // Regiones de la tabla MCFG que se usan
+#define PCI_CONFIG_SIZE 4096 // Configuración por función con ECAM (256 por puertos)
+#define PCI_ANY_ID 0xFFFF
+
+/* Bits del registro de comando (0x04) */
+#define PCI_COMMAND_IO 0x001
+#define PCI_COMMAND_MEMORY 0x002
+#define PCI_COMMAND_MASTER 0x004 // Bus master: la función puede hacer DMA
+#define PCI_COMMAND_INTX_DISABLE 0x400
+
+/* Capacidades (lista desde 0x34) */
+#define PCI_STATUS_CAP_LIST 0x10
+#define PCI_CAP_ID_MSI 0x05
+#define PCI_CAP_ID_MSIX 0x11
+
+/* Clase, subclase y prog-if en un solo valor (bytes 2, 1 y 0) */
+#define PCI_CLASS(c, s, p) (((uint32_t)(c) << 16) | ((uint32_t)(s) << 8) | (uint32_t)(p))
+
+struct pci_driver;
+
 typedef struct
 {
     uint16_t vendor_id;
@@ -15,16 +37,86 @@ typedef struct
     uint8_t subclass;
     uint8_t class_code;
     uint8_t header_type;
+    uint8_t irq_line;      // Línea del PIC que asignó el BIOS (0xFF: ninguna)
+    uint8_t secondary_bus; // Puentes: bus que hay detrás
+    uint8_t msi_cap;       // Offset de la capacidad MSI (0: no tiene)
+    uint8_t msix_cap;      // Offset de la capacidad MSI-X (0: no tiene)
+    const struct pci_driver *driver; // NULL hasta que un driver lo acepta
 } pci_device_t;
 
-/* Lectura/escritura de configuración PCI vía ports 0xCF8/0xCFC */
-uint32_t pci_read_config_32(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset);
-void pci_write_config_32(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint32_t value);
+/* Identificadores que acepta un driver. PCI_ANY_ID vale cualquiera; de la
+   clase solo cuentan los bits de class_mask (0: no importa). */
+typedef struct
+{
+    uint16_t vendor;
+    uint16_t device;
+    uint32_t class_code; // PCI_CLASS(...)
+    uint32_t class_mask;
+} pci_id_t;
+
+typedef struct pci_driver
+{
+    const char *name;
+    const pci_id_t *ids; // Acaba en una entrada a cero
+    // 0 si se queda con el dispositivo
+    int (*probe)(pci_device_t *dev, const pci_id_t *id);
+} pci_driver_t;
+
+/* Lectura/escritura de configuración PCI. Por ECAM (tabla MCFG) si el
+   firmware lo ofrece; si no, vía ports 0xCF8/0xCFC, donde los offsets desde
+   256 leen 0xFFFFFFFF y no escriben nada. */
+uint32_t pci_read_config_32(uint8_t bus, uint8_t slot, uint8_t func, uint16_t offset);
+void pci_write_config_32(uint8_t bus, uint8_t slot, uint8_t func, uint16_t offset, uint32_t value);
+
+/* 1 si la configuración extendida (offsets 256..4095) es accesible */
+int pci_ecam_enabled(void);
 
 /* Devuelve el BAR físico (64-bit si aplica) */
 uint64_t pci_get_bar(uint8_t bus, uint8_t slot, uint8_t func, uint8_t bar_index);
 
+/* Enumera una vez todos los buses siguiendo los puentes y ofrece cada
+   función a los drivers ya registrados. Devuelve cuántas funciones hay. */
+int pci_init(void);
+uint32_t pci_device_count(void);
+pci_device_t *pci_get_device(uint32_t index);
+
+/* Registra un driver y lo prueba con las funciones libres que encajan.
+   Devuelve a cuántas se ha unido (0 si aún no se ha enumerado), -1 si no
+   caben más drivers. */
+int pci_register_driver(const pci_driver_t *drv);
+
+/* Activa bits del registro de comando y deja la línea INTx habilitada */
+void pci_enable_device(pci_device_t *dev, uint16_t bits);
+
+/* Offset de la capacidad cap_id en la lista de la función, 0 si no está */
+uint8_t pci_find_capability(uint8_t bus, uint8_t slot, uint8_t func, uint8_t cap_id);
+
+/* MSI con un solo mensaje: la función avisa escribiendo vector en el APIC
+   local y deja de usar INTx. -1 sin capacidad MSI o sin APIC local. */
+int pci_enable_msi(pci_device_t *dev, uint8_t vector);
+
+/* Entradas de la tabla MSI-X (0: sin MSI-X) */
+uint32_t pci_msix_count(pci_device_t *dev);
+
+/* Programa la entrada entry de la tabla MSI-X con vector y la desenmascara.
+   La primera llamada activa MSI-X con las demás entradas enmascaradas y
+   apaga INTx. El BAR de la tabla tiene que tener la memoria habilitada. */
+int pci_msix_set(pci_device_t *dev, uint32_t entry, uint8_t vector);
+
+/* Apaga MSI y MSI-X y devuelve la función a su línea INTx */
+void pci_disable_msi(pci_device_t *dev);
+
 /* Buscar primer dispositivo AHCI (class=0x01, subclass=0x06, prog-if=0x01) */
 int pci_find_ahci(pci_device_t *out_dev);
 
+/* Buscar el primer dispositivo de esa clase, subclase y prog-if */
+int pci_find_class(uint8_t class_code, uint8_t subclass, uint8_t prog_if, pci_device_t *out_dev);
+
+/* Buscar el primer dispositivo con ese vendor/device ID */
+int pci_find_device(uint16_t vendor, uint16_t device, pci_device_t *out_dev);
+
+#ifdef PCI_DEBUG
+void pci_dump_all(void);
+#endif
+
 #endif // _PCI_H
@@ -0,0 +1,97 @@
+#ifndef _SLAB_H
+#define _SLAB_H
+
+#include "stdint.h"
+#include "cpu.h"
+
+// --- Cachés de objetos (slab) ---
+// Cada caché reparte objetos de un tamaño desde slabs de 2^order páginas
+// del asignador de marcos. La cabecera del slab y la lista libre de índices
+// van al principio: los objetos libres no se tocan y conservan lo que dejó
+// el constructor, que solo corre cuando se crea el slab.
+#define SLAB_NAME_LEN 16
+#define SLAB_MAX_ORDER 3 // Slabs de hasta 8 páginas
+
+// Clases de kmalloc: potencias de 2 de 8 a 2048 bytes. Lo mayor sale
+// directamente en páginas.
+#define KMALLOC_MIN_SHIFT 3
+#define KMALLOC_MAX_SHIFT 11
+#define KMALLOC_CLASSES (KMALLOC_MAX_SHIFT - KMALLOC_MIN_SHIFT + 1)
+
+// Almacén por CPU delante de cada caché: reservar y liberar son un pop y
+// un push; los slabs solo se tocan para rellenar o vaciar medio almacén.
+#define SLAB_MAG_SIZE 16
+#define SLAB_MAG_BATCH 8
+
+typedef void (*slab_ctor_t)(void *obj);
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t allocs; // Servidos por este almacén, en líneas de su CPU
+    uint32_t frees;
+    void *objects[SLAB_MAG_SIZE];
+} slab_mag_t;
+
+struct slab_cache;
+
+typedef struct slab
+{
+    struct slab *next; // En la lista parcial, llena o vacía de la caché
+    struct slab *prev;
+    struct slab_cache *cache;
+    uint8_t *objects;  // Primer objeto
+    uint16_t free;     // Índice del primer libre (SLAB_END: ninguno)
+    uint16_t inuse;
+    uint16_t next_free[]; // Siguiente libre de cada objeto
+} slab_t;
+
+#define SLAB_END 0xFFFF
+
+typedef struct slab_cache
+{
+    char name[SLAB_NAME_LEN];
+    uint32_t size;        // Objeto, redondeado a la alineación
+    uint32_t align;
+    uint32_t order;       // Páginas por slab: 2^order
+    uint32_t per_slab;
+    uint32_t offset;      // Del primer objeto desde el principio del slab
+    slab_ctor_t ctor;
+    slab_t *partial;      // Primero se reparte de aquí
+    slab_t *full;
+    slab_t *empty;        // Como mucho uno; el resto vuelve a las páginas
+    uint32_t nslabs;
+    uint32_t nempty;
+    uint32_t inuse;       // Objetos fuera de los slabs (almacenes incluidos)
+    uint32_t refills;     // Lotes de los slabs a un almacén
+    uint32_t drains;      // Lotes de un almacén a los slabs
+    slab_mag_t mags[CPU_MAX];
+    struct slab_cache *next; // Todas las cachés
+} slab_cache_t;
+
+// Crea las cachés de kmalloc. Después de page_init.
+int slab_init(void);
+
+// align 0: 8 bytes. ctor puede ser NULL; los objetos se devuelven en el
+// estado que deja el constructor.
+slab_cache_t *slab_cache_create(const char *name, uint32_t size, uint32_t align, slab_ctor_t ctor);
+void *slab_alloc(slab_cache_t *cache);
+void slab_free(slab_cache_t *cache, void *obj);
+// Vacía el almacén de esta CPU y devuelve los slabs vacíos al asignador de
+// páginas
+void slab_cache_shrink(slab_cache_t *cache);
+
+// Alineados a su clase (potencia de 2) hasta 2048 bytes; lo mayor, a página
+void *kmalloc(uint32_t size);
+void *kzalloc(uint32_t size);
+void kfree(void *ptr);
+
+void slab_print_stats(void);
+
+#ifdef SLAB_BENCH
+// kmalloc/kfree frente a un asignador first-fit con la misma carga, y una
+// caché con y sin almacén
+void slab_bench(void);
+#endif
+
+#endif
@@ -1,3 +1,8 @@
+// Compilación en el host (tools/): se usa la biblioteca del sistema
+#ifdef HOST_BUILD
+#include_next <stdarg.h>
+#else
+
 #ifndef _STDARG_H
 #define _STDARG_H
 
@@ -9,3 +14,5 @@ typedef __builtin_va_list va_list;
 #define va_copy(dest, src) __builtin_va_copy(dest, src)
 
 #endif /* _STDARG_H */
+
+#endif // HOST_BUILD
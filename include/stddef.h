@@ -1,3 +1,8 @@
+// Compilación en el host (tools/): se usa la biblioteca del sistema
+#ifdef HOST_BUILD
+#include_next <stddef.h>
+#else
+
 #ifndef _STDDEF_H
 #define _STDDEF_H
 
@@ -16,3 +21,5 @@ typedef int ptrdiff_t;
 #define offsetof(type, member) ((size_t)&(((type *)0)->member))
 
 #endif /* _STDDEF_H */
+
+#endif // HOST_BUILD
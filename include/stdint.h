@@ -1,3 +1,8 @@
+// Compilación en el host (tools/): se usa la biblioteca del sistema
+#ifdef HOST_BUILD
+#include_next <stdint.h>
+#else
+
 #ifndef _STDINT_H
 #define _STDINT_H
 
@@ -12,3 +17,5 @@ typedef int int32_t;
 typedef long long int64_t;
 
 #endif
+
+#endif // HOST_BUILD
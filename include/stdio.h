@@ -1,3 +1,9 @@
+// Compilación en el host (tools/): se usa la biblioteca del sistema
+#ifdef HOST_BUILD
+#include_next <stdio.h>
+#include "sys/types.h"
+#else
+
 #ifndef _STDIO_H
 #define _STDIO_H
 
@@ -47,4 +53,6 @@ void *memcpy(void *dest, const void *src, size_t num);
 void *memmove(void *dest, const void *src, size_t num);
 int memcmp(const void *ptr1, const void *ptr2, size_t num);
 
-#endif // _STDIO_H
\ No newline at end of file
+#endif // _STDIO_H
+
+#endif // HOST_BUILD
@@ -1,3 +1,8 @@
+// Compilación en el host (tools/): se usa la biblioteca del sistema
+#ifdef HOST_BUILD
+#include_next <string.h>
+#else
+
 #ifndef _STRING_H
 #define _STRING_H
 
@@ -42,3 +47,5 @@ int memcmp(const void *s1, const void *s2, size_t n);
 void *memmove(void *dest, const void *src, size_t n);
 
 #endif
+
+#endif // HOST_BUILD
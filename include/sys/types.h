@@ -1,3 +1,18 @@
+// Compilación en el host (tools/): tipos del sistema y las macros propias
+#ifdef HOST_BUILD
+#include_next <sys/types.h>
+#ifndef _TYPES_H
+#define _TYPES_H
+
+#define TRUE 1
+#define FALSE 0
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+#endif
+#else
+
 #ifndef _TYPES_H
 #define _TYPES_H
 
@@ -17,4 +32,6 @@ typedef unsigned int time_t;
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
 
-#endif
\ No newline at end of file
+#endif
+
+#endif // HOST_BUILD
@@ -4,4 +4,17 @@
 #include <stdint.h>
 void pit_init(uint32_t hz); // típicamente 100 o 1000 Hz
 uint64_t timer_ticks(void);
+
+// TSC calibrado con el PIT, para medir intervalos cortos
+uint32_t timer_tsc_khz(void);
+uint64_t timer_tsc_to_us(uint64_t cycles);
+// Microsegundos desde el arranque (del TSC), para medir latencias
+uint64_t timer_now_us(void);
+
+#ifdef IRQ_BENCH
+// Una sola interrupción del canal 0 tras count pulsos (1,19 MHz);
+// pit_restart vuelve a la frecuencia de pit_init
+void pit_oneshot(uint16_t count);
+void pit_restart(void);
+#endif
 #endif
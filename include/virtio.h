@@ -0,0 +1,134 @@
+#ifndef _VIRTIO_H
+#define _VIRTIO_H
+
+#include "stdint.h"
+
+// --- Virtio sobre PCI (transporte legacy) ---
+// Registros en el espacio de E/S de BAR0. Los dispositivos transicionales
+// (device ID 0x1000-0x103F) lo exponen; QEMU lo hace por defecto.
+#define VIRTIO_PCI_VENDOR 0x1AF4
+
+#define VIRTIO_PCI_HOST_FEATURES 0x00  // 32 bits: lo que ofrece el dispositivo
+#define VIRTIO_PCI_GUEST_FEATURES 0x04 // 32 bits: lo que acepta el driver
+#define VIRTIO_PCI_QUEUE_PFN 0x08      // 32 bits: página (4 KB) de la cola
+#define VIRTIO_PCI_QUEUE_NUM 0x0C      // 16 bits: entradas de la cola (fijo)
+#define VIRTIO_PCI_QUEUE_SEL 0x0E      // 16 bits
+#define VIRTIO_PCI_QUEUE_NOTIFY 0x10   // 16 bits: índice de la cola con trabajo
+#define VIRTIO_PCI_STATUS 0x12         // 8 bits
+#define VIRTIO_PCI_ISR 0x13            // 8 bits, se borra al leerlo
+#define VIRTIO_PCI_CONFIG 0x14         // Configuración del dispositivo (sin MSI-X)
+
+// Con MSI-X activo en la función se insertan dos registros y la
+// configuración del dispositivo se desplaza
+#define VIRTIO_MSI_CONFIG_VECTOR 0x14  // 16 bits: entrada para cambios de configuración
+#define VIRTIO_MSI_QUEUE_VECTOR 0x16   // 16 bits: entrada de la cola seleccionada
+#define VIRTIO_PCI_CONFIG_MSIX 0x18
+#define VIRTIO_MSI_NO_VECTOR 0xFFFF
+
+#define VIRTIO_STATUS_ACKNOWLEDGE 0x01
+#define VIRTIO_STATUS_DRIVER 0x02
+#define VIRTIO_STATUS_DRIVER_OK 0x04
+#define VIRTIO_STATUS_FAILED 0x80
+
+#define VIRTIO_ISR_QUEUE 0x01 // Hay entradas nuevas en alguna cola usada
+
+// Características comunes a todos los dispositivos
+#define VIRTIO_RING_F_INDIRECT_DESC (1u << 28) // Descriptores indirectos
+#define VIRTIO_RING_F_EVENT_IDX (1u << 29)     // used_event/avail_event
+
+// --- Cola dividida (split virtqueue) ---
+#define VRING_DESC_F_NEXT 1     // La cadena sigue en next
+#define VRING_DESC_F_WRITE 2    // El dispositivo escribe en el buffer
+#define VRING_DESC_F_INDIRECT 4 // El buffer es una tabla de descriptores
+
+#define VRING_AVAIL_F_NO_INTERRUPT 1
+#define VRING_USED_F_NO_NOTIFY 1
+
+#define VIRTQ_MAX_SIZE 256 // Entradas que admite el driver
+#define VIRTQ_ALIGN 4096   // Alineación del anillo usado en el transporte legacy
+
+typedef struct
+{
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+} __attribute__((packed)) vring_desc_t;
+
+// Tras ring[num] va used_event (con VIRTIO_RING_F_EVENT_IDX)
+typedef struct
+{
+    uint16_t flags;
+    uint16_t idx;
+    uint16_t ring[];
+} vring_avail_t;
+
+typedef struct
+{
+    uint32_t id;  // Cabeza de la cadena terminada
+    uint32_t len; // Bytes escritos por el dispositivo
+} __attribute__((packed)) vring_used_elem_t;
+
+// Tras ring[num] va avail_event (con VIRTIO_RING_F_EVENT_IDX)
+typedef struct
+{
+    uint16_t flags;
+    uint16_t idx;
+    vring_used_elem_t ring[];
+} vring_used_t;
+
+// Memoria de una cola de num entradas: descriptores y anillo disponible,
+// y el anillo usado en la siguiente página
+#define VIRTQ_ROUND(x) (((x) + VIRTQ_ALIGN - 1) & ~(VIRTQ_ALIGN - 1))
+#define VIRTQ_MEM_SIZE(num) \
+    (VIRTQ_ROUND(16 * (num) + 2 * (3 + (num))) + VIRTQ_ROUND(2 * 3 + 8 * (num)))
+
+// Estado de una cola del lado del driver
+typedef struct
+{
+    uint16_t iobase;        // BAR0 del dispositivo
+    uint16_t index;         // Número de cola
+    uint16_t num;           // Entradas
+    uint8_t event_idx;      // Se negoció VIRTIO_RING_F_EVENT_IDX
+    vring_desc_t *desc;
+    vring_avail_t *avail;
+    vring_used_t *used;
+    uint16_t free_head;     // Lista de descriptores libres (por next)
+    uint16_t nfree;
+    uint16_t last_used;     // Siguiente entrada del anillo usado a recoger
+    uint16_t kicked;        // avail->idx en el último aviso
+    void *token[VIRTQ_MAX_SIZE]; // Dato del driver por cabeza de cadena
+    uint32_t notifies;      // Avisos al dispositivo
+    uint32_t suppressed;    // Avisos que el dispositivo dijo no necesitar
+} virtqueue_t;
+
+// Buffer de una cadena
+typedef struct
+{
+    const void *buf;
+    uint32_t len;
+    uint16_t flags; // VRING_DESC_F_WRITE y/o VRING_DESC_F_INDIRECT
+} virtq_buf_t;
+
+// Prepara la cola index en mem (VIRTQ_MEM_SIZE(num) bytes alineados a 4 KB)
+// y le da su dirección al dispositivo. -1 si la cola no existe o es mayor
+// que max.
+int virtq_init(virtqueue_t *vq, uint16_t iobase, uint16_t index, void *mem, uint16_t max,
+               int event_idx);
+
+// Publica una cadena con los n buffers; token se devuelve al recogerla.
+// -1 si no quedan descriptores libres (no se publica nada).
+int virtq_add(virtqueue_t *vq, const virtq_buf_t *bufs, uint32_t n, void *token);
+
+// Avisa al dispositivo de lo publicado desde el último aviso, salvo que
+// haya dicho que no hace falta (flag NO_NOTIFY o avail_event)
+void virtq_kick(virtqueue_t *vq);
+
+// Recoge una cadena terminada: devuelve su token (NULL si no hay ninguna)
+// y libera sus descriptores
+void *virtq_get(virtqueue_t *vq, uint32_t *len);
+
+// Hay cadenas terminadas sin recoger
+int virtq_pending(const virtqueue_t *vq);
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef _VIRTIO_BLK_H
+#define _VIRTIO_BLK_H
+
+#include "stdint.h"
+#include "virtio.h"
+
+// --- Disco virtio-blk (QEMU -drive if=virtio) ---
+#define VIRTIO_BLK_PCI_DEVICE 0x1001 // ID transicional: transporte legacy
+
+// Parámetros del driver
+#define VIRTIO_BLK_SLOTS 32           // Peticiones en vuelo a la vez
+#define VIRTIO_BLK_MAX_SECTORS 2048   // Sectores por petición (1 MB)
+
+// Características del dispositivo que usa el driver
+#define VIRTIO_BLK_F_SIZE_MAX (1u << 1) // Bytes máximos por fragmento
+#define VIRTIO_BLK_F_SEG_MAX (1u << 2)  // Fragmentos máximos por petición
+#define VIRTIO_BLK_F_RO (1u << 5)       // Solo lectura
+#define VIRTIO_BLK_F_BLK_SIZE (1u << 6) // Tamaño de bloque preferido
+
+// Configuración del dispositivo (desde VIRTIO_PCI_CONFIG)
+#define VIRTIO_BLK_CFG_CAPACITY 0x00 // 64 bits, en sectores de 512 bytes
+#define VIRTIO_BLK_CFG_SIZE_MAX 0x08
+#define VIRTIO_BLK_CFG_SEG_MAX 0x0C
+#define VIRTIO_BLK_CFG_BLK_SIZE 0x14
+
+// Cabecera de una petición (la lee el dispositivo)
+#define VIRTIO_BLK_T_IN 0
+#define VIRTIO_BLK_T_OUT 1
+
+typedef struct
+{
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t sector;
+} __attribute__((packed)) virtio_blk_outhdr_t;
+
+// Último byte de una petición (lo escribe el dispositivo)
+#define VIRTIO_BLK_S_OK 0
+#define VIRTIO_BLK_S_IOERR 1
+#define VIRTIO_BLK_S_UNSUPP 2
+
+// Contadores del driver
+typedef struct
+{
+    uint32_t requests;   // Peticiones publicadas en la cola
+    uint32_t sectors;    // Sectores transferidos
+    uint32_t errors;     // Peticiones terminadas con error
+    uint32_t indirect;   // Publicadas con una tabla indirecta (un descriptor)
+    uint32_t interrupts; // Interrupciones de la cola atendidas
+    uint32_t notifies;   // Avisos al dispositivo (escrituras en QUEUE_NOTIFY)
+    uint32_t suppressed; // Avisos ahorrados por el índice de eventos
+} virtio_blk_stats_t;
+
+typedef struct
+{
+    uint16_t iobase;       // BAR0 (espacio de E/S)
+    uint8_t irq;           // Línea del PIC (0xFF: sin interrupción, se sondea)
+    uint8_t irq_on;
+    uint8_t msix;          // La cola avisa por su propio vector (entrada MSI-X 0)
+    uint8_t vector;
+    uint16_t config;       // Inicio de la configuración del dispositivo en BAR0
+    uint32_t features;     // Negociadas
+    uint64_t sectors;      // Capacidad
+    uint32_t max_iov;      // Fragmentos por petición (seg_max)
+    uint32_t max_sectors;  // Sectores por petición (size_max)
+    uint32_t inflight;
+    virtqueue_t vq;        // Cola 0: peticiones
+    virtio_blk_stats_t stats;
+} virtio_blk_device_t;
+
+// Busca el dispositivo, negocia características, prepara la cola y lo
+// registra en la capa de bloques como "vda". -1 si no hay disco virtio.
+int virtio_blk_init(void);
+
+void virtio_blk_get_stats(virtio_blk_stats_t *out);
+void virtio_blk_print_stats(void);
+
+#endif
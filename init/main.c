@@ -1,7 +1,16 @@
 #include "fs.h"
+#include "ahci.h"
+#include "blkdev.h"
+#include "pci.h"
+#include "virtio_blk.h"
+#include "nvme.h"
 #include <stdio.h>
 #include "log.h"
 #include "idt.h"
+#include "lapic.h"
+#include "page.h"
+#include "paging.h"
+#include "slab.h"
 #include "timer.h"
 #include "keyboard.h"
 #include "vga_color.h"
@@ -49,6 +58,26 @@ extern "C"
         idt_init();
         outb(0xE9, 'd'); // Indicar fin de idt_init
 
+        // Marcos de página libres según el mapa E820 que dejó el arranque
+        outb(0xE9, 'M'); // Indicar inicio de page_init
+        page_init();
+        outb(0xE9, 'm'); // Indicar fin de page_init
+
+        // Mapa de identidad; a partir de aquí los registros MMIO se mapean
+        // antes de tocarlos
+        outb(0xE9, 'G'); // Indicar inicio de paging_init
+        paging_init();
+        outb(0xE9, 'g'); // Indicar fin de paging_init
+
+        // APIC local para los vectores MSI/MSI-X; el PIC sigue por LINT0
+        outb(0xE9, 'L'); // Indicar inicio de lapic_init
+        lapic_init();
+        outb(0xE9, 'l'); // Indicar fin de lapic_init
+
+        outb(0xE9, 'H'); // Indicar inicio de slab_init
+        slab_init();     // Cachés de kmalloc
+        outb(0xE9, 'h'); // Indicar fin de slab_init
+
         outb(0xE9, 'T'); // Indicar inicio de pit_init
         pit_init(100);   // 100Hz
         outb(0xE9, 't'); // Indicar fin de pit_init
@@ -57,15 +86,62 @@ extern "C"
         keyboard_init();
         outb(0xE9, 'k'); // Indicar fin de keyboard_init
 
-        outb(0xE9, 'F'); // Indicar inicio de fs_init
-        fs_init();
-        outb(0xE9, 'f'); // Indicar fin de fs_init
-
+        // Interrupciones antes que los discos: el tick del PIT y los avisos
+        // de fin de E/S dejan dormir a quien espera al dispositivo
         outb(0xE9, 'S'); // Indicar habilitación de interrupciones
         __asm__ volatile("sti");
         outb(0xE9, 's'); // Indicar interrupciones habilitadas
 
         printf("_start: interrupts enabled\n");
+#ifdef IRQ_BENCH
+        irq_bench();
+#endif
+
+        // El primero que se registra en la capa de bloques es el del sistema
+        // de archivos: virtio-blk si lo hay, si no NVMe, después el disco SATA
+        // y, sin ninguno, el disco en RAM
+        // Una sola enumeración del bus; cada driver se une al registrarse
+        outb(0xE9, 'C'); // Indicar inicio de pci_init
+        pci_init();
+        outb(0xE9, 'c'); // Indicar fin de pci_init
+
+        outb(0xE9, 'V'); // Indicar inicio de virtio_blk_init
+        int virtio = virtio_blk_init();
+        outb(0xE9, 'v'); // Indicar fin de virtio_blk_init
+
+        outb(0xE9, 'N'); // Indicar inicio de nvme_init
+        int nvme = nvme_init();
+        outb(0xE9, 'n'); // Indicar fin de nvme_init
+
+        outb(0xE9, 'A'); // Indicar inicio de ahci_init
+        int sata = ahci_init(NULL);
+        if (virtio != 0 && nvme != 0 && sata != 0)
+            ramdisk_init();
+        outb(0xE9, 'a'); // Indicar fin de ahci_init
+#ifdef AHCI_BENCH
+        ahci_bench();
+#endif
+#ifdef PAGING_BENCH
+        paging_bench();
+        paging_print_stats();
+#endif
+#ifdef PAGE_BENCH
+        page_bench();
+        page_print_stats();
+#endif
+#ifdef SLAB_BENCH
+        slab_bench();
+        slab_print_stats();
+#endif
+#ifdef BLK_BENCH
+        blkdev_bench();
+        virtio_blk_print_stats();
+        nvme_print_stats();
+#endif
+
+        outb(0xE9, 'F'); // Indicar inicio de fs_init
+        fs_init();
+        outb(0xE9, 'f'); // Indicar fin de fs_init
 
         kernel_main(); // Llama directamente al kernel principal
     }
@@ -0,0 +1,114 @@
+// kernel/acpi.c
+#include "acpi.h"
+#include "paging.h"
+#include "stdio.h"
+#include "string.h"
+
+#define ACPI_EBDA_SEG_PTR 0x40E // Segmento de la EBDA, en la BDA
+#define ACPI_BIOS_START 0xE0000
+#define ACPI_BIOS_END 0x100000
+
+static const acpi_sdt_header_t *acpi_root; // RSDT o XSDT
+static uint32_t acpi_entry_size;           // 4 (RSDT) u 8 (XSDT)
+static uint8_t acpi_probed;
+
+static uint8_t acpi_sum(const void *p, uint32_t len)
+{
+    const uint8_t *b = (const uint8_t *)p;
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < len; i++)
+        sum += b[i];
+    return sum;
+}
+
+static const acpi_rsdp_t *acpi_scan_rsdp(uint32_t start, uint32_t end)
+{
+    for (uint32_t p = start; p + 20 <= end; p += 16)
+    {
+        const acpi_rsdp_t *rsdp = (const acpi_rsdp_t *)p;
+        if (memcmp(rsdp->signature, "RSD PTR ", 8) == 0 && acpi_sum(rsdp, 20) == 0)
+            return rsdp;
+    }
+    return NULL;
+}
+
+// Sin PAE solo se llega a lo que está por debajo de 4 GB. El firmware puede
+// dejar las tablas en memoria reservada, fuera del mapa de la RAM: primero
+// se mapea la cabecera y, con su longitud, la tabla entera. La firma se mira
+// antes que la suma, que recorre la tabla entera (NULL: cualquiera).
+static const acpi_sdt_header_t *acpi_table_at(uint64_t phys, const char *signature)
+{
+    if (phys == 0)
+        return NULL;
+    const acpi_sdt_header_t *h =
+        (const acpi_sdt_header_t *)paging_map(phys, sizeof(acpi_sdt_header_t), PTE_WRITE);
+    if (!h || (signature && memcmp(h->signature, signature, 4) != 0))
+        return NULL;
+    if (h->length < sizeof(*h) || !paging_map(phys, h->length, PTE_WRITE) || acpi_sum(h, h->length) != 0)
+        return NULL;
+    return h;
+}
+
+int acpi_init(void)
+{
+    if (acpi_probed)
+        return acpi_root ? 0 : -1;
+    acpi_probed = 1;
+
+    // La dirección pasa por un registro: GCC trata las constantes tan bajas
+    // como punteros nulos desplazados y avisa del acceso
+    uint32_t bda = ACPI_EBDA_SEG_PTR;
+    __asm__("" : "+r"(bda));
+    uint32_t ebda = (uint32_t)*(volatile uint16_t *)bda << 4;
+    const acpi_rsdp_t *rsdp = NULL;
+    if (ebda >= 0x80000 && ebda < 0xA0000)
+        rsdp = acpi_scan_rsdp(ebda, ebda + 1024);
+    if (!rsdp)
+        rsdp = acpi_scan_rsdp(ACPI_BIOS_START, ACPI_BIOS_END);
+    if (!rsdp)
+    {
+        printf("ACPI: RSDP no encontrado\n");
+        return -1;
+    }
+
+    // La XSDT manda si existe; la RSDT queda para ACPI 1.0
+    if (rsdp->revision >= 2 && rsdp->length >= sizeof(*rsdp) &&
+        acpi_sum(rsdp, sizeof(*rsdp)) == 0)
+    {
+        acpi_root = acpi_table_at(rsdp->xsdt_address, "XSDT");
+        acpi_entry_size = 8;
+    }
+    if (!acpi_root)
+    {
+        acpi_root = acpi_table_at(rsdp->rsdt_address, "RSDT");
+        acpi_entry_size = 4;
+    }
+    if (!acpi_root)
+    {
+        printf("ACPI: RSDT/XSDT no válida\n");
+        return -1;
+    }
+    return 0;
+}
+
+const acpi_sdt_header_t *acpi_find_table(const char *signature)
+{
+    if (acpi_init() != 0)
+        return NULL;
+
+    uint32_t n = (acpi_root->length - sizeof(*acpi_root)) / acpi_entry_size;
+    const uint8_t *entries = (const uint8_t *)(acpi_root + 1);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint64_t phys;
+        if (acpi_entry_size == 8)
+            memcpy(&phys, entries + i * 8, 8); // Entradas de la XSDT sin alinear
+        else
+            phys = *(const uint32_t *)(entries + i * 4);
+
+        const acpi_sdt_header_t *h = acpi_table_at(phys, signature);
+        if (h)
+            return h;
+    }
+    return NULL;
+}
@@ -1,7 +1,14 @@
 #include "ahci.h"
+#include "blkdev.h"
 #include "pci.h"
+#include "cpu.h"
+#include "idt.h"
+#include "timer.h"
+#include "paging.h"
 #include "stdio.h"
 #include "stdint.h"
+#include "string.h"
+#include "sys/types.h"
 
 // Para simplificar, solo un dispositivo
 static ahci_device_t ahci_dev_instance;
@@ -10,51 +17,863 @@ static ahci_device_t ahci_dev_instance;
 // so code knows AHCI is not initialized yet.
 ahci_device_t *ahci_dev = NULL;
 
-// Inicializa AHCI detectando puerto SATA
-int ahci_init(ahci_device_t *dev)
+// Memoria que lee y escribe el HBA por DMA. Con el mapa de identidad la
+// dirección de un objeto del kernel es su dirección física.
+static ahci_cmd_header_t ahci_cmd_list[AHCI_MAX_SLOTS] __attribute__((aligned(1024)));
+static uint8_t ahci_fis_area[256] __attribute__((aligned(256)));
+static ahci_cmd_table_t ahci_cmd_tables[AHCI_MAX_SLOTS] __attribute__((aligned(128)));
+
+// Buffer intermedio para buffers en direcciones impares (la PRDT exige
+// direcciones pares) y para IDENTIFY
+static uint8_t ahci_bounce[AHCI_BOUNCE_SIZE] __attribute__((aligned(16)));
+
+// Aviso pendiente de cada ranura emitida con ahci_submit_async
+static ahci_done_fn ahci_slot_done[AHCI_MAX_SLOTS];
+static void *ahci_slot_ctx[AHCI_MAX_SLOTS];
+
+static inline uint32_t ahci_phys(const void *p)
 {
-    pci_device_t pci_dev;
-    if (pci_find_ahci(&pci_dev) != 0)
+    return (uint32_t)p;
+}
+
+static uint32_t ahci_popcount(uint32_t x)
+{
+    uint32_t n = 0;
+    for (; x; x &= x - 1)
+        n++;
+    return n;
+}
+
+// --- Control del puerto ---
+static int ahci_port_stop(hba_port_t *p)
+{
+    p->cmd &= ~AHCI_PxCMD_ST;
+    p->cmd &= ~AHCI_PxCMD_FRE;
+    for (uint32_t i = 0; i < AHCI_SPIN_TIMEOUT; i++)
     {
-        printf("AHCI no encontrado\n");
+        if (!(p->cmd & (AHCI_PxCMD_CR | AHCI_PxCMD_FR)))
+            return 0;
+        cpu_relax();
+    }
+    return -1;
+}
+
+static int ahci_port_start(hba_port_t *p)
+{
+    for (uint32_t i = 0; i < AHCI_SPIN_TIMEOUT; i++)
+    {
+        if (!(p->cmd & AHCI_PxCMD_CR))
+        {
+            p->cmd |= AHCI_PxCMD_FRE;
+            p->cmd |= AHCI_PxCMD_ST;
+            return 0;
+        }
+        cpu_relax();
+    }
+    return -1;
+}
+
+// Espera a que el dispositivo acepte comandos (ni BSY ni DRQ)
+static int ahci_port_idle(hba_port_t *p)
+{
+    for (uint32_t i = 0; i < AHCI_SPIN_TIMEOUT; i++)
+    {
+        if (!(p->tfd & (AHCI_PxTFD_BSY | AHCI_PxTFD_DRQ)))
+            return 0;
+        cpu_relax();
+    }
+    return -1;
+}
+
+static int ahci_port_has_disk(hba_port_t *p)
+{
+    uint32_t ssts = p->ssts;
+    return (ssts & 0x0F) == AHCI_SSTS_DET_PRESENT &&
+           ((ssts >> 8) & 0x0F) == AHCI_SSTS_IPM_ACTIVE &&
+           p->sig == AHCI_SIG_ATA;
+}
+
+// Tras un error: parar el puerto (el HBA olvida los comandos emitidos),
+// limpiar los errores y, si el dispositivo sigue ocupado, hacer COMRESET
+static void ahci_port_recover(ahci_device_t *dev)
+{
+    hba_port_t *p = dev->regs;
+
+    ahci_port_stop(p);
+    p->serr = 0xFFFFFFFF;
+    p->is = 0xFFFFFFFF;
+
+    if (p->tfd & (AHCI_PxTFD_BSY | AHCI_PxTFD_DRQ))
+    {
+        p->sctl = (p->sctl & ~0x0Fu) | 1;
+        for (volatile uint32_t i = 0; i < 100000; i++)
+            ;
+        p->sctl &= ~0x0Fu;
+        for (uint32_t i = 0; i < AHCI_SPIN_TIMEOUT && (p->ssts & 0x0F) != AHCI_SSTS_DET_PRESENT; i++)
+            cpu_relax();
+        p->serr = 0xFFFFFFFF;
+    }
+
+    ahci_port_start(p);
+}
+
+static int ahci_port_setup(ahci_device_t *dev)
+{
+    hba_port_t *p = dev->regs;
+    if (ahci_port_stop(p) != 0)
         return -1;
+
+    memset(ahci_cmd_list, 0, sizeof(ahci_cmd_list));
+    memset(ahci_fis_area, 0, sizeof(ahci_fis_area));
+    memset(ahci_cmd_tables, 0, sizeof(ahci_cmd_tables));
+    for (uint32_t i = 0; i < AHCI_MAX_SLOTS; i++)
+    {
+        ahci_cmd_list[i].ctba = ahci_phys(&ahci_cmd_tables[i]);
+        ahci_cmd_list[i].ctbau = 0;
     }
 
-    dev->bar5 = pci_get_bar(pci_dev.bus, pci_dev.slot, pci_dev.func, 5);
-    dev->port = 0; // asumimos primer puerto AHCI
-    ahci_dev_instance = *dev;
-    /* mark global pointer as initialized */
-    ahci_dev = &ahci_dev_instance;
+    p->clb = ahci_phys(ahci_cmd_list);
+    p->clbu = 0;
+    p->fb = ahci_phys(ahci_fis_area);
+    p->fbu = 0;
+
+    p->serr = 0xFFFFFFFF;
+    p->is = 0xFFFFFFFF;
+    p->ie = 0; // Hasta tener la línea IRQ se sondea CI
+    p->cmd |= AHCI_PxCMD_SUD | AHCI_PxCMD_POD;
+
+    dev->busy = 0;
+    dev->done = dev->failed = 0;
+    return ahci_port_start(p);
+}
+
+// --- Emisión de comandos ---
+static int ahci_free_slot(ahci_device_t *dev)
+{
+    uint32_t used = dev->busy | dev->regs->ci | dev->regs->sact;
+    uint32_t limit = dev->queue_depth ? dev->queue_depth : dev->nslots;
+    for (uint32_t i = 0; i < limit; i++)
+    {
+        if (!(used & (1u << i)))
+            return (int)i;
+    }
+    return -1;
+}
+
+// Rellena la PRDT; cada fragmento se parte en descriptores de hasta 4 MB
+static int ahci_fill_prdt(ahci_cmd_table_t *table, const ahci_iovec_t *iov, uint32_t iovcnt,
+                          uint32_t *bytes)
+{
+    uint32_t n = 0;
+    *bytes = 0;
+
+    for (uint32_t i = 0; i < iovcnt; i++)
+    {
+        uint32_t addr = ahci_phys(iov[i].buf);
+        uint32_t len = iov[i].bytes;
+        if (len == 0 || (len & 1) || (addr & 1))
+            return -1;
+
+        while (len)
+        {
+            if (n == AHCI_PRDT_ENTRIES)
+                return -1;
+            uint32_t chunk = MIN(len, AHCI_PRD_MAX_BYTES);
+            table->prdt[n].dba = addr;
+            table->prdt[n].dbau = 0;
+            table->prdt[n].rsv = 0;
+            table->prdt[n].dbc = chunk - 1;
+            addr += chunk;
+            len -= chunk;
+            *bytes += chunk;
+            n++;
+        }
+    }
+    return (int)n;
+}
+
+// Rellena un FIS de comando ATA con dirección LBA de 48 bits
+static void ahci_build_fis(ahci_fis_h2d_t *fis, uint8_t command, uint64_t lba)
+{
+    memset(fis, 0, sizeof(*fis));
+    fis->type = FIS_TYPE_REG_H2D;
+    fis->flags = 0x80;
+    fis->command = command;
+    fis->lba0 = (uint8_t)lba;
+    fis->lba1 = (uint8_t)(lba >> 8);
+    fis->lba2 = (uint8_t)(lba >> 16);
+    fis->device = 1 << 6; // Modo LBA
+    fis->lba3 = (uint8_t)(lba >> 24);
+    fis->lba4 = (uint8_t)(lba >> 32);
+    fis->lba5 = (uint8_t)(lba >> 40);
+}
+
+// Copia el FIS a la tabla de una ranura libre y emite el comando. Con
+// queued es un comando NCQ: la etiqueta es la ranura y va también a SActive.
+static int ahci_issue(ahci_device_t *dev, const ahci_fis_h2d_t *fis, int write, int queued,
+                      uint32_t bytes, const ahci_iovec_t *iov, uint32_t iovcnt)
+{
+    int slot = ahci_free_slot(dev);
+    if (slot < 0)
+        return -1;
+
+    ahci_cmd_table_t *table = &ahci_cmd_tables[slot];
+    memset(table, 0, sizeof(ahci_cmd_table_t));
+
+    uint32_t total;
+    int prdtl = ahci_fill_prdt(table, iov, iovcnt, &total);
+    if (prdtl < 0 || total != bytes)
+        return -1;
+
+    ahci_fis_h2d_t *cfis = (ahci_fis_h2d_t *)table->cfis;
+    *cfis = *fis;
+    if (queued)
+        cfis->count_lo = (uint8_t)(slot << 3);
+
+    ahci_cmd_header_t *hdr = &ahci_cmd_list[slot];
+    hdr->flags = (sizeof(ahci_fis_h2d_t) / 4) | (write ? AHCI_CMD_WRITE : 0);
+    hdr->prdtl = (uint16_t)prdtl;
+    hdr->prdbc = 0;
+
+    // La tabla tiene que estar en memoria antes de que el HBA vea el bit
+    barrier();
+    dev->busy |= 1u << slot;
+    if (queued)
+        dev->regs->sact = 1u << slot;
+    dev->regs->ci = 1u << slot;
+
+    dev->stats.commands++;
+    uint32_t inflight = ahci_popcount(dev->busy);
+    if (inflight > dev->stats.max_inflight)
+        dev->stats.max_inflight = inflight;
+    return slot;
+}
+
+// La interrupción también toca busy y las ranuras: se llama con ellas
+// deshabilitadas
+static int ahci_submit_locked(ahci_device_t *dev, int write, uint64_t lba, uint32_t count,
+                              const ahci_iovec_t *iov, uint32_t iovcnt)
+{
+    if (!dev || !dev->regs || count == 0 || count > AHCI_MAX_CMD_SECTORS || !iov)
+        return -1;
+    if (lba + count > dev->sectors)
+        return -1;
+
+    // READ/WRITE FPDMA QUEUED llevan la cuenta en el campo feature y la
+    // etiqueta en count; los comandos DMA EXT, la cuenta en count
+    ahci_fis_h2d_t fis;
+    if (dev->ncq)
+    {
+        ahci_build_fis(&fis, write ? ATA_CMD_WRITE_FPDMA_QUEUED : ATA_CMD_READ_FPDMA_QUEUED, lba);
+        fis.feature_lo = (uint8_t)count;
+        fis.feature_hi = (uint8_t)(count >> 8);
+    }
+    else
+    {
+        ahci_build_fis(&fis, write ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_READ_DMA_EXT, lba);
+        fis.count_lo = (uint8_t)count;
+        fis.count_hi = (uint8_t)(count >> 8);
+    }
+
+    int slot = ahci_issue(dev, &fis, write, dev->ncq, count * AHCI_BLOCK_SIZE, iov, iovcnt);
+    if (slot >= 0)
+        dev->stats.sectors += count;
+    return slot;
+}
+
+int ahci_submit(ahci_device_t *dev, int write, uint64_t lba, uint32_t count,
+                const ahci_iovec_t *iov, uint32_t iovcnt)
+{
+    uint32_t flags = irq_save();
+    int slot = ahci_submit_locked(dev, write, lba, count, iov, iovcnt);
+    irq_restore(flags);
+    return slot;
+}
+
+int ahci_submit_async(ahci_device_t *dev, int write, uint64_t lba, uint32_t count,
+                      const ahci_iovec_t *iov, uint32_t iovcnt, ahci_done_fn done, void *ctx)
+{
+    if (!done)
+        return -1;
+
+    // El aviso tiene que estar puesto antes de que la interrupción pueda
+    // retirar la ranura
+    uint32_t flags = irq_save();
+    int slot = ahci_submit_locked(dev, write, lba, count, iov, iovcnt);
+    if (slot >= 0)
+    {
+        ahci_slot_done[slot] = done;
+        ahci_slot_ctx[slot] = ctx;
+    }
+    irq_restore(flags);
+    return slot < 0 ? -1 : 0;
+}
+
+// --- Finalización ---
+// Retira las ranuras que el HBA completó: las asíncronas se avisan por
+// callback y el resto queda en done/failed hasta que alguien las recoja.
+// Se llama desde la interrupción o con las interrupciones deshabilitadas.
+static void ahci_retire(ahci_device_t *dev)
+{
+    hba_port_t *p = dev->regs;
+    uint32_t err = 0;
+
+    uint32_t is = p->is;
+    if (is & AHCI_PxIS_TFES)
+    {
+        // Sin NCQ falla el comando en curso y los que esperaban detrás se
+        // pierden al parar el puerto; con NCQ el dispositivo aborta todos
+        // los que tenía en cola
+        err = dev->busy & (p->ci | p->sact);
+        ahci_port_recover(dev);
+    }
+    else
+        p->is = is; // Limpiar los bits de estado ya vistos
+    dev->hba->is = 1u << dev->port;
+
+    // Un comando NCQ acaba cuando el dispositivo limpia su bit de SActive
+    // (CI se limpia antes, al aceptarlo); uno normal, cuando se limpia CI
+    uint32_t done = dev->busy & ~(p->ci | p->sact);
+    done |= err;
+    if (!done)
+        return;
+    dev->busy &= ~done;
+    dev->stats.errors += ahci_popcount(err);
+
+    // Sacar primero todos los avisos: uno puede emitir otro comando y
+    // reutilizar una ranura recién liberada
+    ahci_done_fn fns[AHCI_MAX_SLOTS];
+    void *ctxs[AHCI_MAX_SLOTS];
+    uint32_t notify = 0;
+    for (uint32_t slot = 0; slot < AHCI_MAX_SLOTS; slot++)
+    {
+        if (!(done & (1u << slot)) || !ahci_slot_done[slot])
+            continue;
+        fns[slot] = ahci_slot_done[slot];
+        ctxs[slot] = ahci_slot_ctx[slot];
+        ahci_slot_done[slot] = NULL;
+        notify |= 1u << slot;
+    }
+
+    done &= ~notify;
+    dev->done |= done;
+    dev->failed |= err & done;
+
+    for (uint32_t slot = 0; slot < AHCI_MAX_SLOTS; slot++)
+    {
+        if (!(notify & (1u << slot)))
+            continue;
+        dev->stats.callbacks++;
+        fns[slot](ctxs[slot], (err & (1u << slot)) ? -1 : 0);
+    }
+}
+
+// Recoge las ranuras de mask ya retiradas. Con las interrupciones deshabilitadas.
+static uint32_t ahci_collect(ahci_device_t *dev, uint32_t mask, uint32_t *failed)
+{
+    ahci_retire(dev);
+    uint32_t done = dev->done & mask;
+    *failed = dev->failed & done;
+    dev->done &= ~done;
+    dev->failed &= ~done;
+    return done;
+}
+
+// Se puede dormir si la interrupción del puerto está activa y el que
+// espera no la tiene deshabilitada
+static inline int ahci_can_sleep(ahci_device_t *dev, uint32_t flags)
+{
+    return dev->irq_on && (flags & CPU_EFLAGS_IF);
+}
+
+uint32_t ahci_poll(ahci_device_t *dev, uint32_t *failed)
+{
+    uint32_t err;
+    uint32_t flags = irq_save();
+    uint32_t done = ahci_collect(dev, 0xFFFFFFFF, &err);
+    irq_restore(flags);
+
+    if (failed)
+        *failed = err;
+    return done;
+}
+
+void ahci_sleep(ahci_device_t *dev)
+{
+    if (!dev)
+        return;
+
+    uint32_t flags = irq_save();
+    if (ahci_can_sleep(dev, flags) && dev->busy)
+    {
+        __asm__ volatile("sti; hlt" ::: "memory");
+        return;
+    }
+    ahci_retire(dev);
+    irq_restore(flags);
+    cpu_relax();
+}
+
+static void ahci_irq_handler(void)
+{
+    ahci_device_t *dev = ahci_dev;
+
+    // La línea puede ser compartida: mirar si avisó nuestro puerto
+    if (!dev || !dev->irq_on || !(dev->hba->is & (1u << dev->port)))
+        return;
+    dev->stats.interrupts++;
+    ahci_retire(dev);
+}
+
+// Espera a que termine alguna ranura de mask; en *failed las erróneas
+static uint32_t ahci_wait_any(ahci_device_t *dev, uint32_t mask, uint32_t *failed)
+{
+    uint64_t start = timer_ticks();
+    uint32_t spins = 0;
+
+    for (;;)
+    {
+        // Recoger y dormir sin que la interrupción pueda colarse entre medias:
+        // sti solo surte efecto tras la instrucción siguiente (hlt)
+        uint32_t flags = irq_save();
+        uint32_t done = ahci_collect(dev, mask, failed);
+        if (done || !(dev->busy & mask))
+        {
+            irq_restore(flags);
+            return done;
+        }
+
+        if (ahci_can_sleep(dev, flags))
+        {
+            __asm__ volatile("sti; hlt" ::: "memory");
+            if (timer_ticks() - start >= AHCI_TIMEOUT_TICKS)
+                break;
+        }
+        else
+        {
+            irq_restore(flags);
+            if (++spins >= AHCI_SPIN_TIMEOUT)
+                break;
+            cpu_relax();
+        }
+    }
+
+    // El dispositivo no responde: dar por perdidas las ranuras pendientes
+    printf("AHCI: tiempo de espera agotado (CI=0x%x)\n", dev->regs->ci);
+    uint32_t flags = irq_save();
+    ahci_port_recover(dev);
+    uint32_t lost = dev->busy;
+    dev->busy = 0;
+    dev->stats.errors += ahci_popcount(lost);
+    for (uint32_t slot = 0; slot < AHCI_MAX_SLOTS; slot++)
+    {
+        ahci_done_fn fn = ahci_slot_done[slot];
+        if (!fn || !(lost & (1u << slot)))
+            continue;
+        ahci_slot_done[slot] = NULL;
+        lost &= ~(1u << slot);
+        fn(ahci_slot_ctx[slot], -1);
+    }
+    dev->done |= lost;
+    dev->failed |= lost;
+    uint32_t done = ahci_collect(dev, mask, failed);
+    irq_restore(flags);
+    return done;
+}
+
+int ahci_wait(ahci_device_t *dev, int slot)
+{
+    if (!dev || slot < 0 || slot >= AHCI_MAX_SLOTS)
+        return -1;
 
-    printf("AHCI inicializado: BAR5=0x%llx, puerto=%u\n", (unsigned long long)dev->bar5, dev->port);
+    // La interrupción puede haberla retirado ya: entonces está en done
+    uint32_t bit = 1u << slot;
+    uint32_t failed;
+    while ((dev->busy | dev->done) & bit)
+    {
+        if (ahci_wait_any(dev, bit, &failed))
+            return failed ? -1 : 0;
+    }
     return 0;
 }
 
-// --- Mini función dummy para leer un bloque ---
+// --- Transferencias síncronas ---
+// Reparte la transferencia en comandos de AHCI_MAX_CMD_SECTORS y mantiene
+// tantos en vuelo como ranuras libres haya
+static int ahci_rw(ahci_device_t *dev, int write, uint32_t lba, uint32_t count, uint8_t *buf)
+{
+    uint32_t pending = 0;
+    int ret = 0;
+
+    while (count || pending)
+    {
+        while (count)
+        {
+            uint32_t n = MIN(count, AHCI_MAX_CMD_SECTORS);
+            ahci_iovec_t iov = {buf, n * AHCI_BLOCK_SIZE};
+            int slot = ahci_submit(dev, write, lba, n, &iov, 1);
+            if (slot < 0)
+                break;
+            pending |= 1u << slot;
+            lba += n;
+            count -= n;
+            buf += n * AHCI_BLOCK_SIZE;
+        }
+        if (!pending)
+            return -1; // Ni ranura libre ni nada que esperar: petición inválida
+
+        uint32_t failed;
+        pending &= ~ahci_wait_any(dev, pending, &failed);
+        if (failed)
+            ret = -1;
+    }
+    return ret;
+}
+
+// Buffers en dirección impar: pasar por el buffer intermedio
+static int ahci_rw_bounce(ahci_device_t *dev, int write, uint32_t lba, uint32_t count, uint8_t *buf)
+{
+    const uint32_t per_chunk = AHCI_BOUNCE_SIZE / AHCI_BLOCK_SIZE;
+    dev->stats.bounced++;
+
+    while (count)
+    {
+        uint32_t n = MIN(count, per_chunk);
+        if (write)
+            memcpy(ahci_bounce, buf, n * AHCI_BLOCK_SIZE);
+        if (ahci_rw(dev, write, lba, n, ahci_bounce) != 0)
+            return -1;
+        if (!write)
+            memcpy(buf, ahci_bounce, n * AHCI_BLOCK_SIZE);
+        lba += n;
+        count -= n;
+        buf += n * AHCI_BLOCK_SIZE;
+    }
+    return 0;
+}
+
+int ahci_read_blocks(ahci_device_t *dev, uint32_t lba, uint32_t count, void *buffer)
+{
+    if (!dev || !dev->regs || !buffer)
+        return -1;
+    if (ahci_phys(buffer) & 1)
+        return ahci_rw_bounce(dev, 0, lba, count, buffer);
+    return ahci_rw(dev, 0, lba, count, buffer);
+}
+
+int ahci_write_blocks(ahci_device_t *dev, uint32_t lba, uint32_t count, const void *buffer)
+{
+    if (!dev || !dev->regs || !buffer)
+        return -1;
+    // El HBA solo lee el buffer: quitar const es seguro
+    if (ahci_phys(buffer) & 1)
+        return ahci_rw_bounce(dev, 1, lba, count, (uint8_t *)buffer);
+    return ahci_rw(dev, 1, lba, count, (uint8_t *)buffer);
+}
+
 int ahci_read_block(ahci_device_t *dev, uint32_t lba, void *buffer)
 {
-    // Por ahora copiamos del fs_storage como si fuera disco
-    extern uint8_t fs_storage[];
-    if (!buffer)
+    return ahci_read_blocks(dev, lba, 1, buffer);
+}
+
+int ahci_write_block(ahci_device_t *dev, uint32_t lba, const void *buffer)
+{
+    return ahci_write_blocks(dev, lba, 1, buffer);
+}
+
+// --- Dispositivo de bloques ---
+static blkdev_t ahci_blkdev;
+
+static void ahci_blk_done(void *ctx, int status)
+{
+    blkdev_complete((blk_request_t *)ctx, status);
+}
+
+static int ahci_blk_submit(blkdev_t *bdev, blk_request_t *req)
+{
+    ahci_device_t *dev = (ahci_device_t *)bdev->priv;
+    ahci_iovec_t iov[AHCI_PRDT_ENTRIES];
+    for (uint32_t i = 0; i < req->iovcnt; i++)
+    {
+        iov[i].buf = req->iov[i].buf;
+        iov[i].bytes = req->iov[i].bytes;
+    }
+
+    if (ahci_submit_async(dev, req->write, req->lba, req->count, iov, req->iovcnt,
+                          ahci_blk_done, req) == 0)
+        return 0;
+
+    // Con ranuras ocupadas la capa la reintenta cuando acabe otra; sin
+    // ninguna, es que el HBA no puede hacerla
+    if (dev->busy)
         return -1;
+    blkdev_complete(req, -1);
+    return 0;
+}
 
-    uint8_t *src = fs_storage + (lba * AHCI_BLOCK_SIZE);
-    for (int i = 0; i < AHCI_BLOCK_SIZE; i++)
-        ((uint8_t *)buffer)[i] = src[i];
+static void ahci_blk_wait(blkdev_t *bdev)
+{
+    ahci_sleep((ahci_device_t *)bdev->priv);
+}
 
+static const blkdev_ops_t ahci_blk_ops = {ahci_blk_submit, ahci_blk_wait, NULL};
+
+static void ahci_blk_register(ahci_device_t *dev)
+{
+    strncpy(ahci_blkdev.name, "ahci0", BLK_NAME_LEN);
+    ahci_blkdev.sectors = dev->sectors;
+    ahci_blkdev.max_sectors = AHCI_MAX_CMD_SECTORS;
+    ahci_blkdev.max_iov = AHCI_PRDT_ENTRIES;
+    ahci_blkdev.max_inflight = dev->queue_depth;
+    ahci_blkdev.align = 2; // La PRDT exige direcciones y tamaños pares
+    ahci_blkdev.ops = &ahci_blk_ops;
+    ahci_blkdev.priv = dev;
+    blkdev_register(&ahci_blkdev);
+}
+
+void ahci_get_stats(ahci_stats_t *out)
+{
+    if (out)
+        *out = ahci_dev_instance.stats;
+}
+
+// --- Inicialización ---
+static int ahci_identify(ahci_device_t *dev)
+{
+    ahci_fis_h2d_t fis;
+    ahci_iovec_t iov = {ahci_bounce, 512};
+    ahci_build_fis(&fis, ATA_CMD_IDENTIFY, 0);
+    fis.device = 0;
+    int slot = ahci_issue(dev, &fis, 0, 0, 512, &iov, 1);
+    if (slot < 0 || ahci_wait(dev, slot) != 0)
+        return -1;
+
+    const uint16_t *id = (const uint16_t *)ahci_bounce;
+    if (id[83] & (1u << 10))
+        dev->sectors = (uint64_t)id[100] | ((uint64_t)id[101] << 16) |
+                       ((uint64_t)id[102] << 32) | ((uint64_t)id[103] << 48);
+    else
+        dev->sectors = (uint64_t)id[60] | ((uint64_t)id[61] << 16);
+
+    // NCQ solo si lo admiten el HBA y el disco; la profundidad es la menor
+    dev->queue_depth = dev->nslots;
+    dev->ncq = 0;
+    if ((dev->hba->cap & AHCI_CAP_SNCQ) && (id[76] & (1u << 8)))
+    {
+        dev->ncq = 1;
+        dev->queue_depth = MIN(dev->nslots, (uint32_t)(id[75] & 0x1F) + 1);
+    }
     return 0;
 }
 
-// --- Mini función dummy para escribir un bloque ---
-int ahci_write_block(ahci_device_t *dev, uint32_t lba, const void *buffer)
+// Finalización por interrupción en la línea que el BIOS asignó al HBA. Sin
+// línea válida (0xFF) el driver sigue sondeando.
+static void ahci_enable_irq(ahci_device_t *dev)
+{
+    if (dev->irq >= 16 || irq_register(dev->irq, ahci_irq_handler) != 0)
+        return;
+
+    dev->regs->is = 0xFFFFFFFF;
+    dev->hba->is = 0xFFFFFFFF;
+    dev->regs->ie = AHCI_PxIE_DEFAULT;
+    dev->hba->ghc |= AHCI_GHC_IE;
+    dev->irq_on = 1;
+}
+
+// Un solo HBA con un disco: el driver no acepta un segundo controlador
+static int ahci_probe(pci_device_t *pci, const pci_id_t *id)
 {
-    extern uint8_t fs_storage[];
-    if (!buffer)
+    (void)id;
+    ahci_device_t *d = &ahci_dev_instance;
+    if (ahci_dev)
         return -1;
 
-    uint8_t *dst = fs_storage + (lba * AHCI_BLOCK_SIZE);
-    for (int i = 0; i < AHCI_BLOCK_SIZE; i++)
-        dst[i] = ((uint8_t *)buffer)[i];
+    // Decodificar memoria y permitir al HBA hacer DMA (bus master)
+    pci_enable_device(pci, PCI_COMMAND_MEMORY | PCI_COMMAND_MASTER);
 
+    memset(d, 0, sizeof(*d));
+    d->bar5 = pci_get_bar(pci->bus, pci->slot, pci->func, 5);
+    // Registros del HBA sin caché: cada lectura tiene que llegar al dispositivo
+    d->hba = d->bar5 ? (hba_mem_t *)paging_map_mmio(d->bar5, sizeof(hba_mem_t)) : NULL;
+    if (!d->hba)
+    {
+        printf("AHCI: BAR5 no utilizable\n");
+        return -1;
+    }
+    d->irq = pci->irq_line;
+
+    // Pedir el control al BIOS si el HBA lo admite
+    if (d->hba->cap2 & 1)
+    {
+        d->hba->bohc |= 1u << 1;
+        for (uint32_t i = 0; i < AHCI_SPIN_TIMEOUT && (d->hba->bohc & 1); i++)
+            cpu_relax();
+    }
+    d->hba->ghc |= AHCI_GHC_AE;
+    d->hba->ghc &= ~AHCI_GHC_IE;
+
+    uint32_t pi = d->hba->pi;
+    uint32_t port;
+    for (port = 0; port < 32; port++)
+    {
+        if ((pi & (1u << port)) && ahci_port_has_disk(&d->hba->ports[port]))
+            break;
+    }
+    if (port == 32)
+    {
+        printf("AHCI: ningun disco SATA conectado\n");
+        return -1;
+    }
+
+    d->port = (uint8_t)port;
+    d->regs = &d->hba->ports[port];
+    d->nslots = MIN(AHCI_CAP_NCS(d->hba->cap), AHCI_MAX_SLOTS);
+    if (ahci_port_setup(d) != 0 || ahci_port_idle(d->regs) != 0 || ahci_identify(d) != 0)
+    {
+        printf("AHCI: el puerto %u no responde\n", port);
+        return -1;
+    }
+
+    /* mark global pointer as initialized */
+    ahci_dev = d;
+    ahci_enable_irq(d);
+    ahci_blk_register(d);
+
+    printf("AHCI inicializado: BAR5=0x%x, puerto=%u, %u ranuras, %u MB, %s (cola %u), %s\n",
+           (uint32_t)d->bar5, d->port, d->nslots, (uint32_t)(d->sectors >> 11),
+           d->ncq ? "NCQ" : "DMA", d->queue_depth, d->irq_on ? "IRQ" : "sondeo");
+    return 0;
+}
+
+static const pci_id_t ahci_ids[] = {
+    {PCI_ANY_ID, PCI_ANY_ID, PCI_CLASS(0x01, 0x06, 0x01), 0xFFFFFF},
+    {0, 0, 0, 0},
+};
+
+static const pci_driver_t ahci_driver = {"ahci", ahci_ids, ahci_probe};
+
+// Inicializa AHCI detectando puerto SATA
+int ahci_init(ahci_device_t *dev)
+{
+    if (pci_register_driver(&ahci_driver) <= 0)
+    {
+        printf("AHCI no encontrado\n");
+        return -1;
+    }
+    if (dev)
+        *dev = ahci_dev_instance;
     return 0;
 }
+
+#ifdef AHCI_BENCH
+#include "timer.h"
+#include "div64.h"
+
+#define AHCI_BENCH_BYTES (32u << 20) // Total leído por cada tamaño de petición
+#define AHCI_BENCH_BUF (4u << 20)    // Mayor petición: 4 comandos de 1 MB en vuelo
+#define AHCI_BENCH_RANDOM_IOS 4096   // Lecturas de 4 KB por profundidad de cola
+
+static uint8_t ahci_bench_buf[AHCI_BENCH_BUF] __attribute__((aligned(4096)));
+static uint32_t ahci_bench_seed = 12345;
+
+static uint32_t ahci_bench_rand(void)
+{
+    ahci_bench_seed ^= ahci_bench_seed << 13;
+    ahci_bench_seed ^= ahci_bench_seed >> 17;
+    ahci_bench_seed ^= ahci_bench_seed << 5;
+    return ahci_bench_seed;
+}
+
+// Lee AHCI_BENCH_BYTES secuenciales en peticiones de varios tamaños
+static void ahci_bench_sequential(ahci_device_t *dev)
+{
+    static const uint32_t sizes[] = {4096, 65536, 1u << 20, AHCI_BENCH_BUF};
+
+    uint32_t total = AHCI_BENCH_BYTES;
+    if ((uint64_t)total / AHCI_BLOCK_SIZE > dev->sectors)
+        total = (uint32_t)dev->sectors * AHCI_BLOCK_SIZE;
+
+    for (uint32_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        uint32_t per = sizes[s] / AHCI_BLOCK_SIZE;
+        uint32_t reqs = total / sizes[s];
+        uint32_t errors = 0;
+
+        uint64_t t0 = rdtsc();
+        for (uint32_t r = 0; r < reqs; r++)
+            errors += ahci_read_blocks(dev, r * per, per, ahci_bench_buf) != 0;
+        uint32_t us = (uint32_t)timer_tsc_to_us(rdtsc() - t0);
+
+        // Bytes por microsegundo = MB/s
+        printf("ahci_bench: %u KB/peticion: %u MB en %u us = %u MB/s (%u errores)\n",
+               sizes[s] >> 10, (reqs * sizes[s]) >> 20, us,
+               us ? reqs * sizes[s] / us : 0, errors);
+    }
+}
+
+// Mantiene qd lecturas de 4 KB en vuelo en posiciones aleatorias del disco
+static void ahci_bench_random(ahci_device_t *dev, uint32_t qd)
+{
+    uint32_t span = (uint32_t)MIN(dev->sectors / 8, 0xFFFFFFFFull / 8);
+    uint32_t issued = 0, completed = 0, errors = 0, inflight = 0;
+
+    uint64_t t0 = rdtsc();
+    while (completed < AHCI_BENCH_RANDOM_IOS)
+    {
+        while (issued < AHCI_BENCH_RANDOM_IOS && inflight < qd)
+        {
+            // El contenido no importa: cada petición usa uno de 32 buffers
+            ahci_iovec_t iov = {ahci_bench_buf + (issued % AHCI_MAX_SLOTS) * 4096, 4096};
+            if (ahci_submit(dev, 0, (uint64_t)(ahci_bench_rand() % span) * 8, 8, &iov, 1) < 0)
+                break;
+            issued++;
+            inflight++;
+        }
+        if (inflight == 0)
+            break;
+
+        uint32_t failed;
+        uint32_t done = ahci_wait_any(dev, 0xFFFFFFFF, &failed);
+        completed += ahci_popcount(done);
+        inflight -= ahci_popcount(done);
+        errors += ahci_popcount(failed);
+    }
+    uint32_t us = (uint32_t)timer_tsc_to_us(rdtsc() - t0);
+    uint32_t iops = us ? (uint32_t)div64_u32((uint64_t)completed * 1000000, us, NULL) : 0;
+
+    printf("ahci_bench: %s QD%u: %u IOPS, %u KB/s (%u errores)\n",
+           dev->ncq ? "NCQ" : "DMA", qd, iops, iops * 4, errors);
+}
+
+static void ahci_bench_sweep(ahci_device_t *dev)
+{
+    for (uint32_t qd = 1; qd <= AHCI_MAX_SLOTS; qd *= 2)
+    {
+        if (qd > dev->queue_depth)
+            break;
+        ahci_bench_random(dev, qd);
+    }
+}
+
+void ahci_bench(void)
+{
+    ahci_device_t *dev = ahci_dev;
+    if (!dev)
+        return;
+
+    ahci_bench_sequential(dev);
+    ahci_bench_sweep(dev);
+
+    // La misma carga con DMA normal, para comparar con la cola NCQ
+    if (dev->ncq)
+    {
+        uint32_t depth = dev->queue_depth;
+        dev->ncq = 0;
+        dev->queue_depth = dev->nslots;
+        ahci_bench_sweep(dev);
+        dev->ncq = 1;
+        dev->queue_depth = depth;
+    }
+    printf("ahci_bench: max en vuelo=%u\n", dev->stats.max_inflight);
+}
+#endif
@@ -1,12 +1,12 @@
 #include <stdint.h>
+#include <stddef.h>
 #include "idt.h"
 #include "log.h"
 #include "isr_irq.h"
 #include "port.h"
+#include "lapic.h"
 
 #define IDT_ENTRIES 256
-#define IRQ_BASE 32
-#define IRQ_COUNT 16
 
 struct idt_entry
 {
@@ -25,7 +25,15 @@ struct idt_ptr
 
 static struct idt_entry idt[IDT_ENTRIES];
 
+// Manejadores registrados por línea IRQ
+static irq_handler_t irq_handlers[IRQ_COUNT][IRQ_MAX_HANDLERS];
+
+// Manejadores de los vectores MSI/MSI-X
+static irq_vector_handler_t irq_vector_handlers[IRQ_VECTOR_COUNT];
+static void *irq_vector_args[IRQ_VECTOR_COUNT];
+
 extern void *isr_stub_table[];
+extern void irq_spurious(void);
 
 static inline void lidt(void *base, uint16_t size)
 {
@@ -61,6 +69,91 @@ void pic_remap(void)
     outb(0xA1, a2);
 }
 
+// --- Máscaras del PIC ---
+void irq_unmask(uint8_t irq)
+{
+    if (irq >= IRQ_COUNT)
+        return;
+    if (irq >= 8)
+    {
+        outb(0xA1, inb(0xA1) & ~(1u << (irq - 8)));
+        irq = 2; // La cascada del esclavo también tiene que pasar
+    }
+    outb(0x21, inb(0x21) & ~(1u << irq));
+}
+
+void irq_mask(uint8_t irq)
+{
+    if (irq >= IRQ_COUNT)
+        return;
+    if (irq >= 8)
+        outb(0xA1, inb(0xA1) | (1u << (irq - 8)));
+    else
+        outb(0x21, inb(0x21) | (1u << irq));
+}
+
+int irq_register(uint8_t irq, irq_handler_t handler)
+{
+    if (irq >= IRQ_COUNT || !handler)
+        return -1;
+
+    for (int i = 0; i < IRQ_MAX_HANDLERS; i++)
+    {
+        if (irq_handlers[irq][i] == handler)
+            return 0;
+        if (!irq_handlers[irq][i])
+        {
+            irq_handlers[irq][i] = handler;
+            irq_unmask(irq);
+            KLOG_INFO("IRQ %d registered", irq);
+            return 0;
+        }
+    }
+    KLOG_ERR("IRQ %d: no free handler slots", irq);
+    return -1;
+}
+
+void irq_unregister(uint8_t irq, irq_handler_t handler)
+{
+    if (irq >= IRQ_COUNT)
+        return;
+    int i = 0;
+    while (i < IRQ_MAX_HANDLERS && irq_handlers[irq][i] != handler)
+        i++;
+    if (i == IRQ_MAX_HANDLERS)
+        return;
+    // Los que quedan siguen contiguos: el despacho para en el primer hueco
+    for (; i + 1 < IRQ_MAX_HANDLERS; i++)
+        irq_handlers[irq][i] = irq_handlers[irq][i + 1];
+    irq_handlers[irq][IRQ_MAX_HANDLERS - 1] = NULL;
+    if (!irq_handlers[irq][0])
+        irq_mask(irq);
+}
+
+int irq_alloc_vector(irq_vector_handler_t handler, void *arg)
+{
+    if (!handler || !lapic_enabled())
+        return -1;
+    for (int i = 0; i < IRQ_VECTOR_COUNT; i++)
+    {
+        if (irq_vector_handlers[i])
+            continue;
+        irq_vector_args[i] = arg;
+        irq_vector_handlers[i] = handler;
+        return IRQ_VECTOR_BASE + i;
+    }
+    KLOG_ERR("IRQ: no free vectors");
+    return -1;
+}
+
+void irq_free_vector(uint8_t vector)
+{
+    if (vector < IRQ_VECTOR_BASE || vector >= IRQ_VECTOR_BASE + IRQ_VECTOR_COUNT)
+        return;
+    irq_vector_handlers[vector - IRQ_VECTOR_BASE] = NULL;
+    irq_vector_args[vector - IRQ_VECTOR_BASE] = NULL;
+}
+
 void isr_init(void)
 {
     for (int i = 0; i < 32; i++)
@@ -74,6 +167,10 @@ void irq_init(void)
     pic_remap();
     for (int i = 0; i < IRQ_COUNT; i++)
         set_gate(IRQ_BASE + i, isr_stub_table[32 + i], 0x8E);
+    for (int i = 0; i < IRQ_VECTOR_COUNT; i++)
+        set_gate(IRQ_VECTOR_BASE + i, isr_stub_table[IRQ_VECTOR_BASE + i], 0x8E);
+    // El APIC local no espera EOI de las interrupciones espurias
+    set_gate(LAPIC_SPURIOUS_VECTOR, irq_spurious, 0x8E);
 
     KLOG_INFO("IRQs initialized");
 }
@@ -87,6 +184,13 @@ void idt_init(void)
 void isr_common_handler(uint32_t vec, uint32_t err)
 {
     KLOG_ERR("CPU EXCEPTION vec=%d err=0x%x", vec, err);
+    // Fallo de página: la dirección sin mapear o protegida queda en CR2
+    if (vec == 14)
+    {
+        uint32_t cr2;
+        __asm__ volatile("mov %%cr2, %0" : "=r"(cr2));
+        KLOG_ERR("page fault at %x", cr2);
+    }
     outb(0xE9, 'E');               // Indicar excepción
     outb(0xE9, vec & 0xFF);        // Enviar vector bajo
     outb(0xE9, (vec >> 8) & 0xFF); // Enviar vector alto
@@ -96,10 +200,38 @@ void isr_common_handler(uint32_t vec, uint32_t err)
 
 void irq_common_handler(uint32_t vec)
 {
-    KLOG_INFO("IRQ HANDLER vec=%d", vec);
-    outb(0xE9, 'I');               // Indicar IRQ
-    outb(0xE9, vec & 0xFF);        // Enviar vector bajo
-    outb(0xE9, (vec >> 8) & 0xFF); // Enviar vector alto
+    uint32_t irq = vec - IRQ_BASE;
+    int handled = 0;
+
+    // Vectores propios: vienen del APIC local, que es quien recibe el EOI
+    if (vec >= IRQ_VECTOR_BASE && vec < IRQ_VECTOR_BASE + IRQ_VECTOR_COUNT)
+    {
+        uint32_t i = vec - IRQ_VECTOR_BASE;
+        if (irq_vector_handlers[i])
+            irq_vector_handlers[i](irq_vector_args[i]);
+        lapic_eoi();
+        return;
+    }
+
+    // Los manejadores corren con las interrupciones deshabilitadas (puerta de
+    // interrupción) y antes del EOI: en una línea por nivel el dispositivo
+    // tiene que haber dejado de avisar cuando el PIC la vuelva a mirar
+    if (irq < IRQ_COUNT)
+    {
+        for (int i = 0; i < IRQ_MAX_HANDLERS && irq_handlers[irq][i]; i++)
+        {
+            irq_handlers[irq][i]();
+            handled = 1;
+        }
+    }
+
+    if (!handled)
+    {
+        KLOG_INFO("IRQ HANDLER vec=%d", vec);
+        outb(0xE9, 'I');               // Indicar IRQ
+        outb(0xE9, vec & 0xFF);        // Enviar vector bajo
+        outb(0xE9, (vec >> 8) & 0xFF); // Enviar vector alto
+    }
 
     if (vec >= 40)
         outb(0xA0, 0x20);
@@ -112,6 +112,45 @@ IRQ 13
 IRQ 14
 IRQ 15
 
+; Vectores 48-79 (MSI/MSI-X, por el APIC local)
+IRQ 16
+IRQ 17
+IRQ 18
+IRQ 19
+IRQ 20
+IRQ 21
+IRQ 22
+IRQ 23
+IRQ 24
+IRQ 25
+IRQ 26
+IRQ 27
+IRQ 28
+IRQ 29
+IRQ 30
+IRQ 31
+IRQ 32
+IRQ 33
+IRQ 34
+IRQ 35
+IRQ 36
+IRQ 37
+IRQ 38
+IRQ 39
+IRQ 40
+IRQ 41
+IRQ 42
+IRQ 43
+IRQ 44
+IRQ 45
+IRQ 46
+IRQ 47
+
+; Espuria del APIC local: sin EOI
+[global irq_spurious]
+irq_spurious:
+    iret
+
 ; -----------------------------------------
 ; Tabla de punteros
 ; -----------------------------------------
@@ -124,3 +163,7 @@ isr_stub_table:
     dd isr24, isr25, isr26, isr27, isr28, isr29, isr30, isr31
     dd irq0, irq1, irq2, irq3, irq4, irq5, irq6, irq7
     dd irq8, irq9, irq10, irq11, irq12, irq13, irq14, irq15
+    dd irq16, irq17, irq18, irq19, irq20, irq21, irq22, irq23
+    dd irq24, irq25, irq26, irq27, irq28, irq29, irq30, irq31
+    dd irq32, irq33, irq34, irq35, irq36, irq37, irq38, irq39
+    dd irq40, irq41, irq42, irq43, irq44, irq45, irq46, irq47
@@ -0,0 +1,235 @@
+#include <stdint.h>
+#include "lapic.h"
+#include "idt.h"
+#include "cpu.h"
+#include "paging.h"
+#include "log.h"
+#include "stdio.h"
+
+#define IA32_APIC_BASE_MSR 0x1B
+#define IA32_APIC_BASE_ENABLE (1u << 11)
+#define CPUID_EDX_APIC (1u << 9)
+#define LAPIC_REGS_SIZE 0x1000 // Una página de registros
+
+// Registros, desde la base
+#define LAPIC_ID 0x020
+#define LAPIC_VERSION 0x030
+#define LAPIC_TPR 0x080
+#define LAPIC_EOI 0x0B0
+#define LAPIC_SVR 0x0F0
+#define LAPIC_ICR_LOW 0x300
+#define LAPIC_LVT_LINT0 0x350
+#define LAPIC_LVT_LINT1 0x360
+#define LAPIC_LVT_ERROR 0x370
+
+#define LAPIC_SVR_ENABLE (1u << 8)
+#define LAPIC_LVT_MASKED (1u << 16)
+#define LAPIC_DM_NMI (4u << 8)
+#define LAPIC_DM_EXTINT (7u << 8)
+#define LAPIC_ICR_SELF (1u << 18) // Destino abreviado: esta CPU
+
+// Registros mapeados sin caché en su dirección física
+static volatile uint32_t *lapic_base; // NULL: sin APIC local
+static uint8_t lapic_apic_id;
+
+static inline uint32_t lapic_read(uint32_t reg)
+{
+    return lapic_base[reg / 4];
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t value)
+{
+    lapic_base[reg / 4] = value;
+}
+
+int lapic_init(void)
+{
+    uint32_t a, b, c, d;
+    cpuid(1, 0, &a, &b, &c, &d);
+    if (!(d & CPUID_EDX_APIC))
+    {
+        KLOG_WARN("LAPIC not present");
+        return -1;
+    }
+
+    uint64_t msr = rdmsr(IA32_APIC_BASE_MSR);
+    uint64_t base = msr & 0xFFFFFF000ull;
+    if (base >> 32)
+    {
+        KLOG_WARN("LAPIC above 4 GB");
+        return -1;
+    }
+    volatile uint32_t *regs = (volatile uint32_t *)paging_map_mmio(base, LAPIC_REGS_SIZE);
+    if (!regs)
+    {
+        KLOG_WARN("LAPIC registers not mapped");
+        return -1;
+    }
+    if (!(msr & IA32_APIC_BASE_ENABLE))
+        wrmsr(IA32_APIC_BASE_MSR, msr | IA32_APIC_BASE_ENABLE);
+    lapic_base = regs;
+
+    // Cable virtual: el PIC entra por LINT0 como ExtINT (su EOI sigue siendo
+    // el del PIC) y la NMI por LINT1
+    lapic_write(LAPIC_LVT_LINT0, LAPIC_DM_EXTINT);
+    lapic_write(LAPIC_LVT_LINT1, LAPIC_DM_NMI);
+    lapic_write(LAPIC_LVT_ERROR, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_TPR, 0); // Se aceptan todas las prioridades
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_VECTOR);
+
+    lapic_apic_id = (uint8_t)(lapic_read(LAPIC_ID) >> 24);
+    KLOG_INFO("LAPIC base=%x id=%d version=%x", (uint32_t)base, (int)lapic_apic_id,
+              lapic_read(LAPIC_VERSION) & 0xFF);
+    return 0;
+}
+
+int lapic_enabled(void)
+{
+    return lapic_base != NULL;
+}
+
+uint8_t lapic_id(void)
+{
+    return lapic_apic_id;
+}
+
+void lapic_eoi(void)
+{
+    if (lapic_base)
+        lapic_write(LAPIC_EOI, 0);
+}
+
+uint32_t lapic_msi_address(void)
+{
+    return LAPIC_MSI_ADDRESS | ((uint32_t)lapic_apic_id << 12);
+}
+
+// Entrega fija, por flanco
+uint32_t lapic_msi_data(uint8_t vector)
+{
+    return vector;
+}
+
+#ifdef IRQ_BENCH
+#include "timer.h"
+#include "div64.h"
+#include "port.h"
+
+#define IRQ_BENCH_ROUNDS 200
+#define IRQ_BENCH_PIT_COUNT 2 // Pulsos del PIT hasta la interrupción (~1,7 us)
+
+static volatile uint64_t irq_bench_stamp;
+static volatile uint32_t irq_bench_hits;
+
+static void irq_bench_vector(void *arg)
+{
+    (void)arg;
+    irq_bench_stamp = rdtsc();
+    irq_bench_hits++;
+}
+
+static void irq_bench_line(void)
+{
+    irq_bench_stamp = rdtsc();
+    irq_bench_hits++;
+}
+
+// Espera la interrupción número hits; 0 si no llega en 10 ms
+static int irq_bench_wait(uint32_t hits, uint64_t limit)
+{
+    uint64_t t0 = rdtsc();
+    while (irq_bench_hits != hits)
+    {
+        if (rdtsc() - t0 > limit)
+            return 0;
+        cpu_relax();
+    }
+    return 1;
+}
+
+static uint32_t irq_bench_ns(uint64_t cycles, uint32_t khz)
+{
+    return (uint32_t)div64_u32(cycles * 1000000, khz, NULL);
+}
+
+static void irq_bench_report(const char *path, uint64_t total, uint64_t min, uint32_t n,
+                             uint32_t khz)
+{
+    if (!n)
+    {
+        printf("IRQ: %s: no llega ninguna interrupcion\n", path);
+        return;
+    }
+    uint64_t avg = div64_u32(total, n, NULL);
+    printf("IRQ: %s: media %u ns (%u ciclos), minimo %u ns, %u medidas\n", path,
+           irq_bench_ns(avg, khz), (uint32_t)avg, irq_bench_ns(min, khz), n);
+}
+
+void irq_bench(void)
+{
+    uint32_t khz = timer_tsc_khz();
+    uint64_t limit = (uint64_t)khz * 10;
+    if (!khz)
+        return;
+
+    // APIC local: la CPU se envía el vector a sí misma
+    int vector = irq_alloc_vector(irq_bench_vector, NULL);
+    if (vector >= 0)
+    {
+        uint64_t total = 0, min = ~0ull;
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < IRQ_BENCH_ROUNDS; i++)
+        {
+            uint32_t hits = irq_bench_hits;
+            uint64_t t0 = rdtsc();
+            lapic_write(LAPIC_ICR_LOW, LAPIC_ICR_SELF | (uint32_t)vector);
+            if (!irq_bench_wait(hits + 1, limit))
+                break;
+            uint64_t dt = irq_bench_stamp - t0;
+            total += dt;
+            min = dt < min ? dt : min;
+            n++;
+        }
+        irq_free_vector((uint8_t)vector);
+        irq_bench_report("APIC local (autoenvio)", total, min, n, khz);
+    }
+
+    // PIC: el canal 0 del PIT en modo 0 avisa tras un número conocido de
+    // pulsos; ese tiempo se descuenta
+    uint64_t expected = div64_u32((uint64_t)IRQ_BENCH_PIT_COUNT * khz * 1000, 1193182, NULL);
+    uint64_t total = 0, min = ~0ull;
+    uint32_t n = 0;
+    irq_register(0, irq_bench_line);
+    for (uint32_t i = 0; i < IRQ_BENCH_ROUNDS; i++)
+    {
+        uint32_t hits = irq_bench_hits;
+        uint64_t t0 = rdtsc();
+        pit_oneshot(IRQ_BENCH_PIT_COUNT);
+        if (!irq_bench_wait(hits + 1, limit))
+            break;
+        uint64_t dt = irq_bench_stamp - t0;
+        dt = dt > expected ? dt - expected : 0;
+        total += dt;
+        min = dt < min ? dt : min;
+        n++;
+    }
+    irq_unregister(0, irq_bench_line);
+    pit_restart();
+    irq_bench_report("PIC (PIT en modo 0)", total, min, n, khz);
+
+    // Coste del EOI de cada camino. Sin nada en servicio ninguno hace nada.
+    uint32_t flags = irq_save();
+    uint64_t t0 = rdtsc();
+    for (uint32_t i = 0; i < IRQ_BENCH_ROUNDS; i++)
+        outb(0x20, 0x20);
+    uint64_t pic = rdtsc() - t0;
+    t0 = rdtsc();
+    for (uint32_t i = 0; i < IRQ_BENCH_ROUNDS && lapic_base; i++)
+        lapic_eoi();
+    uint64_t apic = rdtsc() - t0;
+    irq_restore(flags);
+    printf("IRQ: EOI del PIC %u ciclos, del APIC local %u ciclos\n",
+           (uint32_t)div64_u32(pic, IRQ_BENCH_ROUNDS, NULL),
+           (uint32_t)div64_u32(apic, IRQ_BENCH_ROUNDS, NULL));
+}
+#endif
@@ -0,0 +1,298 @@
+// kernel/arch/x86/paging.c
+#include "paging.h"
+#include "page.h"
+#include "e820.h"
+#include "cpu.h"
+#include "stdio.h"
+#include "string.h"
+#include "sys/types.h"
+
+// Fin de la imagen del kernel con su .bss (kernel/kernel.ld)
+extern char __kernel_end[];
+
+#define CPUID_EDX_PSE (1u << 3)
+#define CPUID_EDX_PGE (1u << 13)
+#define CR0_WP (1u << 16) // El kernel también respeta las páginas de solo lectura
+#define CR0_PG (1u << 31)
+#define CR4_PSE (1u << 4)
+#define CR4_PGE (1u << 7)
+
+#define PAGING_ENTRIES 1024
+#define PDE_INDEX(a) ((a) >> 22)
+#define PTE_INDEX(a) (((a) >> PAGE_SHIFT) & (PAGING_ENTRIES - 1))
+#define PTE_ADDR_MASK 0xFFFFF000u
+#define PAGING_TOP 0x100000000ull // Sin PAE, 4 GB
+
+static uint32_t paging_dir[PAGING_ENTRIES] __attribute__((aligned(PAGE_SIZE)));
+static uint32_t paging_on;
+static paging_stats_t paging_stats;
+
+// --- Registros de control ---
+static inline uint32_t read_cr0(void)
+{
+    uint32_t v;
+    __asm__ volatile("mov %%cr0, %0" : "=r"(v));
+    return v;
+}
+
+static inline void write_cr0(uint32_t v)
+{
+    __asm__ volatile("mov %0, %%cr0" : : "r"(v) : "memory");
+}
+
+static inline uint32_t read_cr3(void)
+{
+    uint32_t v;
+    __asm__ volatile("mov %%cr3, %0" : "=r"(v));
+    return v;
+}
+
+// También descarta del TLB todo lo que no es global
+static inline void write_cr3(uint32_t v)
+{
+    __asm__ volatile("mov %0, %%cr3" : : "r"(v) : "memory");
+}
+
+static inline uint32_t read_cr4(void)
+{
+    uint32_t v;
+    __asm__ volatile("mov %%cr4, %0" : "=r"(v));
+    return v;
+}
+
+static inline void write_cr4(uint32_t v)
+{
+    __asm__ volatile("mov %0, %%cr4" : : "r"(v) : "memory");
+}
+
+static inline void paging_flush(uint32_t addr)
+{
+    if (paging_on)
+        __asm__ volatile("invlpg (%0)" : : "r"(addr) : "memory");
+}
+
+// --- Tablas ---
+// Tabla de páginas que cubre addr; se crea vacía si no la hay. NULL si no
+// quedan marcos.
+static uint32_t *paging_table(uint32_t addr)
+{
+    uint32_t *pde = &paging_dir[PDE_INDEX(addr)];
+    if (!(*pde & PTE_PRESENT))
+    {
+        uint32_t *pt = (uint32_t *)page_alloc(0);
+        if (!pt)
+            return NULL;
+        memset(pt, 0, PAGE_SIZE);
+        // Los bits de caché de la página los pone cada entrada de la tabla
+        *pde = (uint32_t)pt | PTE_PRESENT | PTE_WRITE;
+        paging_stats.tables++;
+    }
+    return (uint32_t *)(*pde & PTE_ADDR_MASK);
+}
+
+// [start, end) alineados a página. Con large, los tramos de 4 MB enteros
+// y sin tabla van en una sola entrada del directorio.
+static int paging_map_range(uint64_t start, uint64_t end, uint32_t flags, int large)
+{
+    large = large && paging_stats.pse;
+    for (uint64_t a = start; a < end;)
+    {
+        uint32_t va = (uint32_t)a;
+        uint32_t *pde = &paging_dir[PDE_INDEX(va)];
+
+        if (large && !(va & (PAGING_LARGE_SIZE - 1)) && a + PAGING_LARGE_SIZE <= end &&
+            !(*pde & PTE_PRESENT))
+        {
+            *pde = va | flags | PDE_LARGE;
+            paging_stats.large_pages++;
+            paging_flush(va);
+            a += PAGING_LARGE_SIZE;
+            continue;
+        }
+        // Ya en una página grande: hasta el siguiente tramo de 4 MB
+        if (*pde & PDE_LARGE)
+        {
+            a = (a | (PAGING_LARGE_SIZE - 1)) + 1;
+            continue;
+        }
+
+        uint32_t *pt = paging_table(va);
+        if (!pt)
+            return -1;
+        uint32_t *pte = &pt[PTE_INDEX(va)];
+        if (!(*pte & PTE_PRESENT))
+        {
+            paging_stats.small_pages++;
+            if (flags & PTE_PCD)
+                paging_stats.mmio_pages++;
+        }
+        *pte = va | (flags & ~PTE_GLOBAL);
+        paging_flush(va);
+        a += PAGE_SIZE;
+    }
+    return 0;
+}
+
+// --- Inicialización ---
+// RAM y tablas del firmware por encima de low, en páginas de 4 KB
+static int paging_map_ram(uint32_t low)
+{
+    const e820_map_t *map = e820_map();
+    uint32_t count = map->count;
+    if (count == 0 || count > E820_MAX_ENTRIES)
+        return low < PAGE_FALLBACK_END ? paging_map_range(low, PAGE_FALLBACK_END, PTE_PRESENT | PTE_WRITE, 0)
+                                       : 0;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const e820_entry_t *e = &map->entries[i];
+        if (!(e->acpi & 1))
+            continue;
+        if (e->type != E820_RAM && e->type != E820_ACPI && e->type != E820_NVS)
+            continue;
+        uint64_t start = e->base & ~(uint64_t)(PAGE_SIZE - 1);
+        uint64_t end = (e->base + e->length + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1);
+        if (start < low)
+            start = low;
+        if (end > PAGING_TOP)
+            end = PAGING_TOP;
+        if (start < end && paging_map_range(start, end, PTE_PRESENT | PTE_WRITE, 0) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+int paging_init(void)
+{
+    uint32_t a, b, c, d;
+    cpuid(1, 0, &a, &b, &c, &d);
+    paging_stats.pse = (d & CPUID_EDX_PSE) != 0;
+    paging_stats.pge = (d & CPUID_EDX_PGE) != 0;
+
+    // El kernel con su .bss, la pila del arranque, la BIOS y la VGA en
+    // páginas de 4 MB: una entrada de TLB para todo el camino caliente.
+    // Globales: siguen en el TLB aunque se recargue CR3.
+    uint32_t kernel_end = ((uint32_t)__kernel_end + PAGING_LARGE_SIZE - 1) & ~(PAGING_LARGE_SIZE - 1);
+    uint32_t kflags = PTE_PRESENT | PTE_WRITE | (paging_stats.pge ? PTE_GLOBAL : 0);
+    if (paging_map_range(0, kernel_end, kflags, 1) != 0 || paging_map_ram(kernel_end) != 0)
+    {
+        printf("Paginación: no quedan marcos para las tablas\n");
+        return -1;
+    }
+
+    write_cr3((uint32_t)paging_dir);
+    if (paging_stats.pse || paging_stats.pge)
+        write_cr4(read_cr4() | (paging_stats.pse ? CR4_PSE : 0) | (paging_stats.pge ? CR4_PGE : 0));
+    write_cr0(read_cr0() | CR0_PG | CR0_WP);
+    paging_on = 1;
+
+    printf("Paginación: kernel hasta 0x%x en páginas de %s, %u páginas de 4 KB en %u tablas\n",
+           kernel_end, paging_stats.pse ? "4 MB" : "4 KB", paging_stats.small_pages, paging_stats.tables);
+    return 0;
+}
+
+int paging_enabled(void)
+{
+    return paging_on;
+}
+
+// --- Mapeos ---
+void *paging_map(uint64_t phys, uint32_t size, uint32_t flags)
+{
+    if (size == 0 || phys + size > PAGING_TOP)
+        return NULL;
+    if (!paging_on)
+        return (void *)(uint32_t)phys;
+
+    uint64_t start = phys & ~(uint64_t)(PAGE_SIZE - 1);
+    uint64_t end = (phys + size + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1);
+    uint32_t irq = irq_save();
+    int r = paging_map_range(start, end, (flags & ~(PDE_LARGE | PTE_ADDR_MASK)) | PTE_PRESENT, 1);
+    irq_restore(irq);
+    return r == 0 ? (void *)(uint32_t)phys : NULL;
+}
+
+void *paging_map_mmio(uint64_t phys, uint32_t size)
+{
+    return paging_map(phys, size, PTE_WRITE | PTE_PCD | PTE_PWT);
+}
+
+void paging_get_stats(paging_stats_t *out)
+{
+    uint32_t flags = irq_save();
+    *out = paging_stats;
+    irq_restore(flags);
+}
+
+void paging_print_stats(void)
+{
+    paging_stats_t s;
+    paging_get_stats(&s);
+    printf("Paginación: %s, %u páginas de 4 MB, %u de 4 KB (%u MMIO), %u tablas; PSE %s, PGE %s\n",
+           paging_on ? "activa" : "inactiva", s.large_pages, s.small_pages, s.mmio_pages, s.tables,
+           s.pse ? "si" : "no", s.pge ? "si" : "no");
+}
+
+#ifdef PAGING_BENCH
+#include "div64.h"
+
+#define PAGING_BENCH_PAGES 512 // 2 MB: más de lo que cubre el TLB de 4 KB
+#define PAGING_BENCH_ROUNDS 64
+
+// Una lectura por página tras vaciar el TLB; el desplazamiento cambia de
+// línea en cada página para no cargar siempre el mismo conjunto de la caché
+static uint32_t paging_bench_walk(const volatile uint8_t *base)
+{
+    uint64_t total = 0;
+    uint32_t sink = 0;
+    for (uint32_t r = 0; r < PAGING_BENCH_ROUNDS; r++)
+    {
+        write_cr3(read_cr3());
+        uint64_t t0 = rdtsc();
+        for (uint32_t i = 0; i < PAGING_BENCH_PAGES; i++)
+            sink += base[i * PAGE_SIZE + ((i * 64) & (PAGE_SIZE - 1))];
+        total += rdtsc() - t0;
+    }
+    (void)sink;
+    return (uint32_t)div64_u32(total, PAGING_BENCH_ROUNDS * PAGING_BENCH_PAGES, NULL);
+}
+
+void paging_bench(void)
+{
+    if (!paging_on)
+    {
+        printf("paging_bench: paginación inactiva\n");
+        return;
+    }
+
+    // Un bloque de 2 MB fuera de las páginas grandes del kernel
+    uint8_t *small = NULL;
+    uint8_t *skipped = NULL;
+    for (uint32_t tries = 0; tries < 2 && !small; tries++)
+    {
+        uint8_t *p = (uint8_t *)page_alloc(9);
+        if (p && (paging_dir[PDE_INDEX((uint32_t)p)] & PDE_LARGE))
+            skipped = p;
+        else
+            small = p;
+    }
+    if (skipped)
+        page_free(skipped);
+    if (!small)
+    {
+        printf("paging_bench: no hay 2 MB en páginas de 4 KB\n");
+        return;
+    }
+
+    // Los primeros 2 MB (kernel, BIOS) están en una página grande si hay PSE.
+    // La dirección 0 pasa por un registro para que GCC no la vea nula.
+    uint32_t low = 0;
+    __asm__("" : "+r"(low));
+    uint32_t large = paging_bench_walk((const volatile uint8_t *)low);
+    uint32_t pages = paging_bench_walk(small);
+    page_free(small);
+
+    printf("paging_bench: lectura por página tras recargar CR3: %u ciclos en %s, %u en páginas de 4 KB\n",
+           large, paging_stats.pse ? (paging_stats.pge ? "4 MB globales" : "4 MB") : "4 KB", pages);
+}
+#endif
@@ -0,0 +1,637 @@
+#include "nvme.h"
+#include "blkdev.h"
+#include "pci.h"
+#include "cpu.h"
+#include "idt.h"
+#include "timer.h"
+#include "paging.h"
+#include "stdio.h"
+#include "string.h"
+#include "sys/types.h"
+
+static nvme_device_t nvme_dev_instance;
+static nvme_device_t *nvme_dev = NULL; // NULL hasta que arranca
+
+// Memoria que lee y escribe el controlador. Cada cola empieza en página
+// propia (colas físicamente contiguas, PC = 1).
+static nvme_cmd_t nvme_admin_sq[NVME_ADMIN_DEPTH] __attribute__((aligned(NVME_PAGE_SIZE)));
+static nvme_cpl_t nvme_admin_cq[NVME_ADMIN_DEPTH] __attribute__((aligned(NVME_PAGE_SIZE)));
+static nvme_cmd_t nvme_io_sq[NVME_MAX_IO_QUEUES][NVME_IO_DEPTH] __attribute__((aligned(NVME_PAGE_SIZE)));
+static nvme_cpl_t nvme_io_cq[NVME_MAX_IO_QUEUES][NVME_PAGE_SIZE / sizeof(nvme_cpl_t)]
+    __attribute__((aligned(NVME_PAGE_SIZE)));
+static uint8_t nvme_identify_buf[NVME_PAGE_SIZE] __attribute__((aligned(NVME_PAGE_SIZE)));
+
+// Lista PRP de cada comando de E/S: 512 bytes alineados, nunca cruza página
+static uint64_t nvme_prp[NVME_MAX_IO_QUEUES][NVME_IO_DEPTH][NVME_PRP_ENTRIES]
+    __attribute__((aligned(NVME_PAGE_SIZE)));
+
+// Petición de la capa en vuelo. Si sus fragmentos no forman una lista PRP
+// válida va en varios comandos y se avisa cuando acaba el último.
+typedef struct nvme_io
+{
+    blk_request_t *req;
+    uint16_t pending; // Comandos sin terminar
+    int8_t status;
+    uint8_t in_use;
+    struct nvme_io *next;
+} nvme_io_t;
+
+static nvme_io_t nvme_ios[NVME_MAX_INFLIGHT];
+
+static blkdev_t nvme_blkdev;
+
+static inline uint32_t nvme_phys(const void *p)
+{
+    return (uint32_t)p;
+}
+
+// --- Colas ---
+static void nvme_queue_setup(nvme_device_t *dev, nvme_queue_t *q, uint16_t qid, nvme_cmd_t *sq,
+                             nvme_cpl_t *cq, uint16_t depth)
+{
+    volatile uint8_t *db = (volatile uint8_t *)dev->regs + NVME_DOORBELL_BASE;
+
+    memset(q, 0, sizeof(*q));
+    memset(sq, 0, depth * sizeof(nvme_cmd_t));
+    memset(cq, 0, depth * sizeof(nvme_cpl_t));
+    q->qid = qid;
+    q->depth = depth;
+    q->sq = sq;
+    q->cq = cq;
+    q->sq_db = (volatile uint32_t *)(db + (2 * qid) * dev->dstrd);
+    q->cq_db = (volatile uint32_t *)(db + (2 * qid + 1) * dev->dstrd);
+    q->phase = 1;
+
+    // Un identificador menos que entradas: la cola de envío nunca se llena
+    for (uint16_t cid = 0; cid + 1 < depth; cid++)
+        q->free_cids[q->nfree++] = cid;
+}
+
+static void nvme_push(nvme_queue_t *q, const nvme_cmd_t *cmd)
+{
+    q->sq[q->sq_tail] = *cmd;
+    q->sq_tail = (uint16_t)((q->sq_tail + 1) % q->depth);
+}
+
+// Un timbre publica todo lo escrito desde el anterior
+static void nvme_ring(nvme_device_t *dev, nvme_queue_t *q)
+{
+    if (q->sq_tail == q->sq_rung)
+        return;
+    barrier();
+    *q->sq_db = q->sq_tail;
+    q->sq_rung = q->sq_tail;
+    dev->stats.sq_doorbells++;
+}
+
+static inline int nvme_cq_pending(const nvme_queue_t *q)
+{
+    return (*(volatile uint16_t *)&q->cq[q->cq_head].status & 1) == q->phase;
+}
+
+// Siguiente entrada de finalización, si el controlador ya la escribió
+static int nvme_cq_next(nvme_queue_t *q, nvme_cpl_t *out)
+{
+    if (!nvme_cq_pending(q))
+        return 0;
+    barrier();
+    *out = q->cq[q->cq_head];
+    if (++q->cq_head == q->depth)
+    {
+        q->cq_head = 0;
+        q->phase ^= 1;
+    }
+    return 1;
+}
+
+// --- Administración ---
+// Un comando cada vez y por sondeo: solo se usan al arrancar
+static int nvme_admin(nvme_device_t *dev, nvme_cmd_t *cmd, uint32_t *result)
+{
+    nvme_queue_t *q = &dev->admin;
+    cmd->cid = 0;
+    nvme_push(q, cmd);
+    nvme_ring(dev, q);
+
+    uint64_t start = timer_ticks();
+    nvme_cpl_t cpl;
+    while (!nvme_cq_next(q, &cpl))
+    {
+        if (timer_ticks() - start >= NVME_TIMEOUT_TICKS)
+        {
+            printf("NVMe: el comando 0x%x no responde\n", cmd->opcode);
+            return -1;
+        }
+        cpu_relax();
+    }
+    *q->cq_db = q->cq_head;
+
+    if (result)
+        *result = cpl.result;
+    if (cpl.status >> 1)
+    {
+        printf("NVMe: comando 0x%x fallo (estado 0x%x)\n", cmd->opcode, cpl.status >> 1);
+        return -1;
+    }
+    return 0;
+}
+
+static int nvme_identify(nvme_device_t *dev, uint32_t cns, uint32_t nsid)
+{
+    nvme_cmd_t cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.opcode = NVME_ADMIN_IDENTIFY;
+    cmd.nsid = nsid;
+    cmd.prp1 = nvme_phys(nvme_identify_buf);
+    cmd.cdw10 = cns;
+    return nvme_admin(dev, &cmd, NULL);
+}
+
+// iv: entrada MSI-X que usa la cola (0 con INTx)
+static int nvme_create_io_queue(nvme_device_t *dev, nvme_queue_t *q, int irq, uint16_t iv)
+{
+    nvme_cmd_t cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.opcode = NVME_ADMIN_CREATE_CQ;
+    cmd.prp1 = nvme_phys(q->cq);
+    cmd.cdw10 = ((uint32_t)(q->depth - 1) << 16) | q->qid;
+    cmd.cdw11 = 1 | (irq ? 2 : 0) | ((uint32_t)iv << 16); // Contigua; con interrupción
+    if (nvme_admin(dev, &cmd, NULL) != 0)
+        return -1;
+
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.opcode = NVME_ADMIN_CREATE_SQ;
+    cmd.prp1 = nvme_phys(q->sq);
+    cmd.cdw10 = ((uint32_t)(q->depth - 1) << 16) | q->qid;
+    cmd.cdw11 = 1 | ((uint32_t)q->qid << 16); // Contigua, termina en su pareja
+    return nvme_admin(dev, &cmd, NULL);
+}
+
+// --- Emisión ---
+static nvme_io_t *nvme_get_io(void)
+{
+    for (uint32_t i = 0; i < NVME_MAX_INFLIGHT; i++)
+    {
+        if (!nvme_ios[i].in_use)
+        {
+            nvme_ios[i].in_use = 1;
+            return &nvme_ios[i];
+        }
+    }
+    return NULL;
+}
+
+// Entre dos fragmentos la lista PRP solo sigue si el primero acaba y el
+// segundo empieza en frontera de página
+static inline int nvme_prp_break(const blk_iovec_t *a, const blk_iovec_t *b)
+{
+    return (((uint32_t)a->buf + a->bytes) | (uint32_t)b->buf) & (NVME_PAGE_SIZE - 1);
+}
+
+// Comandos que necesita la petición; 0 si algún tramo no es de sectores enteros
+static uint32_t nvme_count_cmds(const blk_request_t *req)
+{
+    uint32_t cmds = 1;
+    uint32_t bytes = req->iov[0].bytes;
+    for (uint32_t i = 1; i < req->iovcnt; i++)
+    {
+        if (nvme_prp_break(&req->iov[i - 1], &req->iov[i]))
+        {
+            if (bytes % BLK_SECTOR_SIZE)
+                return 0;
+            cmds++;
+            bytes = 0;
+        }
+        bytes += req->iov[i].bytes;
+    }
+    return cmds;
+}
+
+// PRP de los fragmentos [first, last]: la primera entrada puede empezar a
+// mitad de página, las demás son páginas enteras. Devuelve los bytes.
+static uint32_t nvme_build_prp(nvme_device_t *dev, nvme_cmd_t *cmd, uint64_t *list,
+                               const blk_iovec_t *iov, uint32_t first, uint32_t last)
+{
+    uint32_t n = 0, total = 0;
+    for (uint32_t i = first; i <= last; i++)
+    {
+        uint32_t addr = nvme_phys(iov[i].buf);
+        uint32_t rem = iov[i].bytes;
+        total += rem;
+        while (rem)
+        {
+            if (n == 0)
+                cmd->prp1 = addr;
+            else
+                list[n - 1] = addr;
+            n++;
+            uint32_t step = MIN(rem, NVME_PAGE_SIZE - (addr & (NVME_PAGE_SIZE - 1)));
+            addr += step;
+            rem -= step;
+        }
+    }
+
+    // Dos páginas caben en el comando; más van en la lista
+    if (n == 2)
+        cmd->prp2 = list[0];
+    else if (n > 2)
+    {
+        cmd->prp2 = nvme_phys(list);
+        dev->stats.prp_lists++;
+    }
+    return total;
+}
+
+// Lo llama la capa de bloques con las interrupciones deshabilitadas. Solo
+// escribe en la cola: el timbre lo toca nvme_blk_commit al final de la tanda.
+static int nvme_blk_submit(blkdev_t *bdev, blk_request_t *req)
+{
+    nvme_device_t *dev = (nvme_device_t *)bdev->priv;
+    // Con dos parejas las lecturas no esperan detrás de una tanda de escrituras
+    uint32_t qi = (req->write && dev->nio > 1) ? 1 : 0;
+    nvme_queue_t *q = &dev->io[qi];
+
+    uint32_t cmds = nvme_count_cmds(req);
+    if (cmds == 0)
+    {
+        dev->stats.errors++;
+        blkdev_complete(req, -1);
+        return 0;
+    }
+    if (q->nfree < cmds)
+        return -1;
+    nvme_io_t *io = nvme_get_io();
+    if (!io)
+        return -1;
+
+    io->req = req;
+    io->pending = (uint16_t)cmds;
+    io->status = 0;
+
+    uint64_t lba = req->lba;
+    uint32_t first = 0;
+    for (uint32_t i = 0; i < req->iovcnt; i++)
+    {
+        if (i + 1 < req->iovcnt && !nvme_prp_break(&req->iov[i], &req->iov[i + 1]))
+            continue;
+
+        uint16_t cid = q->free_cids[--q->nfree];
+        nvme_cmd_t cmd;
+        memset(&cmd, 0, sizeof(cmd));
+        cmd.opcode = req->write ? NVME_CMD_WRITE : NVME_CMD_READ;
+        cmd.cid = cid;
+        cmd.nsid = dev->nsid;
+        uint32_t sectors = nvme_build_prp(dev, &cmd, nvme_prp[qi][cid], req->iov, first, i) /
+                           BLK_SECTOR_SIZE;
+        cmd.cdw10 = (uint32_t)lba;
+        cmd.cdw11 = (uint32_t)(lba >> 32);
+        cmd.cdw12 = sectors - 1;
+
+        q->cid_io[cid] = io;
+        nvme_push(q, &cmd);
+        lba += sectors;
+        first = i + 1;
+    }
+
+    dev->inflight++;
+    dev->stats.commands += cmds;
+    dev->stats.split += cmds > 1;
+    return 0;
+}
+
+static void nvme_blk_commit(blkdev_t *bdev)
+{
+    nvme_device_t *dev = (nvme_device_t *)bdev->priv;
+    for (uint32_t i = 0; i < dev->nio; i++)
+        nvme_ring(dev, &dev->io[i]);
+}
+
+// --- Finalización ---
+// Recoge las finalizaciones de una cola (de todas con only == NULL) con un
+// timbre por cola y después avisa a la capa. Con las interrupciones
+// deshabilitadas.
+static uint32_t nvme_retire(nvme_device_t *dev, nvme_queue_t *only)
+{
+    nvme_io_t *done = NULL, **tail = &done;
+
+    for (uint32_t i = 0; i < dev->nio; i++)
+    {
+        nvme_queue_t *q = &dev->io[i];
+        if (only && q != only)
+            continue;
+        uint32_t n = 0;
+        nvme_cpl_t cpl;
+        while (nvme_cq_next(q, &cpl))
+        {
+            n++;
+            if (cpl.cid >= q->depth || !q->cid_io[cpl.cid])
+                continue;
+            nvme_io_t *io = q->cid_io[cpl.cid];
+            q->cid_io[cpl.cid] = NULL;
+            q->free_cids[q->nfree++] = cpl.cid;
+            if (cpl.status >> 1)
+                io->status = -1;
+            if (--io->pending == 0)
+            {
+                io->next = NULL;
+                *tail = io;
+                tail = &io->next;
+            }
+        }
+        if (n)
+        {
+            *q->cq_db = q->cq_head;
+            dev->stats.cq_doorbells++;
+            dev->stats.completions += n;
+        }
+    }
+
+    // Liberar antes del aviso: la capa puede despachar otra dentro
+    uint32_t completed = 0;
+    while (done)
+    {
+        nvme_io_t *io = done;
+        blk_request_t *req = io->req;
+        int status = io->status;
+        done = io->next;
+        io->req = NULL;
+        io->in_use = 0;
+        dev->inflight--;
+        if (status)
+            dev->stats.errors++;
+        blkdev_complete(req, status);
+        completed++;
+    }
+    return completed;
+}
+
+static int nvme_any_pending(nvme_device_t *dev)
+{
+    for (uint32_t i = 0; i < dev->nio; i++)
+    {
+        if (nvme_cq_pending(&dev->io[i]))
+            return 1;
+    }
+    return 0;
+}
+
+// INTx no dice qué cola avisó: se miran todas
+static void nvme_irq_handler(void)
+{
+    nvme_device_t *dev = nvme_dev;
+    if (!dev || !dev->irq_on || !nvme_any_pending(dev))
+        return;
+    dev->stats.interrupts++;
+    nvme_retire(dev, NULL);
+}
+
+// MSI-X: el vector ya dice qué cola terminó y la línea no se comparte
+static void nvme_queue_irq_handler(void *arg)
+{
+    nvme_device_t *dev = nvme_dev;
+    nvme_queue_t *q = (nvme_queue_t *)arg;
+    if (!dev || !dev->irq_on)
+        return;
+    dev->stats.interrupts++;
+    q->interrupts++;
+    nvme_retire(dev, q);
+}
+
+// Con interrupción duerme hasta la siguiente; sin ella, sondea las colas
+static void nvme_blk_wait(blkdev_t *bdev)
+{
+    nvme_device_t *dev = (nvme_device_t *)bdev->priv;
+    uint32_t flags = irq_save();
+    if (dev->irq_on && (flags & CPU_EFLAGS_IF) && dev->inflight && !nvme_any_pending(dev))
+    {
+        __asm__ volatile("sti; hlt" ::: "memory");
+        return;
+    }
+    uint32_t n = nvme_retire(dev, NULL);
+    irq_restore(flags);
+    if (!n)
+        cpu_relax();
+}
+
+static const blkdev_ops_t nvme_blk_ops = {nvme_blk_submit, nvme_blk_wait, nvme_blk_commit};
+
+// --- Inicialización ---
+// Espera a que CSTS.RDY valga ready; CAP.TO da el plazo en unidades de 500 ms
+static int nvme_wait_ready(nvme_device_t *dev, uint32_t ready)
+{
+    uint64_t limit = (uint64_t)(NVME_CAP_TO(dev->regs->cap) + 1) * 50;
+    uint64_t start = timer_ticks();
+    while (((dev->regs->csts & NVME_CSTS_RDY) != 0) != ready)
+    {
+        if ((dev->regs->csts & NVME_CSTS_CFS) || timer_ticks() - start >= limit)
+            return -1;
+        cpu_relax();
+    }
+    return 0;
+}
+
+// Deshabilita el controlador, le da la cola de administración y lo arranca
+static int nvme_enable(nvme_device_t *dev)
+{
+    nvme_regs_t *r = dev->regs;
+    if (r->cc & NVME_CC_EN)
+    {
+        r->cc &= ~NVME_CC_EN;
+        if (nvme_wait_ready(dev, 0) != 0)
+            return -1;
+    }
+
+    nvme_queue_setup(dev, &dev->admin, 0, nvme_admin_sq, nvme_admin_cq, NVME_ADMIN_DEPTH);
+    r->aqa = ((uint32_t)(NVME_ADMIN_DEPTH - 1) << 16) | (NVME_ADMIN_DEPTH - 1);
+    r->asq = nvme_phys(nvme_admin_sq);
+    r->acq = nvme_phys(nvme_admin_cq);
+
+    // Juego de comandos NVM, páginas de 4 KB, arbitraje round robin
+    r->cc = NVME_CC_EN | NVME_CC_IOSQES | NVME_CC_IOCQES;
+    return nvme_wait_ready(dev, 1);
+}
+
+// Capacidad y tamaño de transferencia. La capa trabaja con sectores de
+// 512 bytes: otros formatos de LBA no se admiten.
+static int nvme_identify_all(nvme_device_t *dev)
+{
+    if (nvme_identify(dev, NVME_IDENTIFY_CTRL, 0) != 0)
+        return -1;
+    uint8_t mdts = nvme_identify_buf[77];
+    uint32_t nn = *(uint32_t *)&nvme_identify_buf[516];
+
+    // MDTS en potencias de 2 de la página mínima (4 KB); 0 = sin límite
+    dev->max_sectors = NVME_MAX_CMD_SECTORS;
+    if (mdts && mdts < 20)
+        dev->max_sectors = MIN(dev->max_sectors, (uint32_t)(NVME_PAGE_SIZE / BLK_SECTOR_SIZE) << mdts);
+
+    dev->nsid = 1;
+    if (nn < 1 || nvme_identify(dev, NVME_IDENTIFY_NS, dev->nsid) != 0)
+        return -1;
+    dev->sectors = *(uint64_t *)&nvme_identify_buf[0];
+    uint32_t format = nvme_identify_buf[26] & 0xF;
+    uint32_t lbads = nvme_identify_buf[128 + 4 * format + 2];
+    if (lbads != 9)
+    {
+        printf("NVMe: sectores de %u bytes no soportados\n", 1u << lbads);
+        return -1;
+    }
+    return dev->sectors ? 0 : -1;
+}
+
+// La entrada 0 de la tabla es la de la cola de administración, que se
+// sondea y queda enmascarada; la cola de E/S i avisa por la entrada i + 1
+static int nvme_setup_msix(nvme_device_t *dev, pci_device_t *pci, uint32_t n)
+{
+    if (pci_msix_count(pci) <= n)
+        return -1;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        int v = irq_alloc_vector(nvme_queue_irq_handler, &dev->io[i]);
+        if (v < 0 || pci_msix_set(pci, i + 1, (uint8_t)v) != 0)
+        {
+            if (v >= 0)
+                irq_free_vector((uint8_t)v);
+            while (i--)
+                irq_free_vector(dev->vectors[i]);
+            pci_disable_msi(pci);
+            return -1;
+        }
+        dev->vectors[i] = (uint8_t)v;
+    }
+    dev->msix = 1;
+    return 0;
+}
+
+static int nvme_setup_io_queues(nvme_device_t *dev, pci_device_t *pci, uint16_t depth)
+{
+    // Pedir NVME_MAX_IO_QUEUES parejas; el controlador dice cuántas da
+    nvme_cmd_t cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.opcode = NVME_ADMIN_SET_FEATURES;
+    cmd.cdw10 = NVME_FEAT_NUM_QUEUES;
+    cmd.cdw11 = (NVME_MAX_IO_QUEUES - 1) | ((uint32_t)(NVME_MAX_IO_QUEUES - 1) << 16);
+    uint32_t granted;
+    if (nvme_admin(dev, &cmd, &granted) != 0)
+        return -1;
+    uint32_t n = MIN((granted & 0xFFFF) + 1, (granted >> 16) + 1);
+    n = MIN(n, NVME_MAX_IO_QUEUES);
+
+    nvme_setup_msix(dev, pci, n);
+    int irq = dev->msix || dev->irq < 16;
+    for (dev->nio = 0; dev->nio < n; dev->nio++)
+    {
+        nvme_queue_t *q = &dev->io[dev->nio];
+        nvme_queue_setup(dev, q, (uint16_t)(dev->nio + 1), nvme_io_sq[dev->nio],
+                         nvme_io_cq[dev->nio], depth);
+        if (nvme_create_io_queue(dev, q, irq, dev->msix ? (uint16_t)(dev->nio + 1) : 0) != 0)
+            break;
+    }
+    return dev->nio ? 0 : -1;
+}
+
+static void nvme_blk_register(nvme_device_t *dev)
+{
+    strncpy(nvme_blkdev.name, "nvme0", BLK_NAME_LEN);
+    nvme_blkdev.sectors = dev->sectors;
+    nvme_blkdev.max_sectors = dev->max_sectors;
+    nvme_blkdev.max_iov = BLK_MAX_IOV;
+    nvme_blkdev.max_inflight = NVME_MAX_INFLIGHT;
+    nvme_blkdev.align = 4; // Las entradas PRP exigen direcciones múltiplo de 4
+    nvme_blkdev.ops = &nvme_blk_ops;
+    nvme_blkdev.priv = dev;
+    blkdev_register(&nvme_blkdev);
+}
+
+// Un solo controlador: el driver no acepta un segundo
+static int nvme_probe(pci_device_t *pci, const pci_id_t *id)
+{
+    (void)id;
+    nvme_device_t *d = &nvme_dev_instance;
+    if (nvme_dev)
+        return -1;
+
+    pci_enable_device(pci, PCI_COMMAND_MEMORY | PCI_COMMAND_MASTER);
+
+    memset(d, 0, sizeof(*d));
+    d->bar0 = pci_get_bar(pci->bus, pci->slot, pci->func, 0);
+    d->regs = d->bar0 ? (nvme_regs_t *)paging_map_mmio(d->bar0, sizeof(nvme_regs_t)) : NULL;
+    if (!d->regs)
+    {
+        printf("NVMe: BAR0 no utilizable\n");
+        return -1;
+    }
+    d->irq = pci->irq_line;
+
+    // Los timbres van detrás de los registros, separados según CAP.DSTRD
+    uint64_t cap = d->regs->cap;
+    d->dstrd = 4u << NVME_CAP_DSTRD(cap);
+    if (!paging_map_mmio(d->bar0 + NVME_DOORBELL_BASE, 2 * (NVME_MAX_IO_QUEUES + 1) * d->dstrd))
+    {
+        printf("NVMe: BAR0 no utilizable\n");
+        return -1;
+    }
+    if (NVME_CAP_MPSMIN(cap) != 0)
+    {
+        printf("NVMe: el controlador no admite paginas de 4 KB\n");
+        return -1;
+    }
+    uint16_t depth = (uint16_t)MIN(NVME_IO_DEPTH, NVME_CAP_MQES(cap));
+
+    if (nvme_enable(d) != 0 || nvme_identify_all(d) != 0 || nvme_setup_io_queues(d, pci, depth) != 0)
+    {
+        printf("NVMe: el controlador no responde\n");
+        return -1;
+    }
+
+    nvme_dev = d;
+    if (d->msix)
+        d->irq_on = 1;
+    else if (d->irq < 16 && irq_register(d->irq, nvme_irq_handler) == 0)
+        d->irq_on = 1;
+    else
+        d->regs->intms = 1; // Sin manejador la línea no debe quedar levantada
+    nvme_blk_register(d);
+
+    printf("NVMe inicializado: BAR0=0x%x, %u MB, %u colas de E/S de %u, %u KB por comando, %s\n",
+           (uint32_t)d->bar0, (uint32_t)(d->sectors >> 11), d->nio, depth,
+           d->max_sectors / 2, d->msix ? "MSI-X" : d->irq_on ? "IRQ" : "sondeo");
+    return 0;
+}
+
+static const pci_id_t nvme_ids[] = {
+    {PCI_ANY_ID, PCI_ANY_ID, PCI_CLASS(0x01, 0x08, 0x02), 0xFFFFFF},
+    {0, 0, 0, 0},
+};
+
+static const pci_driver_t nvme_driver = {"nvme", nvme_ids, nvme_probe};
+
+int nvme_init(void)
+{
+    if (pci_register_driver(&nvme_driver) > 0)
+        return 0;
+    printf("NVMe no encontrado\n");
+    return -1;
+}
+
+// --- Medidas ---
+void nvme_get_stats(nvme_stats_t *out)
+{
+    if (out)
+        *out = nvme_dev_instance.stats;
+}
+
+void nvme_print_stats(void)
+{
+    nvme_device_t *dev = nvme_dev;
+    if (!dev)
+        return;
+    nvme_stats_t *s = &dev->stats;
+    printf("NVMe: %u comandos (%u peticiones partidas, %u con lista PRP), %u errores\n",
+           s->commands, s->split, s->prp_lists, s->errors);
+    printf("NVMe: %u timbres de envio, %u finalizaciones en %u timbres, %u interrupciones\n",
+           s->sq_doorbells, s->completions, s->cq_doorbells, s->interrupts);
+    for (uint32_t i = 0; dev->msix && i < dev->nio; i++)
+        printf("NVMe: cola %u: vector %u, %u interrupciones\n", dev->io[i].qid, dev->vectors[i],
+               dev->io[i].interrupts);
+}
@@ -0,0 +1,45 @@
+#include "blkdev.h"
+#include "fs.h"
+#include "io.h"
+#include "string.h"
+
+// Disco en RAM sobre fs_storage, para arrancar sin disco SATA
+extern uint8_t fs_storage[];
+
+static blkdev_t ramdisk_dev;
+
+static int ramdisk_submit(blkdev_t *dev, blk_request_t *req)
+{
+    (void)dev;
+    uint8_t *p = fs_storage + (uint32_t)req->lba * BLK_SECTOR_SIZE;
+
+    // Marca en el puerto E9 para seguir los accesos desde QEMU
+    outb(0xE9, req->write ? 0x57 : 0x52);
+    for (uint32_t i = 0; i < req->iovcnt; i++)
+    {
+        if (req->write)
+            memcpy(p, req->iov[i].buf, req->iov[i].bytes);
+        else
+            memcpy(req->iov[i].buf, p, req->iov[i].bytes);
+        p += req->iov[i].bytes;
+    }
+    blkdev_complete(req, 0);
+    return 0;
+}
+
+static const blkdev_ops_t ramdisk_ops = {ramdisk_submit, NULL, NULL};
+
+int ramdisk_init(void)
+{
+    if (ramdisk_dev.ops)
+        return 0;
+
+    strncpy(ramdisk_dev.name, "ram0", BLK_NAME_LEN);
+    ramdisk_dev.sectors = FS_STORAGE_SIZE / BLK_SECTOR_SIZE;
+    ramdisk_dev.max_sectors = FS_STORAGE_SIZE / BLK_SECTOR_SIZE;
+    ramdisk_dev.max_iov = BLK_MAX_IOV;
+    ramdisk_dev.max_inflight = 1;
+    ramdisk_dev.align = 1;
+    ramdisk_dev.ops = &ramdisk_ops;
+    return blkdev_register(&ramdisk_dev);
+}
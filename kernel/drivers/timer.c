@@ -1,18 +1,87 @@
 #include <stdint.h>
+#include <stddef.h>
 #include "idt.h"
 #include "log.h"
+#include "io.h"
+#include "cpu.h"
+#include "div64.h"
+#include "timer.h"
 
 static volatile uint64_t ticks = 0;
-static inline void outb(uint16_t p, uint8_t v){ __asm__ volatile("outb %0,%1"::"a"(v),"Nd"(p)); }
+static uint32_t tsc_khz;
+static uint16_t pit_divisor;
 
-void pit_irq_handler(void) { ticks++; }
+static void pit_irq_handler(void) { ticks++; }
 
 void pit_init(uint32_t hz){
     uint32_t divisor = 1193180 / hz;
+    pit_divisor = (uint16_t)divisor;
     outb(0x43, 0x36);
     outb(0x40, (uint8_t)(divisor & 0xFF));
     outb(0x40, (uint8_t)((divisor>>8)&0xFF));
+    irq_register(0, pit_irq_handler);
     KLOG_INFO("PIT %u Hz", hz);
 }
 
-uint64_t timer_ticks(void){ return ticks; }
+#ifdef IRQ_BENCH
+// Canal 0 en modo 0: la salida sube (y con ella IRQ0) una sola vez, count
+// pulsos después de escribir el byte alto
+void pit_oneshot(uint16_t count)
+{
+    outb(0x43, 0x30);
+    outb(0x40, count & 0xFF);
+    outb(0x40, count >> 8);
+}
+
+void pit_restart(void)
+{
+    outb(0x43, 0x36);
+    outb(0x40, pit_divisor & 0xFF);
+    outb(0x40, pit_divisor >> 8);
+}
+#endif
+
+// 64 bits no se leen de una vez: que el tick no caiga entre las dos mitades
+uint64_t timer_ticks(void)
+{
+    uint32_t flags = irq_save();
+    uint64_t t = ticks;
+    irq_restore(flags);
+    return t;
+}
+
+// Frecuencia del TSC: ciclos durante 10 ms contados con el canal 2 del PIT
+// en modo 0 (no necesita interrupciones, así sirve antes del sti)
+uint32_t timer_tsc_khz(void)
+{
+    if (tsc_khz)
+        return tsc_khz;
+
+    uint8_t p61 = inb(0x61);
+    outb(0x61, (p61 & ~0x02) | 0x01); // Puerta del canal 2 abierta, altavoz apagado
+    outb(0x43, 0xB0);                 // Canal 2, byte bajo/alto, modo 0
+    uint16_t count = 1193182 / 100;
+    outb(0x42, count & 0xFF);
+    outb(0x42, count >> 8);
+
+    uint64_t t0 = rdtsc();
+    while (!(inb(0x61) & 0x20))
+        ;
+    uint64_t t1 = rdtsc();
+    outb(0x61, p61);
+
+    tsc_khz = (uint32_t)(t1 - t0) / 10;
+    KLOG_INFO("TSC %u kHz", tsc_khz);
+    return tsc_khz;
+}
+
+uint64_t timer_tsc_to_us(uint64_t cycles)
+{
+    uint32_t khz = timer_tsc_khz();
+    return khz ? div64_u32(cycles * 1000, khz, NULL) : 0;
+}
+
+uint64_t timer_now_us(void)
+{
+    return timer_tsc_to_us(rdtsc());
+}
@@ -0,0 +1,147 @@
+#include "virtio.h"
+#include "cpu.h"
+#include "io.h"
+#include "string.h"
+
+// Con el mapa de identidad la dirección de un objeto del kernel es la física
+static inline uint32_t virtq_phys(const void *p)
+{
+    return (uint32_t)p;
+}
+
+// used_event está tras el anillo disponible y avail_event tras el usado
+static inline volatile uint16_t *virtq_used_event(virtqueue_t *vq)
+{
+    return (volatile uint16_t *)&vq->avail->ring[vq->num];
+}
+
+static inline volatile uint16_t *virtq_avail_event(virtqueue_t *vq)
+{
+    return (volatile uint16_t *)&vq->used->ring[vq->num];
+}
+
+int virtq_init(virtqueue_t *vq, uint16_t iobase, uint16_t index, void *mem, uint16_t max,
+               int event_idx)
+{
+    outw(iobase + VIRTIO_PCI_QUEUE_SEL, index);
+    uint16_t num = inw(iobase + VIRTIO_PCI_QUEUE_NUM);
+    // El anillo se indexa con & (num - 1): tiene que ser potencia de 2
+    if (num == 0 || num > max || num > VIRTQ_MAX_SIZE || (num & (num - 1)))
+        return -1;
+
+    memset(vq, 0, sizeof(*vq));
+    memset(mem, 0, VIRTQ_MEM_SIZE(num));
+    vq->iobase = iobase;
+    vq->index = index;
+    vq->num = num;
+    vq->event_idx = event_idx != 0;
+    vq->desc = (vring_desc_t *)mem;
+    vq->avail = (vring_avail_t *)((uint8_t *)mem + 16 * num);
+    vq->used = (vring_used_t *)((uint8_t *)mem + VIRTQ_ROUND(16 * num + 2 * (3 + num)));
+
+    // Todos los descriptores libres, encadenados por next
+    for (uint16_t i = 0; i + 1 < num; i++)
+        vq->desc[i].next = i + 1;
+    vq->free_head = 0;
+    vq->nfree = num;
+
+    outl(iobase + VIRTIO_PCI_QUEUE_PFN, virtq_phys(mem) / VIRTQ_ALIGN);
+    return 0;
+}
+
+int virtq_add(virtqueue_t *vq, const virtq_buf_t *bufs, uint32_t n, void *token)
+{
+    if (n == 0 || n > vq->nfree)
+        return -1;
+
+    // La cadena sigue el orden de la lista libre: el next de cada
+    // descriptor ya apunta al siguiente libre
+    uint16_t head = vq->free_head;
+    uint16_t idx = head;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        vring_desc_t *d = &vq->desc[idx];
+        d->addr = virtq_phys(bufs[i].buf);
+        d->len = bufs[i].len;
+        d->flags = bufs[i].flags | (i + 1 < n ? VRING_DESC_F_NEXT : 0);
+        if (i + 1 < n)
+            idx = d->next;
+    }
+    vq->free_head = vq->desc[idx].next;
+    vq->nfree -= n;
+    vq->token[head] = token;
+
+    // La entrada tiene que estar escrita antes de que idx la haga visible
+    vq->avail->ring[vq->avail->idx & (vq->num - 1)] = head;
+    barrier();
+    vq->avail->idx++;
+    return 0;
+}
+
+void virtq_kick(virtqueue_t *vq)
+{
+    // avail->idx publicado antes de leer lo que pide el dispositivo
+    full_barrier();
+    uint16_t now = vq->avail->idx;
+    uint16_t old = vq->kicked;
+    if (now == old)
+        return;
+    vq->kicked = now;
+
+    int need;
+    if (vq->event_idx)
+    {
+        // Aviso solo si avail_event quedó entre lo ya avisado y lo nuevo
+        uint16_t event = *virtq_avail_event(vq);
+        need = (uint16_t)(now - event - 1) < (uint16_t)(now - old);
+    }
+    else
+        need = !(*(volatile uint16_t *)&vq->used->flags & VRING_USED_F_NO_NOTIFY);
+
+    if (!need)
+    {
+        vq->suppressed++;
+        return;
+    }
+    vq->notifies++;
+    outw(vq->iobase + VIRTIO_PCI_QUEUE_NOTIFY, vq->index);
+}
+
+int virtq_pending(const virtqueue_t *vq)
+{
+    return *(volatile uint16_t *)&vq->used->idx != vq->last_used;
+}
+
+void *virtq_get(virtqueue_t *vq, uint32_t *len)
+{
+    if (!virtq_pending(vq))
+        return NULL;
+    // idx leído antes que la entrada que cubre
+    barrier();
+
+    vring_used_elem_t *e = &vq->used->ring[vq->last_used & (vq->num - 1)];
+    uint16_t head = (uint16_t)e->id;
+    if (len)
+        *len = e->len;
+    vq->last_used++;
+
+    // Devolver la cadena a la lista libre
+    uint16_t idx = head;
+    uint16_t n = 1;
+    while (vq->desc[idx].flags & VRING_DESC_F_NEXT)
+    {
+        idx = vq->desc[idx].next;
+        n++;
+    }
+    vq->desc[idx].next = vq->free_head;
+    vq->free_head = head;
+    vq->nfree += n;
+
+    // Con índice de eventos, interrupción en cuanto termine la siguiente
+    if (vq->event_idx)
+        *virtq_used_event(vq) = vq->last_used;
+
+    void *token = vq->token[head];
+    vq->token[head] = NULL;
+    return token;
+}
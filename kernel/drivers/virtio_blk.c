@@ -0,0 +1,392 @@
+#include "virtio_blk.h"
+#include "blkdev.h"
+#include "pci.h"
+#include "cpu.h"
+#include "idt.h"
+#include "io.h"
+#include "stdio.h"
+#include "string.h"
+#include "sys/types.h"
+
+static virtio_blk_device_t virtio_blk_dev_instance;
+static virtio_blk_device_t *virtio_blk_dev = NULL; // NULL hasta que arranca
+
+// Memoria de la cola, compartida con el dispositivo
+static uint8_t virtio_blk_ring[VIRTQ_MEM_SIZE(VIRTQ_MAX_SIZE)] __attribute__((aligned(VIRTQ_ALIGN)));
+
+// Una petición en vuelo: cabecera, byte de estado y tabla indirecta con
+// cabecera + fragmentos + estado. Con descriptores indirectos cada petición
+// ocupa una sola entrada del anillo, tenga los fragmentos que tenga.
+typedef struct
+{
+    virtio_blk_outhdr_t hdr;
+    vring_desc_t table[BLK_MAX_IOV + 2];
+    blk_request_t *req;
+    volatile uint8_t status;
+    uint8_t in_use;
+} __attribute__((aligned(16))) virtio_blk_slot_t;
+
+static virtio_blk_slot_t virtio_blk_slots[VIRTIO_BLK_SLOTS];
+
+static blkdev_t virtio_blk_blkdev;
+
+// --- Emisión ---
+static virtio_blk_slot_t *virtio_blk_get_slot(void)
+{
+    for (uint32_t i = 0; i < VIRTIO_BLK_SLOTS; i++)
+    {
+        if (!virtio_blk_slots[i].in_use)
+        {
+            virtio_blk_slots[i].in_use = 1;
+            return &virtio_blk_slots[i];
+        }
+    }
+    return NULL;
+}
+
+// Cabecera, fragmentos y estado en bufs; devuelve cuántos son
+static uint32_t virtio_blk_build(virtio_blk_slot_t *slot, const blk_request_t *req,
+                                 virtq_buf_t *bufs)
+{
+    uint16_t data_flags = req->write ? 0 : VRING_DESC_F_WRITE;
+    uint32_t n = 0;
+
+    slot->hdr.type = req->write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+    slot->hdr.reserved = 0;
+    slot->hdr.sector = req->lba;
+    slot->status = 0xFF;
+
+    bufs[n++] = (virtq_buf_t){&slot->hdr, sizeof(slot->hdr), 0};
+    for (uint32_t i = 0; i < req->iovcnt; i++)
+        bufs[n++] = (virtq_buf_t){req->iov[i].buf, req->iov[i].bytes, data_flags};
+    bufs[n++] = (virtq_buf_t){(const void *)&slot->status, 1, VRING_DESC_F_WRITE};
+    return n;
+}
+
+// La tabla indirecta es una cadena de descriptores como la del anillo,
+// pero en memoria de la petición
+static void virtio_blk_fill_table(virtio_blk_slot_t *slot, const virtq_buf_t *bufs, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        vring_desc_t *d = &slot->table[i];
+        d->addr = (uint32_t)bufs[i].buf;
+        d->len = bufs[i].len;
+        d->flags = bufs[i].flags | (i + 1 < n ? VRING_DESC_F_NEXT : 0);
+        d->next = (uint16_t)(i + 1);
+    }
+}
+
+// Lo llama la capa de bloques con las interrupciones deshabilitadas
+static int virtio_blk_submit(blkdev_t *bdev, blk_request_t *req)
+{
+    virtio_blk_device_t *dev = (virtio_blk_device_t *)bdev->priv;
+    if (req->write && (dev->features & VIRTIO_BLK_F_RO))
+    {
+        dev->stats.errors++;
+        blkdev_complete(req, -1);
+        return 0;
+    }
+
+    virtio_blk_slot_t *slot = virtio_blk_get_slot();
+    if (!slot)
+        return -1;
+    slot->req = req;
+
+    virtq_buf_t bufs[BLK_MAX_IOV + 2];
+    uint32_t n = virtio_blk_build(slot, req, bufs);
+    int rc;
+    if (dev->features & VIRTIO_RING_F_INDIRECT_DESC)
+    {
+        virtio_blk_fill_table(slot, bufs, n);
+        virtq_buf_t table = {slot->table, n * sizeof(vring_desc_t), VRING_DESC_F_INDIRECT};
+        rc = virtq_add(&dev->vq, &table, 1, slot);
+        dev->stats.indirect += rc == 0;
+    }
+    else
+        rc = virtq_add(&dev->vq, bufs, n, slot);
+
+    if (rc != 0)
+    {
+        // Sin descriptores libres: la capa la reintenta cuando acabe otra
+        slot->in_use = 0;
+        return -1;
+    }
+
+    dev->inflight++;
+    dev->stats.requests++;
+    return 0;
+}
+
+// Un solo aviso por tanda; con índice de eventos, ni eso si el dispositivo
+// sigue procesando la cola
+static void virtio_blk_commit(blkdev_t *bdev)
+{
+    virtio_blk_device_t *dev = (virtio_blk_device_t *)bdev->priv;
+    virtq_kick(&dev->vq);
+}
+
+// --- Finalización ---
+// Recoge las peticiones terminadas. Con las interrupciones deshabilitadas.
+static uint32_t virtio_blk_retire(virtio_blk_device_t *dev)
+{
+    uint32_t n = 0;
+    virtio_blk_slot_t *slot;
+    while ((slot = (virtio_blk_slot_t *)virtq_get(&dev->vq, NULL)) != NULL)
+    {
+        blk_request_t *req = slot->req;
+        int status = slot->status == VIRTIO_BLK_S_OK ? 0 : -1;
+
+        // Liberar antes del aviso: la capa puede despachar otra dentro
+        slot->req = NULL;
+        slot->in_use = 0;
+        dev->inflight--;
+        if (status)
+            dev->stats.errors++;
+        else
+            dev->stats.sectors += req->count;
+        blkdev_complete(req, status);
+        n++;
+    }
+    return n;
+}
+
+static void virtio_blk_irq_handler(void)
+{
+    virtio_blk_device_t *dev = virtio_blk_dev;
+    if (!dev || !dev->irq_on)
+        return;
+
+    // Leer ISR baja la línea; a 0, la interrupción era de otro dispositivo
+    if (!(inb(dev->iobase + VIRTIO_PCI_ISR) & VIRTIO_ISR_QUEUE))
+        return;
+    dev->stats.interrupts++;
+    virtio_blk_retire(dev);
+}
+
+// MSI-X: el vector es solo de esta cola, no hay ISR que leer
+static void virtio_blk_vq_handler(void *arg)
+{
+    virtio_blk_device_t *dev = (virtio_blk_device_t *)arg;
+    if (!dev->irq_on)
+        return;
+    dev->stats.interrupts++;
+    virtio_blk_retire(dev);
+}
+
+// Con interrupción duerme hasta la siguiente; sin ella, sondea la cola
+static void virtio_blk_wait(blkdev_t *bdev)
+{
+    virtio_blk_device_t *dev = (virtio_blk_device_t *)bdev->priv;
+    uint32_t flags = irq_save();
+    if (dev->irq_on && (flags & CPU_EFLAGS_IF) && dev->inflight && !virtq_pending(&dev->vq))
+    {
+        __asm__ volatile("sti; hlt" ::: "memory");
+        return;
+    }
+    uint32_t n = virtio_blk_retire(dev);
+    irq_restore(flags);
+    if (!n)
+        cpu_relax();
+}
+
+static const blkdev_ops_t virtio_blk_ops = {virtio_blk_submit, virtio_blk_wait, virtio_blk_commit};
+
+// --- Inicialización ---
+static uint32_t virtio_blk_config_32(virtio_blk_device_t *dev, uint32_t offset)
+{
+    return inl(dev->iobase + dev->config + offset);
+}
+
+static void virtio_blk_set_status(virtio_blk_device_t *dev, uint8_t status)
+{
+    outb(dev->iobase + VIRTIO_PCI_STATUS, status);
+}
+
+// Negocia lo que el driver sabe usar. Sin VIRTIO_BLK_F_FLUSH el dispositivo
+// trabaja en escritura inmediata, que es lo que espera el diario.
+static void virtio_blk_negotiate(virtio_blk_device_t *dev)
+{
+    const uint32_t wanted = VIRTIO_BLK_F_SIZE_MAX | VIRTIO_BLK_F_SEG_MAX | VIRTIO_BLK_F_RO |
+                            VIRTIO_BLK_F_BLK_SIZE | VIRTIO_RING_F_INDIRECT_DESC |
+                            VIRTIO_RING_F_EVENT_IDX;
+    dev->features = inl(dev->iobase + VIRTIO_PCI_HOST_FEATURES) & wanted;
+    outl(dev->iobase + VIRTIO_PCI_GUEST_FEATURES, dev->features);
+
+    dev->sectors = (uint64_t)virtio_blk_config_32(dev, VIRTIO_BLK_CFG_CAPACITY) |
+                   ((uint64_t)virtio_blk_config_32(dev, VIRTIO_BLK_CFG_CAPACITY + 4) << 32);
+
+    dev->max_iov = BLK_MAX_IOV;
+    if (dev->features & VIRTIO_BLK_F_SEG_MAX)
+    {
+        uint32_t seg_max = virtio_blk_config_32(dev, VIRTIO_BLK_CFG_SEG_MAX);
+        if (seg_max)
+            dev->max_iov = MIN(dev->max_iov, seg_max);
+    }
+
+    // La capa puede juntar fragmentos contiguos en uno: limitar la petición
+    // entera a size_max asegura que ninguno lo supera
+    dev->max_sectors = VIRTIO_BLK_MAX_SECTORS;
+    if (dev->features & VIRTIO_BLK_F_SIZE_MAX)
+    {
+        uint32_t size_max = virtio_blk_config_32(dev, VIRTIO_BLK_CFG_SIZE_MAX);
+        if (size_max >= BLK_SECTOR_SIZE)
+            dev->max_sectors = MIN(dev->max_sectors, size_max / BLK_SECTOR_SIZE);
+    }
+}
+
+// Entrada 0 de la tabla para la cola; los cambios de configuración no avisan.
+// Después del reset, que devuelve los vectores a VIRTIO_MSI_NO_VECTOR.
+static void virtio_blk_setup_msix(virtio_blk_device_t *dev, pci_device_t *pci)
+{
+    if (pci_msix_count(pci) == 0)
+        return;
+    int v = irq_alloc_vector(virtio_blk_vq_handler, dev);
+    if (v < 0)
+        return;
+    if (pci_msix_set(pci, 0, (uint8_t)v) != 0)
+    {
+        irq_free_vector((uint8_t)v);
+        return;
+    }
+    dev->msix = 1;
+    dev->vector = (uint8_t)v;
+    dev->config = VIRTIO_PCI_CONFIG_MSIX;
+    outw(dev->iobase + VIRTIO_MSI_CONFIG_VECTOR, VIRTIO_MSI_NO_VECTOR);
+}
+
+static void virtio_blk_release_msix(virtio_blk_device_t *dev, pci_device_t *pci)
+{
+    if (!dev->msix)
+        return;
+    pci_disable_msi(pci);
+    irq_free_vector(dev->vector);
+    dev->msix = 0;
+    dev->config = VIRTIO_PCI_CONFIG;
+}
+
+// El dispositivo puede no tener recursos para el vector: lo dice leyendo
+// VIRTIO_MSI_NO_VECTOR, y la cola vuelve a la línea INTx
+static int virtio_blk_bind_queue_vector(virtio_blk_device_t *dev, pci_device_t *pci)
+{
+    outw(dev->iobase + VIRTIO_PCI_QUEUE_SEL, 0);
+    outw(dev->iobase + VIRTIO_MSI_QUEUE_VECTOR, 0);
+    if (inw(dev->iobase + VIRTIO_MSI_QUEUE_VECTOR) == 0)
+        return 0;
+    virtio_blk_release_msix(dev, pci);
+    return -1;
+}
+
+static void virtio_blk_register(virtio_blk_device_t *dev)
+{
+    strncpy(virtio_blk_blkdev.name, "vda", BLK_NAME_LEN);
+    virtio_blk_blkdev.sectors = dev->sectors;
+    virtio_blk_blkdev.max_sectors = dev->max_sectors;
+    virtio_blk_blkdev.max_iov = dev->max_iov;
+    virtio_blk_blkdev.max_inflight = MIN(VIRTIO_BLK_SLOTS, dev->vq.num);
+    virtio_blk_blkdev.align = 1; // Los descriptores admiten cualquier dirección
+    virtio_blk_blkdev.ops = &virtio_blk_ops;
+    virtio_blk_blkdev.priv = dev;
+    blkdev_register(&virtio_blk_blkdev);
+}
+
+// Un solo disco: el driver no acepta un segundo dispositivo
+static int virtio_blk_probe(pci_device_t *pci, const pci_id_t *id)
+{
+    (void)id;
+    virtio_blk_device_t *d = &virtio_blk_dev_instance;
+    if (virtio_blk_dev)
+        return -1;
+
+    // El transporte legacy está en el espacio de E/S de BAR0
+    uint32_t bar0 = pci_read_config_32(pci->bus, pci->slot, pci->func, 0x10);
+    if (!(bar0 & 1))
+    {
+        printf("virtio-blk: BAR0 no es de E/S (dispositivo solo moderno)\n");
+        return -1;
+    }
+
+    pci_enable_device(pci, PCI_COMMAND_IO | PCI_COMMAND_MASTER);
+
+    memset(d, 0, sizeof(*d));
+    d->iobase = (uint16_t)pci_get_bar(pci->bus, pci->slot, pci->func, 0);
+    d->irq = pci->irq_line;
+    d->config = VIRTIO_PCI_CONFIG;
+
+    // Reset y secuencia de arranque de la especificación
+    virtio_blk_set_status(d, 0);
+    virtio_blk_setup_msix(d, pci);
+    virtio_blk_set_status(d, VIRTIO_STATUS_ACKNOWLEDGE);
+    virtio_blk_set_status(d, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+    virtio_blk_negotiate(d);
+
+    if (d->sectors == 0 ||
+        virtq_init(&d->vq, d->iobase, 0, virtio_blk_ring, VIRTQ_MAX_SIZE,
+                   d->features & VIRTIO_RING_F_EVENT_IDX) != 0)
+    {
+        printf("virtio-blk: cola no utilizable\n");
+        virtio_blk_set_status(d, VIRTIO_STATUS_FAILED);
+        virtio_blk_release_msix(d, pci);
+        return -1;
+    }
+
+    // Sin indirectos cada petición ocupa su cadena entera en el anillo
+    if (!(d->features & VIRTIO_RING_F_INDIRECT_DESC))
+        d->max_iov = MIN(d->max_iov, (uint32_t)d->vq.num - 2);
+
+    virtio_blk_dev = d;
+    if (d->msix && virtio_blk_bind_queue_vector(d, pci) == 0)
+        d->irq_on = 1;
+    else if (d->irq < 16 && irq_register(d->irq, virtio_blk_irq_handler) == 0)
+        d->irq_on = 1;
+    else
+        d->vq.avail->flags = VRING_AVAIL_F_NO_INTERRUPT; // Se sondea
+
+    virtio_blk_set_status(d, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER |
+                                 VIRTIO_STATUS_DRIVER_OK);
+    virtio_blk_register(d);
+
+    printf("virtio-blk inicializado: E/S=0x%x, %u MB, cola %u, %u fragmentos, %s%s, %s\n",
+           d->iobase, (uint32_t)(d->sectors >> 11), d->vq.num, d->max_iov,
+           d->features & VIRTIO_RING_F_INDIRECT_DESC ? "indirectos" : "directos",
+           d->features & VIRTIO_RING_F_EVENT_IDX ? " + indice de eventos" : "",
+           d->msix ? "MSI-X" : d->irq_on ? "IRQ" : "sondeo");
+    return 0;
+}
+
+static const pci_id_t virtio_blk_ids[] = {
+    {VIRTIO_PCI_VENDOR, VIRTIO_BLK_PCI_DEVICE, 0, 0},
+    {0, 0, 0, 0},
+};
+
+static const pci_driver_t virtio_blk_driver = {"virtio-blk", virtio_blk_ids, virtio_blk_probe};
+
+int virtio_blk_init(void)
+{
+    if (pci_register_driver(&virtio_blk_driver) > 0)
+        return 0;
+    printf("virtio-blk no encontrado\n");
+    return -1;
+}
+
+// --- Medidas ---
+void virtio_blk_get_stats(virtio_blk_stats_t *out)
+{
+    if (!out)
+        return;
+    *out = virtio_blk_dev_instance.stats;
+    out->notifies = virtio_blk_dev_instance.vq.notifies;
+    out->suppressed = virtio_blk_dev_instance.vq.suppressed;
+}
+
+void virtio_blk_print_stats(void)
+{
+    if (!virtio_blk_dev)
+        return;
+    virtio_blk_stats_t s;
+    virtio_blk_get_stats(&s);
+    printf("virtio-blk: %u peticiones (%u indirectas), %u sectores, %u errores\n",
+           s.requests, s.indirect, s.sectors, s.errors);
+    printf("virtio-blk: %u avisos al dispositivo, %u ahorrados, %u interrupciones\n",
+           s.notifies, s.suppressed, s.interrupts);
+}
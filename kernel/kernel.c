@@ -1,4 +1,5 @@
 #include "log.h"
+#include "file.h"
 
 void kernel_main(void)
 {
@@ -16,6 +17,8 @@ void kernel_main(void)
         static uint64_t last = 0;
         extern uint64_t timer_ticks(void);
         uint64_t t = timer_ticks();
+        // Vaciar escrituras diferidas que llevan demasiado tiempo en memoria
+        file_flush_expired(t);
         if (t - last >= 100)
         {
             last = t;
@@ -0,0 +1,64 @@
+// kernel/lib/arena.c
+#include "arena.h"
+#include "stdio.h"
+#include "string.h"
+
+void arena_init(arena_t *a, const char *name, void *mem, uint32_t size)
+{
+    memset(a, 0, sizeof(*a));
+    a->name = name;
+    a->base = (uint8_t *)mem;
+    a->size = mem ? size & ~(ARENA_ALIGN - 1) : 0;
+}
+
+arena_scope_t arena_begin(arena_t *a)
+{
+    arena_scope_t scope = {a, a ? a->top : 0};
+    if (a && ++a->depth > a->max_depth)
+        a->max_depth = a->depth;
+    return scope;
+}
+
+void arena_end(arena_scope_t scope)
+{
+    arena_t *a = scope.arena;
+    if (!a || !a->depth)
+        return;
+    if (scope.mark < a->top)
+        a->top = scope.mark;
+    a->depth--;
+    a->scopes++;
+}
+
+void *arena_alloc(arena_t *a, uint32_t size)
+{
+    if (!a)
+        return NULL;
+    // El tamaño del arena y top son múltiplos de la alineación: si size
+    // cabe, también cabe redondeado
+    if (size > a->size - a->top)
+    {
+        a->failed++;
+        return NULL;
+    }
+    void *p = a->base + a->top;
+    a->top += (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    if (a->top > a->high)
+        a->high = a->top;
+    a->allocs++;
+    return p;
+}
+
+void *arena_zalloc(arena_t *a, uint32_t size)
+{
+    void *p = arena_alloc(a, size);
+    if (p)
+        memset(p, 0, size);
+    return p;
+}
+
+void arena_print_stats(const arena_t *a)
+{
+    printf("arena %s: %u de %u bytes, maximo %u, %u reservas, %u fallos, %u ambitos (hasta %u anidados)\n",
+           a->name, a->top, a->size, a->high, a->allocs, a->failed, a->scopes, a->max_depth);
+}
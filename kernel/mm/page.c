@@ -0,0 +1,569 @@
+// kernel/mm/page.c
+#include "page.h"
+#include "e820.h"
+#include "cpu.h"
+#include "stdio.h"
+#include "string.h"
+#include "sys/types.h"
+
+// Fin de la imagen del kernel con su .bss (kernel/kernel.ld)
+extern char __kernel_end[];
+
+#define PAGE_LOW_LIMIT 0x100000          // Por debajo: BIOS, VGA y el propio kernel
+#define PAGE_MAX_PFN (0x100000000ull >> PAGE_SHIFT) // Sin PAE, hasta 4 GB
+
+static page_t *page_map;   // Un page_t por marco, desde la dirección 0
+static uint32_t page_npages;
+static page_t *page_free_lists[PAGE_MAX_ORDER + 1];
+static page_stats_t page_stats;
+
+// Los bloques guardados siguen reservados para el buddy (PAGE_HEAD |
+// PAGE_CACHED): no se unen con su compañero hasta que vuelven en un lote
+typedef struct
+{
+    uint32_t count;
+    uint32_t allocs; // Servidos por este almacén, en líneas de su CPU
+    uint32_t frees;
+    void *blocks[PAGE_MAG_SIZE];
+} page_mag_t;
+
+static page_mag_t page_mags[CPU_MAX][PAGE_MAG_ORDERS];
+
+static inline uint32_t page_pfn(const page_t *p)
+{
+    return (uint32_t)(p - page_map);
+}
+
+static inline void *page_addr(uint32_t pfn)
+{
+    return (void *)(pfn << PAGE_SHIFT);
+}
+
+// --- Listas libres ---
+static void page_list_push(page_t *p, uint32_t order)
+{
+    p->flags = PAGE_FREE;
+    p->order = (uint8_t)order;
+    p->prev = NULL;
+    p->next = page_free_lists[order];
+    if (p->next)
+        p->next->prev = p;
+    page_free_lists[order] = p;
+}
+
+static void page_list_remove(page_t *p, uint32_t order)
+{
+    if (p->prev)
+        p->prev->next = p->next;
+    else
+        page_free_lists[order] = p->next;
+    if (p->next)
+        p->next->prev = p->prev;
+    p->next = p->prev = NULL;
+    p->flags = 0;
+}
+
+// Devuelve un bloque uniéndolo con su compañero mientras esté libre y
+// tenga el mismo orden. Con las interrupciones deshabilitadas.
+static void page_free_block(uint32_t pfn, uint32_t order)
+{
+    page_map[pfn].flags = 0;
+    while (order < PAGE_MAX_ORDER)
+    {
+        uint32_t buddy = pfn ^ (1u << order);
+        if (buddy >= page_npages)
+            break;
+        page_t *b = &page_map[buddy];
+        if (b->flags != PAGE_FREE || b->order != order)
+            break;
+        page_list_remove(b, order);
+        pfn &= ~(1u << order);
+        order++;
+        page_stats.merges++;
+    }
+    page_list_push(&page_map[pfn], order);
+}
+
+// [pfn, end) en los bloques alineados más grandes posibles
+static void page_free_range(uint32_t pfn, uint32_t end)
+{
+    while (pfn < end)
+    {
+        uint32_t order = 0;
+        while (order < PAGE_MAX_ORDER && !(pfn & (1u << order)) && pfn + (2u << order) <= end)
+            order++;
+        page_free_block(pfn, order);
+        pfn += 1u << order;
+    }
+}
+
+// Saca un bloque de orden order, partiendo uno mayor si hace falta; las
+// mitades altas vuelven a las listas
+static page_t *page_take(uint32_t order)
+{
+    uint32_t o = order;
+    while (o <= PAGE_MAX_ORDER && !page_free_lists[o])
+        o++;
+    if (o > PAGE_MAX_ORDER)
+        return NULL;
+
+    page_t *p = page_free_lists[o];
+    page_list_remove(p, o);
+    while (o > order)
+    {
+        o--;
+        page_list_push(p + (1u << o), o);
+        page_stats.splits++;
+    }
+    p->order = (uint8_t)order;
+    page_stats.free_pages -= 1u << order;
+    return p;
+}
+
+// --- Inicialización ---
+// Regiones de RAM del mapa, recortadas a [low, 4 GB) y a páginas enteras
+static uint32_t page_region(const e820_entry_t *e, uint32_t low, uint32_t *start, uint32_t *end)
+{
+    if (e->type != E820_RAM || !(e->acpi & 1))
+        return 0;
+    uint64_t lo = (e->base + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    uint64_t hi = (e->base + e->length) >> PAGE_SHIFT;
+    if (lo < low)
+        lo = low;
+    if (hi > PAGE_MAX_PFN)
+        hi = PAGE_MAX_PFN;
+    if (lo >= hi)
+        return 0;
+    *start = (uint32_t)lo;
+    *end = (uint32_t)hi;
+    return 1;
+}
+
+int page_init(void)
+{
+    const e820_map_t *map = e820_map();
+    e820_entry_t fallback = {PAGE_LOW_LIMIT, PAGE_FALLBACK_END - PAGE_LOW_LIMIT, E820_RAM, 1};
+    const e820_entry_t *entries = map->entries;
+    uint32_t count = map->count;
+    if (count == 0 || count > E820_MAX_ENTRIES)
+    {
+        printf("Memoria: sin mapa E820, se suponen %u MB\n", PAGE_FALLBACK_END >> 20);
+        entries = &fallback;
+        count = 1;
+    }
+
+    uint32_t kend = ((uint32_t)__kernel_end + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    uint32_t low = kend > (PAGE_LOW_LIMIT >> PAGE_SHIFT) ? kend : (PAGE_LOW_LIMIT >> PAGE_SHIFT);
+
+    // La tabla cubre hasta el último marco de RAM
+    uint32_t start, end;
+    page_npages = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (page_region(&entries[i], low, &start, &end) && end > page_npages)
+            page_npages = end;
+    }
+    if (!page_npages)
+    {
+        printf("Memoria: no hay RAM utilizable por encima del kernel\n");
+        return -1;
+    }
+
+    // Y se guarda al principio de la primera región donde cabe
+    uint32_t map_pages = (page_npages * sizeof(page_t) + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    uint32_t map_pfn = 0;
+    for (uint32_t i = 0; i < count && !map_pfn; i++)
+    {
+        if (page_region(&entries[i], low, &start, &end) && end - start > map_pages)
+            map_pfn = start;
+    }
+    if (!map_pfn)
+    {
+        printf("Memoria: no cabe la tabla de marcos\n");
+        return -1;
+    }
+    page_map = (page_t *)page_addr(map_pfn);
+    memset(page_map, 0, page_npages * sizeof(page_t));
+    for (uint32_t pfn = 0; pfn < page_npages; pfn++)
+        page_map[pfn].flags = PAGE_RESERVED;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (!page_region(&entries[i], low, &start, &end))
+            continue;
+        if (start == map_pfn)
+            start += map_pages;
+        for (uint32_t pfn = start; pfn < end; pfn++)
+            page_map[pfn].flags = 0;
+        page_free_range(start, end);
+        page_stats.total_pages += end - start;
+    }
+    page_stats.free_pages = page_stats.total_pages;
+    page_stats.merges = 0;
+
+    printf("Memoria: %u entradas E820, %u MB libres desde 0x%x, tabla de marcos de %u KB\n",
+           count, page_stats.total_pages >> (20 - PAGE_SHIFT), low << PAGE_SHIFT,
+           map_pages * (PAGE_SIZE / 1024));
+    return 0;
+}
+
+// --- Listas del buddy ---
+// Con las interrupciones deshabilitadas. Con más CPUs aquí iría el cerrojo
+// global, que los almacenes solo toman para rellenar o vaciar por lotes.
+static void *page_get(uint32_t order)
+{
+    page_t *p = page_take(order);
+    if (!p)
+        return NULL;
+    p->flags = PAGE_HEAD;
+    return page_addr(page_pfn(p));
+}
+
+static void page_put(uint32_t pfn)
+{
+    uint32_t order = page_map[pfn].order;
+    page_free_block(pfn, order);
+    page_stats.free_pages += 1u << order;
+}
+
+// --- Almacenes por CPU ---
+static void page_mag_refill(page_mag_t *m, uint32_t order)
+{
+    while (m->count < PAGE_MAG_BATCH)
+    {
+        void *p = page_get(order);
+        if (!p)
+            break;
+        page_map[(uint32_t)p >> PAGE_SHIFT].flags = PAGE_HEAD | PAGE_CACHED;
+        m->blocks[m->count++] = p;
+    }
+    page_stats.refills++;
+}
+
+// Los más antiguos, del fondo de la pila: los de arriba están calientes en
+// la caché de esta CPU
+static void page_mag_drain(page_mag_t *m, uint32_t n)
+{
+    if (n > m->count)
+        n = m->count;
+    for (uint32_t i = 0; i < n; i++)
+        page_put((uint32_t)m->blocks[i] >> PAGE_SHIFT);
+    m->count -= n;
+    memmove(m->blocks, m->blocks + n, m->count * sizeof(m->blocks[0]));
+    page_stats.drains++;
+}
+
+static void page_drain_cpu(uint32_t cpu)
+{
+    for (uint32_t o = 0; o < PAGE_MAG_ORDERS; o++)
+    {
+        if (page_mags[cpu][o].count)
+            page_mag_drain(&page_mags[cpu][o], PAGE_MAG_SIZE);
+    }
+}
+
+void page_drain(void)
+{
+    uint32_t flags = irq_save();
+    page_drain_cpu(cpu_id());
+    irq_restore(flags);
+}
+
+static void *page_alloc_local(uint32_t order)
+{
+    if (order >= PAGE_MAG_ORDERS)
+    {
+        void *p = page_get(order);
+        if (p)
+            page_stats.allocs++;
+        return p;
+    }
+    page_mag_t *m = &page_mags[cpu_id()][order];
+    if (!m->count)
+        page_mag_refill(m, order);
+    if (!m->count)
+        return NULL;
+    void *p = m->blocks[--m->count];
+    page_map[(uint32_t)p >> PAGE_SHIFT].flags = PAGE_HEAD;
+    m->allocs++;
+    return p;
+}
+
+// --- Reservar y liberar ---
+void *page_alloc(uint32_t order)
+{
+    if (order > PAGE_MAX_ORDER || !page_map)
+        return NULL;
+    uint32_t flags = irq_save();
+    void *p = page_alloc_local(order);
+    if (!p)
+    {
+        // Lo que falta puede estar partido en los almacenes: vuelven al
+        // buddy, se unen y se prueba otra vez
+        page_drain_cpu(cpu_id());
+        p = page_alloc_local(order);
+    }
+    if (!p)
+        page_stats.failed++;
+    irq_restore(flags);
+    return p;
+}
+
+void page_free(void *addr)
+{
+    uint32_t pfn = (uint32_t)addr >> PAGE_SHIFT;
+    if (!addr || ((uint32_t)addr & (PAGE_SIZE - 1)) || pfn >= page_npages ||
+        page_map[pfn].flags != PAGE_HEAD)
+    {
+        printf("page_free: 0x%x no es un bloque reservado\n", (uint32_t)addr);
+        return;
+    }
+    uint32_t flags = irq_save();
+    uint32_t order = page_map[pfn].order;
+    if (order < PAGE_MAG_ORDERS)
+    {
+        page_mag_t *m = &page_mags[cpu_id()][order];
+        if (m->count == PAGE_MAG_SIZE)
+            page_mag_drain(m, PAGE_MAG_BATCH);
+        page_map[pfn].flags = PAGE_HEAD | PAGE_CACHED;
+        m->blocks[m->count++] = addr;
+        m->frees++;
+    }
+    else
+    {
+        page_put(pfn);
+        page_stats.frees++;
+    }
+    irq_restore(flags);
+}
+
+static page_t *page_take_contig(uint32_t count, uint32_t order)
+{
+    page_t *p = page_take(order);
+    if (!p)
+        return NULL;
+    // La cola vuelve a las listas; la ejecución no es un bloque y solo se
+    // libera con page_free_contig, que comprueba la marca y la longitud
+    uint32_t pfn = page_pfn(p);
+    p->flags = PAGE_CONTIG;
+    p->run = (uint16_t)count;
+    page_free_range(pfn + count, pfn + (1u << order));
+    page_stats.free_pages += (1u << order) - count;
+    return p;
+}
+
+void *page_alloc_contig(uint32_t count)
+{
+    uint32_t order = 0;
+    while ((1u << order) < count)
+        order++;
+    if (count == 0 || order > PAGE_MAX_ORDER || !page_map)
+        return NULL;
+
+    uint32_t flags = irq_save();
+    page_t *p = page_take_contig(count, order);
+    if (!p)
+    {
+        // Como en page_alloc: los almacenes pueden tener el hueco partido
+        page_drain_cpu(cpu_id());
+        p = page_take_contig(count, order);
+    }
+    if (p)
+        page_stats.allocs++;
+    else
+        page_stats.failed++;
+    irq_restore(flags);
+    return p ? page_addr(page_pfn(p)) : NULL;
+}
+
+void page_free_contig(void *addr, uint32_t count)
+{
+    uint32_t pfn = (uint32_t)addr >> PAGE_SHIFT;
+    if (!addr || ((uint32_t)addr & (PAGE_SIZE - 1)) || pfn + count > page_npages ||
+        page_map[pfn].flags != PAGE_CONTIG || page_map[pfn].run != count)
+    {
+        printf("page_free_contig: 0x%x no es una ejecución de %u páginas\n", (uint32_t)addr, count);
+        return;
+    }
+    uint32_t flags = irq_save();
+    page_map[pfn].run = 0;
+    page_free_range(pfn, pfn + count);
+    page_stats.free_pages += count;
+    page_stats.frees++;
+    irq_restore(flags);
+}
+
+page_t *page_lookup(const void *addr)
+{
+    uint32_t pfn = (uint32_t)addr >> PAGE_SHIFT;
+    return page_map && pfn < page_npages ? &page_map[pfn] : NULL;
+}
+
+// --- Medidas ---
+void page_get_stats(page_stats_t *out)
+{
+    if (!out)
+        return;
+    uint32_t flags = irq_save();
+    *out = page_stats;
+    for (uint32_t cpu = 0; cpu < CPU_MAX; cpu++)
+    {
+        for (uint32_t o = 0; o < PAGE_MAG_ORDERS; o++)
+        {
+            const page_mag_t *m = &page_mags[cpu][o];
+            out->cached_pages += m->count << o;
+            out->allocs += m->allocs;
+            out->frees += m->frees;
+        }
+    }
+    for (uint32_t o = 0; o <= PAGE_MAX_ORDER; o++)
+    {
+        out->free_blocks[o] = 0;
+        for (page_t *p = page_free_lists[o]; p; p = p->next)
+            out->free_blocks[o]++;
+    }
+    irq_restore(flags);
+}
+
+void page_print_stats(void)
+{
+    page_stats_t s;
+    page_get_stats(&s);
+    printf("Memoria: %u de %u paginas libres, %u en almacenes, %u reservas, %u liberaciones, %u fallos\n",
+           s.free_pages, s.total_pages, s.cached_pages, s.allocs, s.frees, s.failed);
+    printf("Memoria: almacenes: %u lotes rellenados, %u vaciados\n", s.refills, s.drains);
+    printf("Memoria: %u bloques partidos, %u uniones; libres por orden:", s.splits, s.merges);
+    for (uint32_t o = 0; o <= PAGE_MAX_ORDER; o++)
+        printf(" %u", s.free_blocks[o]);
+    printf("\n");
+}
+
+#ifdef PAGE_BENCH
+#include "timer.h"
+#include "div64.h"
+
+#define PAGE_BENCH_PAIRS 100000
+#define PAGE_BENCH_OPS 200000
+#define PAGE_BENCH_SLOTS 256
+#define PAGE_BENCH_MAX_ORDER 4
+
+static void *page_bench_slot[PAGE_BENCH_SLOTS];
+static uint8_t page_bench_order[PAGE_BENCH_SLOTS];
+
+static uint32_t page_bench_rand(uint32_t *seed)
+{
+    *seed = *seed * 1103515245u + 12345u;
+    return *seed >> 16;
+}
+
+static uint32_t page_bench_rate(uint32_t ops, uint64_t cycles)
+{
+    uint32_t us = (uint32_t)timer_tsc_to_us(cycles);
+    return us ? (uint32_t)div64_u32((uint64_t)ops * 1000000, us, NULL) : 0;
+}
+
+// Primera y última palabra de cada bloque llevan su dirección: si dos
+// bloques se solapan, una de las marcas no sobrevive
+static void page_bench_tag(void *p, uint32_t order)
+{
+    uint32_t *w = (uint32_t *)p;
+    w[0] = (uint32_t)p;
+    w[((PAGE_SIZE << order) / 4) - 1] = ~(uint32_t)p;
+}
+
+static int page_bench_check(void *p, uint32_t order)
+{
+    uint32_t *w = (uint32_t *)p;
+    return w[0] == (uint32_t)p && w[((PAGE_SIZE << order) / 4) - 1] == ~(uint32_t)p;
+}
+
+void page_bench(void)
+{
+    page_stats_t before, after;
+    page_drain();
+    page_get_stats(&before);
+
+    // El camino corto: una página que sale y vuelve a su almacén
+    uint64_t t0 = rdtsc();
+    for (uint32_t i = 0; i < PAGE_BENCH_PAIRS; i++)
+        page_free(page_alloc(0));
+    uint64_t dt = rdtsc() - t0;
+    printf("page_bench: reservar+liberar 1 pagina: %u ciclos, %u pares/s\n",
+           (uint32_t)div64_u32(dt, PAGE_BENCH_PAIRS, NULL), page_bench_rate(PAGE_BENCH_PAIRS, dt));
+
+    // Lo mismo contra las listas del buddy, sin almacén
+    t0 = rdtsc();
+    for (uint32_t i = 0; i < PAGE_BENCH_PAIRS; i++)
+    {
+        uint32_t flags = irq_save();
+        void *p = page_get(0);
+        if (p)
+            page_put((uint32_t)p >> PAGE_SHIFT);
+        irq_restore(flags);
+    }
+    dt = rdtsc() - t0;
+    printf("page_bench: sin almacen: %u ciclos, %u pares/s\n",
+           (uint32_t)div64_u32(dt, PAGE_BENCH_PAIRS, NULL), page_bench_rate(PAGE_BENCH_PAIRS, dt));
+
+    // Ráfagas: se reservan 64 páginas y se liberan, que fuerza lotes en
+    // los dos sentidos
+    void *burst[64];
+    t0 = rdtsc();
+    for (uint32_t i = 0; i < PAGE_BENCH_PAIRS / 64; i++)
+    {
+        for (uint32_t j = 0; j < 64; j++)
+            burst[j] = page_alloc(0);
+        for (uint32_t j = 0; j < 64; j++)
+            if (burst[j])
+                page_free(burst[j]);
+    }
+    dt = rdtsc() - t0;
+    printf("page_bench: rafagas de 64 paginas: %u ciclos por par\n",
+           (uint32_t)div64_u32(dt, (PAGE_BENCH_PAIRS / 64) * 64, NULL));
+
+    // Carga mezclada: órdenes 0-4 al azar con hasta 256 bloques vivos, que
+    // obliga a partir y a unir
+    uint32_t seed = 12345, errors = 0, live = 0, peak = 0;
+    t0 = rdtsc();
+    for (uint32_t i = 0; i < PAGE_BENCH_OPS; i++)
+    {
+        uint32_t s = page_bench_rand(&seed) % PAGE_BENCH_SLOTS;
+        if (page_bench_slot[s])
+        {
+            errors += !page_bench_check(page_bench_slot[s], page_bench_order[s]);
+            page_free(page_bench_slot[s]);
+            page_bench_slot[s] = NULL;
+            live--;
+            continue;
+        }
+        uint32_t order = page_bench_rand(&seed) % (PAGE_BENCH_MAX_ORDER + 1);
+        void *p = page_alloc(order);
+        if (!p)
+            continue;
+        page_bench_tag(p, order);
+        page_bench_slot[s] = p;
+        page_bench_order[s] = (uint8_t)order;
+        if (++live > peak)
+            peak = live;
+    }
+    dt = rdtsc() - t0;
+    for (uint32_t s = 0; s < PAGE_BENCH_SLOTS; s++)
+    {
+        if (!page_bench_slot[s])
+            continue;
+        errors += !page_bench_check(page_bench_slot[s], page_bench_order[s]);
+        page_free(page_bench_slot[s]);
+        page_bench_slot[s] = NULL;
+    }
+    printf("page_bench: carga mezclada: %u operaciones, %u ciclos cada una, %u ops/s, %u vivos como maximo\n",
+           PAGE_BENCH_OPS, (uint32_t)div64_u32(dt, PAGE_BENCH_OPS, NULL),
+           page_bench_rate(PAGE_BENCH_OPS, dt), peak);
+
+    // Todo tiene que haber vuelto y unido hasta los bloques de partida
+    page_drain();
+    page_get_stats(&after);
+    int whole = after.free_pages == before.free_pages &&
+                after.free_blocks[PAGE_MAX_ORDER] == before.free_blocks[PAGE_MAX_ORDER];
+    printf("page_bench: %u solapes, memoria %s\n", errors, whole ? "recompuesta" : "FRAGMENTADA");
+}
+#endif
@@ -3,32 +3,134 @@
 #include "io.h"
 #include "stdint.h"
 #include "stdio.h" // si tienes printf en kernel; si no, elimina las prints
+#include "cpu.h"
+#include "timer.h"
+#include "acpi.h"
+#include "lapic.h"
+#include "paging.h"
 
 /* I/O ports for legacy PCI config */
 #define PCI_CONFIG_ADDRESS 0xCF8
 #define PCI_CONFIG_DATA 0xCFC
 
 /* Construye la dirección para accessar config space */
-static inline uint32_t pci_config_address(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset)
+static inline uint32_t pci_config_address(uint8_t bus, uint8_t slot, uint8_t func, uint16_t offset)
 {
     /* Alineamos offset a dword (bits 0..1 zero) */
     uint32_t addr = (1u << 31) | ((uint32_t)bus << 16) | ((uint32_t)slot << 11) | ((uint32_t)func << 8) | (offset & 0xFC);
     return addr;
 }
 
-uint32_t pci_read_config_32(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset)
+// Dirección y dato son dos accesos: una interrupción entre ambos que tocase
+// la configuración cambiaría CONFIG_ADDRESS por debajo
+static uint32_t pci_legacy_read(uint8_t bus, uint8_t slot, uint8_t func, uint16_t offset)
 {
-    uint32_t address = pci_config_address(bus, slot, func, offset);
-    outl(PCI_CONFIG_ADDRESS, address);
+    // Por puertos solo se alcanzan los primeros 256 bytes
+    if (offset >= 256)
+        return 0xFFFFFFFF;
+    uint32_t flags = irq_save();
+    outl(PCI_CONFIG_ADDRESS, pci_config_address(bus, slot, func, offset));
     uint32_t val = inl(PCI_CONFIG_DATA);
+    irq_restore(flags);
     return val;
 }
 
-void pci_write_config_32(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint32_t value)
+static void pci_legacy_write(uint8_t bus, uint8_t slot, uint8_t func, uint16_t offset, uint32_t value)
 {
-    uint32_t address = pci_config_address(bus, slot, func, offset);
-    outl(PCI_CONFIG_ADDRESS, address);
+    if (offset >= 256)
+        return;
+    uint32_t flags = irq_save();
+    outl(PCI_CONFIG_ADDRESS, pci_config_address(bus, slot, func, offset));
     outl(PCI_CONFIG_DATA, value);
+    irq_restore(flags);
+}
+
+// --- ECAM ---
+// Cada función tiene 4 KB de configuración mapeados en memoria en
+// base + (bus << 20 | slot << 15 | func << 12): un acceso es una sola
+// lectura o escritura, sin estado compartido entre CPUs ni interrupciones.
+// La región se mapea sin caché en su dirección física; los buses de cada
+// región ocupan 1 MB y van en páginas de 4 MB cuando están alineados.
+typedef struct
+{
+    uint32_t base;      // Dirección del bus 0 del segmento
+    uint8_t start_bus;
+    uint8_t end_bus;
+} pci_ecam_region_t;
+
+static pci_ecam_region_t pci_ecam[PCI_MAX_ECAM];
+static uint32_t pci_necam;
+
+static volatile uint32_t *pci_ecam_ptr(uint8_t bus, uint8_t slot, uint8_t func, uint16_t offset)
+{
+    for (uint32_t i = 0; i < pci_necam; i++)
+    {
+        const pci_ecam_region_t *r = &pci_ecam[i];
+        if (bus < r->start_bus || bus > r->end_bus)
+            continue;
+        return (volatile uint32_t *)(r->base + ((uint32_t)bus << 20) + ((uint32_t)(slot & 0x1F) << 15) +
+                                     ((uint32_t)(func & 0x7) << 12) + (offset & 0xFFC));
+    }
+    return NULL;
+}
+
+// Regiones del segmento 0 que publica la tabla MCFG. Solo se usan si la
+// cabecera de 0:0.0 coincide con la que se lee por puertos.
+static void pci_ecam_init(void)
+{
+    const acpi_mcfg_t *mcfg = (const acpi_mcfg_t *)acpi_find_table("MCFG");
+    if (!mcfg)
+        return;
+
+    uint32_t n = (mcfg->header.length - sizeof(*mcfg)) / sizeof(acpi_mcfg_entry_t);
+    for (uint32_t i = 0; i < n && pci_necam < PCI_MAX_ECAM; i++)
+    {
+        const acpi_mcfg_entry_t *e = &mcfg->entries[i];
+        // Fuera del segmento 0 o de los 4 GB direccionables: no se usa
+        uint64_t end = e->base + ((uint64_t)e->end_bus + 1) * (1u << 20);
+        if (e->segment != 0 || e->start_bus > e->end_bus || end > 0x100000000ull)
+            continue;
+        uint64_t first = e->base + ((uint64_t)e->start_bus << 20);
+        if (!paging_map_mmio(first, (uint32_t)(end - first)))
+            continue;
+        pci_ecam[pci_necam].base = (uint32_t)e->base;
+        pci_ecam[pci_necam].start_bus = e->start_bus;
+        pci_ecam[pci_necam].end_bus = e->end_bus;
+        pci_necam++;
+    }
+
+    volatile uint32_t *id = pci_ecam_ptr(0, 0, 0, 0x00);
+    if (pci_necam && (!id || *id != pci_legacy_read(0, 0, 0, 0x00)))
+    {
+        printf("PCI: la región ECAM no responde, se usan los puertos\n");
+        pci_necam = 0;
+        return;
+    }
+    for (uint32_t i = 0; i < pci_necam; i++)
+        printf("PCI: ECAM en 0x%x, buses %u-%u\n", pci_ecam[i].base, pci_ecam[i].start_bus,
+               pci_ecam[i].end_bus);
+}
+
+int pci_ecam_enabled(void)
+{
+    return pci_necam != 0;
+}
+
+uint32_t pci_read_config_32(uint8_t bus, uint8_t slot, uint8_t func, uint16_t offset)
+{
+    volatile uint32_t *p = pci_ecam_ptr(bus, slot, func, offset);
+    if (p)
+        return *p;
+    return pci_legacy_read(bus, slot, func, offset);
+}
+
+void pci_write_config_32(uint8_t bus, uint8_t slot, uint8_t func, uint16_t offset, uint32_t value)
+{
+    volatile uint32_t *p = pci_ecam_ptr(bus, slot, func, offset);
+    if (p)
+        *p = value;
+    else
+        pci_legacy_write(bus, slot, func, offset, value);
 }
 
 /* Lee vendor/device word desde offset 0x00 (dword 0) */
@@ -77,7 +179,29 @@ uint64_t pci_get_bar(uint8_t bus, uint8_t slot, uint8_t func, uint8_t bar_index)
     }
 }
 
-/* Escanea funciones de un dispositivo (0..7). Si vendor==0xFFFF el dispositivo no existe */
+// La lista está en los primeros 256 bytes; cada entrada es id (byte 0) y
+// siguiente (byte 1). El límite corta una lista circular.
+uint8_t pci_find_capability(uint8_t bus, uint8_t slot, uint8_t func, uint8_t cap_id)
+{
+    uint32_t status = pci_read_config_32(bus, slot, func, 0x04) >> 16;
+    if (!(status & PCI_STATUS_CAP_LIST))
+        return 0;
+    // Solo cabeceras de tipo 0 y 1 tienen el puntero en 0x34
+    if ((pci_read_header_type(bus, slot, func) & 0x7F) > 1)
+        return 0;
+
+    uint8_t ptr = (uint8_t)pci_read_config_32(bus, slot, func, 0x34) & 0xFC;
+    for (int n = 0; ptr >= 0x40 && n < 48; n++)
+    {
+        uint32_t d = pci_read_config_32(bus, slot, func, ptr);
+        if ((d & 0xFF) == cap_id)
+            return ptr;
+        ptr = (uint8_t)(d >> 8) & 0xFC;
+    }
+    return 0;
+}
+
+/* Lee la cabecera de una función en out. Si vendor==0xFFFF la función no existe */
 static int probe_function(uint8_t bus, uint8_t slot, uint8_t func, pci_device_t *out)
 {
     uint16_t vendor = pci_read_vendor(bus, slot, func);
@@ -85,87 +209,393 @@ static int probe_function(uint8_t bus, uint8_t slot, uint8_t func, pci_device_t
         return -1;
 
     uint32_t d8 = pci_read_config_32(bus, slot, func, 0x08);
-    uint8_t prog_if = (d8 >> 8) & 0xFF;
-    uint8_t subclass = (d8 >> 16) & 0xFF;
-    uint8_t classcode = (d8 >> 24) & 0xFF;
     uint32_t d0 = pci_read_config_32(bus, slot, func, 0x00);
-    uint16_t device = (uint16_t)((d0 >> 16) & 0xFFFF);
     uint8_t header = pci_read_header_type(bus, slot, func);
 
-    if (out)
+    out->vendor_id = vendor;
+    out->device_id = (uint16_t)((d0 >> 16) & 0xFFFF);
+    out->bus = bus;
+    out->slot = slot;
+    out->func = func;
+    out->prog_if = (d8 >> 8) & 0xFF;
+    out->subclass = (d8 >> 16) & 0xFF;
+    out->class_code = (d8 >> 24) & 0xFF;
+    out->header_type = header;
+    out->irq_line = (uint8_t)pci_read_config_32(bus, slot, func, 0x3C);
+    out->secondary_bus = 0;
+    out->driver = NULL;
+    out->msi_cap = pci_find_capability(bus, slot, func, PCI_CAP_ID_MSI);
+    out->msix_cap = pci_find_capability(bus, slot, func, PCI_CAP_ID_MSIX);
+
+    // Puente PCI-PCI (cabecera de tipo 1): bus secundario en 0x19
+    if ((header & 0x7F) == 1)
+        out->secondary_bus = (uint8_t)(pci_read_config_32(bus, slot, func, 0x18) >> 8);
+    return 0;
+}
+
+// --- Enumeración ---
+// Se recorre una vez al arrancar siguiendo los puentes desde el bus 0, en
+// lugar de probar los 256 buses x 32 ranuras en cada búsqueda
+static pci_device_t pci_devices[PCI_MAX_DEVICES];
+static uint32_t pci_ndevices;
+static uint32_t pci_nbuses;
+static uint8_t pci_enumerated;
+static uint32_t pci_bus_seen[256 / 32];
+
+static const pci_driver_t *pci_drivers[PCI_MAX_DRIVERS];
+static uint32_t pci_ndrivers;
+
+static void pci_scan_bus(uint8_t bus);
+static int pci_bind(pci_device_t *dev, const pci_driver_t *drv);
+
+static void pci_scan_function(uint8_t bus, uint8_t slot, uint8_t func)
+{
+    if (pci_ndevices == PCI_MAX_DEVICES)
+        return;
+    pci_device_t *dev = &pci_devices[pci_ndevices];
+    if (probe_function(bus, slot, func, dev) != 0)
+        return;
+    pci_ndevices++;
+
+    if ((dev->header_type & 0x7F) == 1 && dev->secondary_bus != 0)
+        pci_scan_bus(dev->secondary_bus);
+}
+
+static void pci_scan_bus(uint8_t bus)
+{
+    // Un puente mal configurado podría devolvernos a un bus ya visto
+    if (pci_bus_seen[bus / 32] & (1u << (bus % 32)))
+        return;
+    pci_bus_seen[bus / 32] |= 1u << (bus % 32);
+    pci_nbuses++;
+
+    for (uint8_t slot = 0; slot < 32; slot++)
+    {
+        if (pci_read_vendor(bus, slot, 0) == 0xFFFF)
+            continue;
+        uint8_t max_func = (pci_read_header_type(bus, slot, 0) & 0x80) ? 8 : 1;
+        for (uint8_t func = 0; func < max_func; func++)
+            pci_scan_function(bus, slot, func);
+    }
+}
+
+// Con varios controladores de host, la función n del puente 0:0 es la raíz
+// del bus n
+static void pci_scan_all(void)
+{
+    if (!(pci_read_header_type(0, 0, 0) & 0x80))
+    {
+        pci_scan_bus(0);
+        return;
+    }
+    for (uint8_t func = 0; func < 8; func++)
+    {
+        if (pci_read_vendor(0, 0, func) != 0xFFFF)
+            pci_scan_bus(func);
+    }
+}
+
+#ifdef PCI_BENCH
+// La búsqueda de antes: las 256 x 32 ranuras
+static uint32_t pci_scan_brute(void)
+{
+    uint32_t found = 0;
+    for (uint32_t bus = 0; bus < 256; bus++)
+    {
+        for (uint8_t slot = 0; slot < 32; slot++)
+        {
+            if (pci_read_vendor(bus, slot, 0) == 0xFFFF)
+                continue;
+            uint8_t max_func = (pci_read_header_type(bus, slot, 0) & 0x80) ? 8 : 1;
+            for (uint8_t func = 0; func < max_func; func++)
+                found += pci_read_vendor(bus, slot, func) != 0xFFFF;
+        }
+    }
+    return found;
+}
+
+// Coste de una lectura de configuración por cada mecanismo
+static void pci_bench_access(void)
+{
+    const uint32_t n = 1000;
+    volatile uint32_t sink = 0;
+
+    uint64_t t0 = rdtsc();
+    for (uint32_t i = 0; i < n; i++)
+        sink += pci_legacy_read(0, 0, 0, 0x00);
+    uint32_t ports = (uint32_t)(rdtsc() - t0) / n;
+    printf("PCI: lectura por puertos: %u ciclos\n", ports);
+
+    volatile uint32_t *p = pci_ecam_ptr(0, 0, 0, 0x00);
+    if (!p)
+        return;
+    t0 = rdtsc();
+    for (uint32_t i = 0; i < n; i++)
+        sink += *p;
+    uint32_t ecam = (uint32_t)(rdtsc() - t0) / n;
+    printf("PCI: lectura por ECAM: %u ciclos\n", ecam);
+    (void)sink;
+}
+#endif
+
+int pci_init(void)
+{
+    if (pci_enumerated)
+        return (int)pci_ndevices;
+
+    pci_ecam_init();
+
+    uint64_t t0 = rdtsc();
+    pci_scan_all();
+    uint32_t us = (uint32_t)timer_tsc_to_us(rdtsc() - t0);
+    pci_enumerated = 1;
+
+    printf("PCI: %u funciones en %u buses, enumeradas en %u us (%s)\n", pci_ndevices, pci_nbuses, us,
+           pci_necam ? "ECAM" : "puertos");
+#ifdef PCI_BENCH
+    pci_bench_access();
+    t0 = rdtsc();
+    uint32_t brute = pci_scan_brute();
+    printf("PCI: barrido de 256 buses: %u funciones en %u us\n", brute,
+           (uint32_t)timer_tsc_to_us(rdtsc() - t0));
+#endif
+
+    // Drivers registrados antes de enumerar
+    for (uint32_t i = 0; i < pci_ndrivers; i++)
+    {
+        for (uint32_t j = 0; j < pci_ndevices; j++)
+            pci_bind(&pci_devices[j], pci_drivers[i]);
+    }
+    return (int)pci_ndevices;
+}
+
+uint32_t pci_device_count(void)
+{
+    return pci_ndevices;
+}
+
+pci_device_t *pci_get_device(uint32_t index)
+{
+    return index < pci_ndevices ? &pci_devices[index] : NULL;
+}
+
+// --- Drivers ---
+static int pci_id_match(const pci_device_t *dev, const pci_id_t *id)
+{
+    uint32_t class_code = PCI_CLASS(dev->class_code, dev->subclass, dev->prog_if);
+    return (id->vendor == PCI_ANY_ID || id->vendor == dev->vendor_id) &&
+           (id->device == PCI_ANY_ID || id->device == dev->device_id) &&
+           (class_code & id->class_mask) == (id->class_code & id->class_mask);
+}
+
+// La tabla de IDs acaba en una entrada a cero
+static int pci_bind(pci_device_t *dev, const pci_driver_t *drv)
+{
+    if (dev->driver)
+        return 0;
+    for (const pci_id_t *id = drv->ids; id->vendor || id->class_mask; id++)
+    {
+        if (!pci_id_match(dev, id))
+            continue;
+        if (drv->probe(dev, id) != 0)
+            return 0;
+        dev->driver = drv;
+        return 1;
+    }
+    return 0;
+}
+
+int pci_register_driver(const pci_driver_t *drv)
+{
+    if (!drv || !drv->ids || !drv->probe || pci_ndrivers == PCI_MAX_DRIVERS)
+        return -1;
+    pci_drivers[pci_ndrivers++] = drv;
+    if (!pci_enumerated)
+        return 0;
+
+    int bound = 0;
+    for (uint32_t i = 0; i < pci_ndevices; i++)
+        bound += pci_bind(&pci_devices[i], drv);
+    return bound;
+}
+
+void pci_enable_device(pci_device_t *dev, uint16_t bits)
+{
+    // El bit 10 a cero deja que la función levante su línea INTx
+    uint32_t command = pci_read_config_32(dev->bus, dev->slot, dev->func, 0x04);
+    pci_write_config_32(dev->bus, dev->slot, dev->func, 0x04,
+                        ((command & 0xFFFF) | bits) & ~(uint32_t)PCI_COMMAND_INTX_DISABLE);
+}
+
+// --- MSI / MSI-X ---
+// Control del mensaje: 16 bits altos del primer dword de la capacidad
+#define PCI_MSI_CTRL_ENABLE 0x0001
+#define PCI_MSI_CTRL_MME_MASK 0x0070 // Mensajes habilitados (log2)
+#define PCI_MSI_CTRL_64BIT 0x0080
+#define PCI_MSIX_CTRL_SIZE_MASK 0x07FF // Entradas de la tabla - 1
+#define PCI_MSIX_CTRL_FUNC_MASK 0x4000
+#define PCI_MSIX_CTRL_ENABLE 0x8000
+#define PCI_MSIX_ENTRY_MASKED 0x1
+
+static uint16_t pci_cap_ctrl(pci_device_t *dev, uint8_t cap)
+{
+    return (uint16_t)(pci_read_config_32(dev->bus, dev->slot, dev->func, cap) >> 16);
+}
+
+static void pci_cap_set_ctrl(pci_device_t *dev, uint8_t cap, uint16_t ctrl)
+{
+    uint32_t d = pci_read_config_32(dev->bus, dev->slot, dev->func, cap);
+    pci_write_config_32(dev->bus, dev->slot, dev->func, cap, (d & 0xFFFF) | ((uint32_t)ctrl << 16));
+}
+
+static void pci_set_intx(pci_device_t *dev, int enable)
+{
+    uint32_t command = pci_read_config_32(dev->bus, dev->slot, dev->func, 0x04) & 0xFFFF;
+    if (enable)
+        command &= ~(uint32_t)PCI_COMMAND_INTX_DISABLE;
+    else
+        command |= PCI_COMMAND_INTX_DISABLE;
+    pci_write_config_32(dev->bus, dev->slot, dev->func, 0x04, command);
+}
+
+int pci_enable_msi(pci_device_t *dev, uint8_t vector)
+{
+    if (!dev->msi_cap || !lapic_enabled())
+        return -1;
+    uint8_t cap = dev->msi_cap;
+    uint16_t ctrl = pci_cap_ctrl(dev, cap);
+
+    pci_write_config_32(dev->bus, dev->slot, dev->func, cap + 4, lapic_msi_address());
+    if (ctrl & PCI_MSI_CTRL_64BIT)
+    {
+        pci_write_config_32(dev->bus, dev->slot, dev->func, cap + 8, 0);
+        pci_write_config_32(dev->bus, dev->slot, dev->func, cap + 12, lapic_msi_data(vector));
+    }
+    else
+        pci_write_config_32(dev->bus, dev->slot, dev->func, cap + 8, lapic_msi_data(vector));
+
+    // Un mensaje (MME = 0): todas las fuentes de la función al mismo vector
+    ctrl = (ctrl & ~PCI_MSI_CTRL_MME_MASK) | PCI_MSI_CTRL_ENABLE;
+    pci_cap_set_ctrl(dev, cap, ctrl);
+    pci_set_intx(dev, 0);
+    return 0;
+}
+
+uint32_t pci_msix_count(pci_device_t *dev)
+{
+    if (!dev->msix_cap)
+        return 0;
+    return (pci_cap_ctrl(dev, dev->msix_cap) & PCI_MSIX_CTRL_SIZE_MASK) + 1u;
+}
+
+// Tabla de 16 bytes por entrada: dirección (2 dwords), dato y control, en
+// el BAR que indica el BIR (bits 0-2 del dword 1 de la capacidad)
+static volatile uint32_t *pci_msix_table(pci_device_t *dev)
+{
+    uint32_t table = pci_read_config_32(dev->bus, dev->slot, dev->func, dev->msix_cap + 4);
+    uint64_t bar = pci_get_bar(dev->bus, dev->slot, dev->func, table & 0x7);
+    if (bar == 0 || (bar >> 32) != 0)
+        return NULL;
+    return (volatile uint32_t *)paging_map_mmio(bar + (table & ~0x7u), pci_msix_count(dev) * 16);
+}
+
+int pci_msix_set(pci_device_t *dev, uint32_t entry, uint8_t vector)
+{
+    if (!lapic_enabled() || entry >= pci_msix_count(dev))
+        return -1;
+    volatile uint32_t *table = pci_msix_table(dev);
+    if (!table)
+        return -1;
+
+    uint8_t cap = dev->msix_cap;
+    uint16_t ctrl = pci_cap_ctrl(dev, cap);
+    if (!(ctrl & PCI_MSIX_CTRL_ENABLE))
     {
-        out->vendor_id = vendor;
-        out->device_id = device;
-        out->bus = bus;
-        out->slot = slot;
-        out->func = func;
-        out->prog_if = prog_if;
-        out->subclass = subclass;
-        out->class_code = classcode;
-        out->header_type = header;
+        // Con la función enmascarada no sale ningún mensaje a medio programar
+        pci_cap_set_ctrl(dev, cap, ctrl | PCI_MSIX_CTRL_ENABLE | PCI_MSIX_CTRL_FUNC_MASK);
+        uint32_t n = pci_msix_count(dev);
+        for (uint32_t i = 0; i < n; i++)
+            table[i * 4 + 3] |= PCI_MSIX_ENTRY_MASKED;
+        pci_set_intx(dev, 0);
+        ctrl = (ctrl | PCI_MSIX_CTRL_ENABLE) & ~PCI_MSIX_CTRL_FUNC_MASK;
     }
+
+    volatile uint32_t *e = &table[entry * 4];
+    e[3] |= PCI_MSIX_ENTRY_MASKED;
+    e[0] = lapic_msi_address();
+    e[1] = 0;
+    e[2] = lapic_msi_data(vector);
+    e[3] &= ~(uint32_t)PCI_MSIX_ENTRY_MASKED;
+    pci_cap_set_ctrl(dev, cap, ctrl);
     return 0;
 }
 
+void pci_disable_msi(pci_device_t *dev)
+{
+    if (dev->msi_cap)
+        pci_cap_set_ctrl(dev, dev->msi_cap, pci_cap_ctrl(dev, dev->msi_cap) & ~PCI_MSI_CTRL_ENABLE);
+    if (dev->msix_cap)
+        pci_cap_set_ctrl(dev, dev->msix_cap,
+                         pci_cap_ctrl(dev, dev->msix_cap) & ~PCI_MSIX_CTRL_ENABLE);
+    pci_set_intx(dev, 1);
+}
+
+// --- Búsquedas en la tabla ---
+static pci_device_t *pci_find(const pci_id_t *id)
+{
+    pci_init();
+    for (uint32_t i = 0; i < pci_ndevices; i++)
+    {
+        if (pci_id_match(&pci_devices[i], id))
+            return &pci_devices[i];
+    }
+    return NULL;
+}
+
 /*
  * pci_find_ahci: busca un dispositivo con class=0x01 (Mass Storage),
  * subclass=0x06 (SATA), prog-if=0x01 (AHCI)
  */
 int pci_find_ahci(pci_device_t *out_dev)
 {
-    for (uint8_t bus = 0; bus < 256; bus++)
-    {
-        for (uint8_t slot = 0; slot < 32; slot++)
-        {
-            // Probar función 0
-            if (probe_function(bus, slot, 0, NULL) != 0)
-                continue;
+    return pci_find_class(0x01, 0x06, 0x01, out_dev);
+}
 
-            uint8_t header = pci_read_header_type(bus, slot, 0);
-            int multifunc = header & 0x80;
+int pci_find_class(uint8_t class_code, uint8_t subclass, uint8_t prog_if, pci_device_t *out_dev)
+{
+    pci_id_t id = {PCI_ANY_ID, PCI_ANY_ID, PCI_CLASS(class_code, subclass, prog_if), 0xFFFFFF};
+    pci_device_t *dev = pci_find(&id);
+    if (!dev)
+        return -1;
+    if (out_dev)
+        *out_dev = *dev;
+    return 0;
+}
 
-            uint8_t max_func = multifunc ? 8 : 1;
-            for (uint8_t func = 0; func < max_func; func++)
-            {
-                pci_device_t dev;
-                if (probe_function(bus, slot, func, &dev) != 0)
-                    continue;
-
-                if (dev.class_code == 0x01 && dev.subclass == 0x06 && dev.prog_if == 0x01)
-                {
-                    if (out_dev)
-                        *out_dev = dev;
-                    return 0;
-                }
-            }
-        }
-    }
-    return -1;
+int pci_find_device(uint16_t vendor, uint16_t device, pci_device_t *out_dev)
+{
+    pci_id_t id = {vendor, device, 0, 0};
+    pci_device_t *dev = pci_find(&id);
+    if (!dev)
+        return -1;
+    if (out_dev)
+        *out_dev = *dev;
+    return 0;
 }
 
 /* OPTIONAL: función de debug para listar dispositivos PCI (útil en QEMU) */
 #ifdef PCI_DEBUG
 void pci_dump_all(void)
 {
-    pci_device_t dev;
-    for (uint8_t bus = 0; bus < 256; bus++)
+    pci_init();
+    for (uint32_t i = 0; i < pci_ndevices; i++)
     {
-        for (uint8_t slot = 0; slot < 32; slot++)
-        {
-            if (probe_function(bus, slot, 0, NULL) != 0)
-                continue;
-            uint8_t header = pci_read_header_type(bus, slot, 0);
-            int multifunc = header & 0x80;
-            uint8_t max_func = multifunc ? 8 : 1;
-            for (uint8_t func = 0; func < max_func; func++)
-            {
-                if (probe_function(bus, slot, func, &dev) != 0)
-                    continue;
-                printf("PCI dev: bus=%u slot=%u func=%u vendor=0x%04x device=0x%04x class=0x%02x subclass=0x%02x prog-if=0x%02x\n",
-                       dev.bus, dev.slot, dev.func, dev.vendor_id, dev.device_id,
-                       dev.class_code, dev.subclass, dev.prog_if);
-            }
-        }
+        pci_device_t *dev = &pci_devices[i];
+        printf("PCI dev: bus=%u slot=%u func=%u vendor=0x%x device=0x%x class=0x%x subclass=0x%x prog-if=0x%x irq=%u msi=%s msix=%u driver=%s\n",
+               dev->bus, dev->slot, dev->func, dev->vendor_id, dev->device_id,
+               dev->class_code, dev->subclass, dev->prog_if, dev->irq_line,
+               dev->msi_cap ? "si" : "no", pci_msix_count(dev),
+               dev->driver ? dev->driver->name : "-");
     }
 }
 #endif
@@ -0,0 +1,362 @@
+// fsbench: mide el sistema de archivos sobre una imagen del host
+//
+// Cada fase informa de operaciones por segundo, de las peticiones y
+// bloques que llegaron al dispositivo y de las que la capa de bloques fusionó. Al final se comprueba el volumen y
+// se compara la búsqueda en el mapa de bits palabra a palabra con la de
+// bit a bit sobre un mapa casi lleno.
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bitmap.h"
+#include "blkdev.h"
+#include "fs.h"
+#include "file.h"
+#include "fsmem.h"
+#include "hostdev.h"
+
+#define BENCH_READ_CHUNK 4096 // Lecturas secuenciales de la fase read
+
+// Parámetros de la prueba
+static fs_geometry_t geo = {4096, 16384, 2048, 256};
+static uint32_t nfiles = 500;
+static uint32_t file_size = 8192;
+static uint32_t chunk = 512;
+static uint32_t mix_ops = 5000;
+static uint32_t seed = 1;
+
+static uint8_t *exists; // Archivos vivos durante la fase mix
+static uint8_t iobuf[BENCH_READ_CHUNK > FS_MAX_BLOCK_SIZE ? BENCH_READ_CHUNK : FS_MAX_BLOCK_SIZE];
+
+// --- Medida ---
+static uint64_t phase_start;
+
+static void phase_begin(void)
+{
+    hostdev_reset_stats();
+    blkdev_reset_stats(blkdev_root());
+    phase_start = hostdev_now_ns();
+}
+
+static void phase_end(const char *name, uint32_t ops)
+{
+    uint64_t ns = hostdev_now_ns() - phase_start;
+    hostdev_stats_t dev;
+    hostdev_get_stats(&dev);
+    blkdev_stats_t blk;
+    blkdev_get_stats(blkdev_root(), &blk);
+
+    uint32_t spb = geo.block_size / 512;
+    uint64_t blocks_read = dev.sectors_read / spb;
+    uint64_t blocks_written = dev.sectors_written / spb;
+    double secs = ns / 1e9;
+
+    printf("%-8s %7u ops %11.0f ops/s  lect %6llu pet %8llu bloq  escr %6llu pet %8llu bloq  %7.2f bloq/op  %5u fusiones\n",
+           name, ops, secs > 0 ? ops / secs : 0.0,
+           (unsigned long long)dev.reads, (unsigned long long)blocks_read,
+           (unsigned long long)dev.writes, (unsigned long long)blocks_written,
+           ops ? (double)(blocks_read + blocks_written) / ops : 0.0, blk.merges);
+}
+
+// Generador xorshift: la misma semilla da la misma secuencia en cualquier host
+static uint32_t bench_rand(void)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+static void file_name(char *out, uint32_t i)
+{
+    snprintf(out, MAX_FILENAME, "f%05u", i);
+}
+
+// --- Operaciones ---
+static int bench_write(uint32_t i, uint32_t bytes)
+{
+    char name[MAX_FILENAME];
+    file_name(name, i);
+    int fd = file_open(name, O_WRONLY);
+    if (fd < 0)
+        return -1;
+
+    file_seek(fd, 0, SEEK_END);
+    for (uint32_t done = 0; done < bytes; done += chunk)
+        file_write(fd, iobuf, MIN(chunk, bytes - done));
+    file_close(fd);
+    return 0;
+}
+
+static int bench_read(uint32_t i)
+{
+    char name[MAX_FILENAME];
+    file_name(name, i);
+    int fd = file_open(name, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    while (file_read(fd, iobuf, BENCH_READ_CHUNK) > 0)
+        ;
+    file_close(fd);
+    return 0;
+}
+
+// Lectura de un fragmento en una posición aleatoria del archivo
+static int bench_read_random(uint32_t i)
+{
+    char name[MAX_FILENAME];
+    file_name(name, i);
+    int fd = file_open(name, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    int size = file_seek(fd, 0, SEEK_END);
+    if (size > 0)
+        file_seek(fd, bench_rand() % (uint32_t)size, SEEK_SET);
+    file_read(fd, iobuf, chunk);
+    file_close(fd);
+    return 0;
+}
+
+static int bench_open(uint32_t i)
+{
+    char name[MAX_FILENAME];
+    file_name(name, i);
+    int fd = file_open(name, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    return file_close(fd);
+}
+
+static int bench_create(uint32_t i)
+{
+    char name[MAX_FILENAME];
+    file_name(name, i);
+    return fs_create_file(name, FILE_TYPE_REGULAR);
+}
+
+static int bench_delete(uint32_t i)
+{
+    char name[MAX_FILENAME];
+    file_name(name, i);
+    return fs_delete_file(name);
+}
+
+// Sale de caché: lo siguiente se lee del dispositivo
+static void bench_remount(void)
+{
+    fs_unmount();
+    fs_init();
+}
+
+// --- Fases ---
+static void run_phases(void)
+{
+    uint32_t failed = 0;
+
+    phase_begin();
+    for (uint32_t i = 0; i < nfiles; i++)
+        failed += bench_create(i) != FS_SUCCESS;
+    phase_end("create", nfiles);
+
+    phase_begin();
+    for (uint32_t i = 0; i < nfiles; i++)
+        failed += bench_write(i, file_size) != 0;
+    fs_sync();
+    phase_end("write", nfiles);
+
+    bench_remount();
+    phase_begin();
+    for (uint32_t i = 0; i < nfiles; i++)
+        failed += bench_open(i) != 0;
+    phase_end("open", nfiles);
+
+    bench_remount();
+    phase_begin();
+    for (uint32_t i = 0; i < nfiles; i++)
+        failed += bench_read(i) != 0;
+    phase_end("read", nfiles);
+
+    // Mezcla: 40% lectura aleatoria, 20% anexar, 15% abrir/cerrar,
+    // 15% crear y 10% borrar
+    memset(exists, 1, nfiles);
+    memset(exists + nfiles, 0, nfiles);
+    uint32_t live = nfiles;
+
+    bench_remount();
+    phase_begin();
+    for (uint32_t op = 0; op < mix_ops; op++)
+    {
+        uint32_t r = bench_rand() % 100;
+        uint32_t i = bench_rand() % (2 * nfiles);
+
+        if (r >= 75 && r < 90)
+        {
+            if (!exists[i] && bench_create(i) == FS_SUCCESS)
+            {
+                exists[i] = 1;
+                live++;
+            }
+            continue;
+        }
+
+        // El resto de operaciones actúa sobre un archivo existente
+        if (live == 0)
+            continue;
+        while (!exists[i])
+            i = (i + 1) % (2 * nfiles);
+
+        if (r < 40)
+            failed += bench_read_random(i) != 0;
+        else if (r < 60)
+            failed += bench_write(i, chunk) != 0;
+        else if (r < 75)
+            failed += bench_open(i) != 0;
+        else if (bench_delete(i) == FS_SUCCESS)
+        {
+            exists[i] = 0;
+            live--;
+        }
+    }
+    fs_sync();
+    phase_end("mix", mix_ops);
+
+    uint32_t deleted = 0;
+    phase_begin();
+    for (uint32_t i = 0; i < 2 * nfiles; i++)
+    {
+        if (!exists[i])
+            continue;
+        failed += bench_delete(i) != FS_SUCCESS;
+        deleted++;
+    }
+    fs_sync();
+    phase_end("delete", deleted);
+
+    if (failed)
+        printf("fsbench: %u operaciones fallaron\n", failed);
+    printf("fsck: %d errores\n", fs_check());
+    fsmem_print_stats();
+}
+
+// --- Búsqueda en el mapa de bits ---
+// Búsqueda bit a bit, como antes de bitmap_find_zero
+static uint32_t naive_find_zero(const uint32_t *words, uint32_t start, uint32_t end)
+{
+    for (uint32_t i = start; i < end; i++)
+    {
+        if (!bitmap_test(words, i))
+            return i;
+    }
+    return end;
+}
+
+static void run_alloc_bench(void)
+{
+    const uint32_t bits = 1u << 20;
+    const uint32_t gap = 8192; // Un bloque libre de cada gap: mapa casi lleno
+    uint32_t *words = calloc(BITMAP_WORDS(bits), sizeof(uint32_t));
+    if (!words)
+        return;
+
+    bitmap_set_range(words, 0, bits);
+    for (uint32_t i = gap - 1; i < bits; i += gap)
+        bitmap_clear(words, i);
+
+    uint32_t rounds = 64;
+    uint32_t searches = 0;
+    uint64_t found = 0;
+
+    uint64_t t0 = hostdev_now_ns();
+    for (uint32_t r = 0; r < rounds; r++)
+    {
+        for (uint32_t pos = 0; pos < bits; pos = naive_find_zero(words, pos, bits) + 1)
+            searches++;
+    }
+    uint64_t naive_ns = hostdev_now_ns() - t0;
+
+    t0 = hostdev_now_ns();
+    for (uint32_t r = 0; r < rounds; r++)
+    {
+        for (uint32_t pos = 0; pos < bits; pos = bitmap_find_zero(words, pos, bits) + 1)
+            found++;
+    }
+    uint64_t word_ns = hostdev_now_ns() - t0;
+
+    printf("bitmap   %u bits, 1 libre de cada %u: bit a bit %.0f ns/busqueda, "
+           "por palabras %.0f ns/busqueda (%u/%llu busquedas)\n",
+           bits, gap, (double)naive_ns / searches, (double)word_ns / found,
+           searches, (unsigned long long)found);
+    free(words);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "uso: %s [-b tam_bloque] [-n bloques] [-i inodos] [-j bloques_diario]\n"
+            "       [-f archivos] [-s tam_archivo] [-c tam_escritura] [-m ops_mezcla]\n"
+            "       [-r semilla] imagen\n"
+            "La imagen se formatea con la geometria indicada antes de medir.\n",
+            prog);
+    exit(2);
+}
+
+static uint32_t parse_u32(const char *s, const char *prog)
+{
+    char *end;
+    unsigned long v = strtoul(s, &end, 0);
+    if (*s == '\0' || *end != '\0' || v > 0xFFFFFFFFul)
+        usage(prog);
+    return (uint32_t)v;
+}
+
+int main(int argc, char **argv)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "b:n:i:j:f:s:c:m:r:")) != -1)
+    {
+        uint32_t v = parse_u32(optarg, argv[0]);
+        switch (opt)
+        {
+        case 'b': geo.block_size = v; break;
+        case 'n': geo.total_blocks = v; break;
+        case 'i': geo.total_inodes = v; break;
+        case 'j': geo.journal_blocks = v; break;
+        case 'f': nfiles = v; break;
+        case 's': file_size = v; break;
+        case 'c': chunk = v; break;
+        case 'm': mix_ops = v; break;
+        case 'r': seed = v; break;
+        default: usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1 || nfiles == 0 || chunk == 0 || chunk > sizeof(iobuf) || seed == 0 ||
+        geo.block_size < FS_MIN_BLOCK_SIZE)
+        usage(argv[0]);
+
+    exists = calloc(2 * nfiles, 1);
+    if (!exists || hostdev_open(argv[optind], (uint64_t)geo.total_blocks * geo.block_size) != 0)
+        return 8;
+    memset(iobuf, 0xA5, sizeof(iobuf));
+
+    if (fs_format_geometry(&geo) != FS_SUCCESS)
+    {
+        fprintf(stderr, "%s: no se pudo formatear la imagen\n", argv[0]);
+        return 8;
+    }
+    printf("volumen: %u bloques de %u bytes, %u inodos, diario de %u bloques\n",
+           geo.total_blocks, geo.block_size, geo.total_inodes, geo.journal_blocks);
+    printf("carga: %u archivos de %u bytes, escrituras de %u bytes, %u ops de mezcla\n",
+           nfiles, file_size, chunk, mix_ops);
+
+    run_phases();
+    run_alloc_bench();
+
+    fs_unmount();
+    hostdev_close();
+    free(exists);
+    return 0;
+}
@@ -0,0 +1,65 @@
+// fsck: monta un volumen (reaplicando el diario) y comprueba su consistencia
+//
+// Códigos de salida: 0 sin errores, 4 con inconsistencias, 8 si no se pudo
+// comprobar (imagen ilegible o sin sistema de archivos).
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <string.h>
+
+#include "blkdev.h"
+#include "fs.h"
+#include "hostdev.h"
+
+// El superbloque está en el primer sector sea cual sea el tamaño de bloque
+static int read_superblock(superblock_t *sb)
+{
+    uint8_t sector[BLK_SECTOR_SIZE];
+    if (blkdev_read(blkdev_root(), 0, 1, sector) != 0)
+        return -1;
+    memcpy(sb, sector, sizeof(*sb));
+    return sb->magic == FS_MAGIC ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "uso: %s imagen\n", argv[0]);
+        return 8;
+    }
+    const char *path = argv[1];
+
+    superblock_t sb;
+    if (hostdev_open(path, 0) != 0)
+        return 8;
+    if (read_superblock(&sb) != 0)
+    {
+        fprintf(stderr, "%s: %s no contiene un sistema de archivos\n", argv[0], path);
+        hostdev_close();
+        return 8;
+    }
+
+    int ret = fs_init();
+    if (ret != FS_SUCCESS)
+    {
+        fprintf(stderr, "%s: no se pudo montar %s (%d)\n", argv[0], path, ret);
+        hostdev_close();
+        return 8;
+    }
+
+    int errors = fs_check();
+    read_superblock(&sb);
+    fs_unmount();
+    hostdev_close();
+
+    if (errors < 0)
+    {
+        fprintf(stderr, "%s: no se pudo comprobar %s (%d)\n", argv[0], path, errors);
+        return 8;
+    }
+
+    printf("%s: %u/%u inodos, %u/%u bloques de %u bytes, %d errores\n", path,
+           sb.total_inodes - sb.free_inodes, sb.total_inodes,
+           sb.total_blocks - sb.free_blocks, sb.total_blocks, sb.block_size, errors);
+    return errors ? 4 : 0;
+}
@@ -0,0 +1,338 @@
+// fstest: pruebas del sistema de archivos sobre una imagen del host
+//
+// wrap: corta la corriente en cada una de las escrituras de una serie de
+// creaciones que da varias vueltas al diario y comprueba, tras montar, que
+// siguen todos los archivos cuyo commit llegó al disco y que el volumen
+// cuadra.
+//
+// ioerr: hace fallar una escritura del checkpoint y comprueba que el
+// diario no se vacía y que el bloque sigue sucio hasta que se escribe.
+//
+// desc: cambia el destino de una transacción con commit y comprueba que
+// al montar no se reaplica.
+//
+// grow: una escritura que toca más mapa de bloques del que reserva una
+// operación tiene que repartirse en varias; cortando la corriente en cada
+// escritura, tras montar el mapa y las extensiones tienen que cuadrar.
+//
+// churn: crea y borra muchos nombres con el directorio a medio llenar y
+// comprueba que las búsquedas de nombres que no existen siguen siendo
+// cortas en el índice hash.
+//
+// Códigos de salida: 0 sin fallos, 4 si alguna prueba falla, 8 si no se
+// pudieron ejecutar.
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <string.h>
+
+#include "dirhash.h"
+#include "fs.h"
+#include "hostdev.h"
+#include "journal.h"
+
+// Volumen pequeño: con este diario hay checkpoint cada pocas transacciones
+static const fs_geometry_t wrap_geo = {512, 2048, 128, 64};
+#define WRAP_FILES 24
+
+// Diario holgado: ningún checkpoint hasta el que se hace fallar
+static const fs_geometry_t ioerr_geo = {512, 2048, 128, 256};
+#define IOERR_FILES 8
+
+// Cada bloque del mapa cubre 4096 bloques: la escritura toca cuatro
+static const fs_geometry_t grow_geo = {512, 16384, 64, 64};
+#define GROW_BYTES (6u * 1024 * 1024)
+static uint8_t grow_data[GROW_BYTES];
+
+// Índice de 512 entradas con un cuarto ocupado
+static const fs_geometry_t churn_geo = {512, 2048, 256, 64};
+#define CHURN_LIVE 128
+#define CHURN_ROUNDS 4096
+#define CHURN_MISSES 1024
+#define CHURN_MAX_AVG_PROBES 4
+
+static void test_name(char *out, const char *prefix, uint32_t i)
+{
+    snprintf(out, MAX_FILENAME, "%s%05u", prefix, i);
+}
+
+// --- Caída en la vuelta del diario ---
+// Una pasada con el corte tras crash_at escrituras. Devuelve 1 si el corte
+// llegó a producirse, 0 si la serie terminó antes y -1 si algo falló.
+static int wrap_run(uint32_t crash_at, uint32_t *checkpoints)
+{
+    char name[MAX_FILENAME];
+    if (fs_format_geometry(&wrap_geo) != FS_SUCCESS)
+        return -1;
+    journal_reset_stats();
+
+    // Cada archivo en su propia transacción: se sabe cuáles tienen commit
+    uint32_t durable = 0;
+    hostdev_crash_after(crash_at);
+    for (uint32_t i = 0; i < WRAP_FILES; i++)
+    {
+        test_name(name, "w", i);
+        if (fs_create_file(name, FILE_TYPE_REGULAR) != FS_SUCCESS)
+            return -1;
+        journal_commit();
+        if (!hostdev_crashed())
+            durable = i + 1;
+    }
+    journal_stats_t js;
+    journal_get_stats(&js);
+    *checkpoints = js.checkpoints;
+
+    // Se pierde lo que hubiera en memoria y se monta de nuevo
+    fs_unmount();
+    int crashed = hostdev_crashed();
+    hostdev_crash_after(HOSTDEV_NO_CRASH);
+    if (fs_init() != FS_SUCCESS)
+        return -1;
+
+    int failed = 0;
+    for (uint32_t i = 0; i < durable; i++)
+    {
+        uint32_t ino;
+        test_name(name, "w", i);
+        if (fs_find_file(name, &ino) != FS_SUCCESS)
+        {
+            printf("wrap: corte tras %u escrituras: falta %s (con commit)\n", crash_at, name);
+            failed = 1;
+        }
+    }
+    int errors = fs_check();
+    if (errors != 0)
+    {
+        printf("wrap: corte tras %u escrituras: fsck %d errores\n", crash_at, errors);
+        failed = 1;
+    }
+    return failed ? -1 : crashed;
+}
+
+static int test_wrap(void)
+{
+    uint32_t runs = 0, failed = 0, checkpoints = 0;
+    for (uint32_t at = 0;; at++)
+    {
+        int r = wrap_run(at, &checkpoints);
+        runs++;
+        if (r < 0)
+            failed++;
+        if (r == 0)
+            break;
+    }
+    printf("wrap: %u cortes, %u checkpoints por serie, %u fallos\n", runs - 1, checkpoints, failed);
+    return failed == 0 && checkpoints > 1 ? 0 : -1;
+}
+
+// --- Error de escritura en el checkpoint ---
+// Crea archivos con commit, hace fallar la primera escritura de fs_sync y,
+// con second_sync, repite el sync sin errores. Después se pierde la memoria
+// y se monta: con el diario intacto o con el bloque reescrito, no debe
+// faltar nada. Devuelve el número de fallos.
+static uint32_t ioerr_run(int second_sync)
+{
+    char name[MAX_FILENAME];
+    if (fs_format_geometry(&ioerr_geo) != FS_SUCCESS)
+        return 1;
+
+    uint32_t failed = 0;
+    for (uint32_t i = 0; i < IOERR_FILES; i++)
+    {
+        test_name(name, "e", i);
+        failed += fs_create_file(name, FILE_TYPE_REGULAR) != FS_SUCCESS;
+    }
+    journal_commit();
+
+    journal_reset_stats();
+    hostdev_fail_writes(1);
+    failed += fs_sync() == FS_SUCCESS;
+    hostdev_fail_writes(0);
+    journal_stats_t js;
+    journal_get_stats(&js);
+    failed += js.checkpoints != 0;
+    if (second_sync)
+        failed += fs_sync() != FS_SUCCESS;
+
+    hostdev_crash_after(0);
+    fs_unmount();
+    hostdev_crash_after(HOSTDEV_NO_CRASH);
+    if (fs_init() != FS_SUCCESS)
+        return failed + 1;
+
+    uint32_t ino;
+    for (uint32_t i = 0; i < IOERR_FILES; i++)
+    {
+        test_name(name, "e", i);
+        failed += fs_find_file(name, &ino) != FS_SUCCESS;
+    }
+    failed += fs_check() != 0;
+    return failed;
+}
+
+static int test_ioerr(void)
+{
+    uint32_t failed = ioerr_run(0) + ioerr_run(1);
+    printf("ioerr: escritura fallida en el checkpoint, %u fallos\n", failed);
+    return failed ? -1 : 0;
+}
+
+// --- Descriptor corrupto ---
+// Tras perder la memoria, el destino de la primera copia pasa a ser el
+// último bloque del volumen (libre, y a cero). El checksum cubre el descriptor: la
+// transacción no vale y ese bloque tiene que seguir a cero.
+static int test_desc(void)
+{
+    uint8_t blk[512];
+    if (fs_format_geometry(&ioerr_geo) != FS_SUCCESS || fs_create_file("d", FILE_TYPE_REGULAR) != FS_SUCCESS)
+        return -1;
+    journal_commit();
+    hostdev_crash_after(0);
+    fs_unmount();
+    hostdev_crash_after(HOSTDEV_NO_CRASH);
+
+    superblock_t sb;
+    bcache_read_blocks(FS_SUPERBLOCK_BLOCK, 1, blk);
+    memcpy(&sb, blk, sizeof(sb));
+    uint32_t victim = sb.total_blocks - 1;
+    bcache_read_blocks(sb.journal_start + 1, 1, blk);
+    journal_desc_t *desc = (journal_desc_t *)blk;
+    if (desc->magic != JOURNAL_DESC_MAGIC)
+        return -1;
+    desc->blocks[0] = victim;
+    bcache_write_blocks(sb.journal_start + 1, 1, blk);
+    memset(blk, 0, sizeof(blk));
+    bcache_write_blocks(victim, 1, blk);
+
+    journal_reset_stats();
+    uint32_t failed = fs_init() != FS_SUCCESS;
+    journal_stats_t js;
+    journal_get_stats(&js);
+    failed += js.replayed != 0;
+    bcache_read_blocks(victim, 1, blk);
+    for (uint32_t i = 0; i < sizeof(blk); i++)
+        failed += blk[i] != 0;
+    failed += fs_check() != 0;
+
+    printf("desc: destino cambiado, %u transacciones reaplicadas, %u fallos\n", js.replayed, failed);
+    return failed ? -1 : 0;
+}
+
+// --- Escritura repartida en varias operaciones ---
+// Devuelve 1 si el corte llegó a producirse, 0 si no y -1 si algo falló
+static int grow_run(uint32_t crash_at, uint32_t *ops)
+{
+    uint32_t ino;
+    if (fs_format_geometry(&grow_geo) != FS_SUCCESS || fs_create_file("g", FILE_TYPE_REGULAR) != FS_SUCCESS ||
+        fs_find_file("g", &ino) != FS_SUCCESS)
+        return -1;
+    fs_reset_stats();
+
+    hostdev_crash_after(crash_at);
+    int written = fs_write_file(ino, grow_data, GROW_BYTES, 0);
+    journal_commit();
+    fs_stats_t st;
+    fs_get_stats(&st);
+    *ops = st.ops;
+
+    fs_unmount();
+    int crashed = hostdev_crashed();
+    hostdev_crash_after(HOSTDEV_NO_CRASH);
+    if (written != (int)GROW_BYTES || fs_init() != FS_SUCCESS)
+        return -1;
+    int errors = fs_check();
+    if (errors != 0)
+    {
+        printf("grow: corte tras %u escrituras: fsck %d errores\n", crash_at, errors);
+        return -1;
+    }
+    return crashed;
+}
+
+static int test_grow(void)
+{
+    for (uint32_t i = 0; i < GROW_BYTES; i++)
+        grow_data[i] = (uint8_t)(i * 7 + i / 512);
+
+    uint32_t runs = 0, failed = 0, ops = 0;
+    for (uint32_t at = 0;; at++)
+    {
+        int r = grow_run(at, &ops);
+        runs++;
+        if (r < 0)
+            failed++;
+        if (r <= 0)
+            break;
+    }
+    printf("grow: %u cortes, %u operaciones por escritura, %u fallos\n", runs - 1, ops, failed);
+    return failed == 0 && ops > 1 ? 0 : -1;
+}
+
+// --- Altas y bajas en el índice del directorio ---
+static int test_churn(void)
+{
+    char name[MAX_FILENAME];
+    if (fs_format_geometry(&churn_geo) != FS_SUCCESS)
+        return -1;
+
+    // Siempre CHURN_LIVE vivos: cada vuelta borra el más antiguo y crea otro
+    uint32_t failed = 0;
+    for (uint32_t i = 0; i < CHURN_LIVE + CHURN_ROUNDS; i++)
+    {
+        if (i >= CHURN_LIVE)
+        {
+            test_name(name, "c", i - CHURN_LIVE);
+            failed += fs_delete_file(name) != FS_SUCCESS;
+        }
+        test_name(name, "c", i);
+        failed += fs_create_file(name, FILE_TYPE_REGULAR) != FS_SUCCESS;
+    }
+
+    dirhash_reset_stats();
+    uint32_t ino;
+    for (uint32_t i = 0; i < CHURN_MISSES; i++)
+    {
+        test_name(name, "x", i);
+        failed += fs_find_file(name, &ino) == FS_SUCCESS;
+    }
+    dirhash_stats_t ds;
+    dirhash_get_stats(&ds);
+    uint32_t avg = ds.lookups ? (ds.probes + ds.lookups - 1) / ds.lookups : 0;
+    if (avg > CHURN_MAX_AVG_PROBES)
+        failed++;
+    failed += fs_check() != 0;
+
+    printf("churn: %u altas y bajas, %u vivos; nombres inexistentes: %u entradas por busqueda "
+           "(maximo %u), %u fallos\n",
+           CHURN_ROUNDS, CHURN_LIVE, avg, ds.max_probes, failed);
+    return failed ? -1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "uso: %s imagen\n", argv[0]);
+        return 8;
+    }
+    uint64_t size = (uint64_t)wrap_geo.total_blocks * wrap_geo.block_size;
+    if ((uint64_t)ioerr_geo.total_blocks * ioerr_geo.block_size > size)
+        size = (uint64_t)ioerr_geo.total_blocks * ioerr_geo.block_size;
+    if ((uint64_t)grow_geo.total_blocks * grow_geo.block_size > size)
+        size = (uint64_t)grow_geo.total_blocks * grow_geo.block_size;
+    if ((uint64_t)churn_geo.total_blocks * churn_geo.block_size > size)
+        size = (uint64_t)churn_geo.total_blocks * churn_geo.block_size;
+    if (hostdev_open(argv[1], size) != 0)
+        return 8;
+
+    int failed = 0;
+    failed += test_wrap() != 0;
+    failed += test_ioerr() != 0;
+    failed += test_desc() != 0;
+    failed += test_grow() != 0;
+    failed += test_churn() != 0;
+
+    fs_unmount();
+    hostdev_close();
+    printf("fstest: %d pruebas fallaron\n", failed);
+    return failed ? 4 : 0;
+}
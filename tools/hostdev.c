@@ -0,0 +1,232 @@
+#define _DEFAULT_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "blkdev.h"
+#include "slab.h"
+#include "timer.h"
+#include "hostdev.h"
+
+// El sistema de archivos usa el primer dispositivo de la capa de bloques
+static blkdev_t hostdev_blk;
+
+static int hostdev_fd = -1;
+static uint64_t hostdev_bytes;
+static hostdev_stats_t hostdev_stats;
+static uint32_t hostdev_writes_left = HOSTDEV_NO_CRASH;
+static int hostdev_lost;
+static uint32_t hostdev_fail_left;
+
+// --- Dispositivo de bloques ---
+// Cada petición se hace en el momento con una sola llamada para todos sus
+// fragmentos, como un comando con PRDT, y se avisa antes de volver
+static int hostdev_submit(blkdev_t *dev, blk_request_t *req)
+{
+    (void)dev;
+    struct iovec vec[BLK_MAX_IOV];
+    size_t len = (size_t)req->count * BLK_SECTOR_SIZE;
+    for (uint32_t i = 0; i < req->iovcnt; i++)
+    {
+        vec[i].iov_base = req->iov[i].buf;
+        vec[i].iov_len = req->iov[i].bytes;
+    }
+
+    off_t off = (off_t)(req->lba * BLK_SECTOR_SIZE);
+    ssize_t done = -1;
+    if (req->write && hostdev_fail_left)
+        hostdev_fail_left--; // Error del disco: termina con -1 sin escribir
+    else if (req->write && hostdev_writes_left != HOSTDEV_NO_CRASH && hostdev_writes_left-- == 0)
+    {
+        // Tras el corte: la petición "termina" bien pero no se escribe nada
+        hostdev_writes_left = 0;
+        hostdev_lost = 1;
+        done = (ssize_t)len;
+    }
+    else if (hostdev_fd >= 0 && req->write)
+        done = pwritev(hostdev_fd, vec, (int)req->iovcnt, off);
+    else if (hostdev_fd >= 0)
+        done = preadv(hostdev_fd, vec, (int)req->iovcnt, off);
+
+    if (req->write)
+    {
+        hostdev_stats.writes++;
+        hostdev_stats.sectors_written += req->count;
+    }
+    else
+    {
+        hostdev_stats.reads++;
+        hostdev_stats.sectors_read += req->count;
+    }
+    blkdev_complete(req, done == (ssize_t)len ? 0 : -1);
+    return 0;
+}
+
+static const blkdev_ops_t hostdev_ops = {hostdev_submit, NULL, NULL};
+
+// --- Imagen ---
+int hostdev_open(const char *path, uint64_t size)
+{
+    int fd = open(path, size ? O_RDWR | O_CREAT : O_RDWR, 0644);
+    if (fd < 0)
+    {
+        perror(path);
+        return -1;
+    }
+    if (size && ftruncate(fd, (off_t)size) != 0)
+    {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+
+    off_t end = lseek(fd, 0, SEEK_END);
+    if (end < 0)
+    {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+
+    hostdev_close();
+    hostdev_fd = fd;
+    hostdev_bytes = (uint64_t)end;
+
+    // Se registra una vez; al reabrir solo cambia la capacidad
+    hostdev_blk.sectors = hostdev_bytes / BLK_SECTOR_SIZE;
+    if (!hostdev_blk.ops)
+    {
+        strncpy(hostdev_blk.name, "host0", BLK_NAME_LEN);
+        hostdev_blk.max_sectors = 2048;
+        hostdev_blk.max_iov = BLK_MAX_IOV;
+        hostdev_blk.max_inflight = 1;
+        hostdev_blk.align = 1;
+        hostdev_blk.ops = &hostdev_ops;
+        if (blkdev_register(&hostdev_blk) != 0)
+        {
+            hostdev_blk.ops = NULL;
+            hostdev_close();
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void hostdev_close(void)
+{
+    if (hostdev_fd >= 0)
+    {
+        fsync(hostdev_fd);
+        close(hostdev_fd);
+    }
+    hostdev_fd = -1;
+    hostdev_bytes = 0;
+}
+
+uint64_t hostdev_size(void)
+{
+    return hostdev_bytes;
+}
+
+void hostdev_get_stats(hostdev_stats_t *out)
+{
+    if (out)
+        *out = hostdev_stats;
+}
+
+void hostdev_reset_stats(void)
+{
+    memset(&hostdev_stats, 0, sizeof(hostdev_stats));
+}
+
+void hostdev_crash_after(uint32_t writes)
+{
+    hostdev_writes_left = writes;
+    hostdev_lost = 0;
+}
+
+int hostdev_crashed(void)
+{
+    return hostdev_lost;
+}
+
+void hostdev_fail_writes(uint32_t writes)
+{
+    hostdev_fail_left = writes;
+}
+
+uint64_t hostdev_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// --- Temporizador ---
+// Ticks a 100 Hz, como el PIT del kernel, derivados del reloj del host
+void pit_init(uint32_t hz)
+{
+    (void)hz;
+}
+
+uint64_t timer_ticks(void)
+{
+    return hostdev_now_ns() / 10000000ull;
+}
+
+uint64_t timer_now_us(void)
+{
+    return hostdev_now_ns() / 1000;
+}
+
+// --- Memoria del kernel ---
+// Las cachés de objetos y kmalloc sobre malloc: cada objeto sale ya con el
+// estado del constructor, que es lo que promete slab_alloc
+slab_cache_t *slab_cache_create(const char *name, uint32_t size, uint32_t align, slab_ctor_t ctor)
+{
+    (void)align;
+    slab_cache_t *c = calloc(1, sizeof(*c));
+    if (!c)
+        return NULL;
+    strncpy(c->name, name, SLAB_NAME_LEN - 1);
+    c->size = size;
+    c->ctor = ctor;
+    return c;
+}
+
+void *slab_alloc(slab_cache_t *cache)
+{
+    void *obj = malloc(cache->size);
+    if (obj && cache->ctor)
+        cache->ctor(obj);
+    if (obj)
+        cache->inuse++;
+    return obj;
+}
+
+void slab_free(slab_cache_t *cache, void *obj)
+{
+    if (!obj)
+        return;
+    cache->inuse--;
+    free(obj);
+}
+
+void *kmalloc(uint32_t size)
+{
+    return size ? malloc(size) : NULL;
+}
+
+void *kzalloc(uint32_t size)
+{
+    return size ? calloc(1, size) : NULL;
+}
+
+void kfree(void *ptr)
+{
+    free(ptr);
+}
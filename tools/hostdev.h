@@ -0,0 +1,43 @@
+#ifndef _HOSTDEV_H
+#define _HOSTDEV_H
+
+#include <stdint.h>
+
+// Dispositivo de bloques respaldado por un archivo del host ("host0"). Se
+// registra en la capa de bloques en lugar del driver AHCI para compilar el
+// sistema de archivos fuera del kernel: cada petición va al archivo con
+// preadv/pwritev.
+
+// Peticiones y sectores transferidos desde el último hostdev_reset_stats
+typedef struct
+{
+    uint64_t reads;           // Peticiones de lectura
+    uint64_t writes;          // Peticiones de escritura
+    uint64_t sectors_read;    // Sectores leídos
+    uint64_t sectors_written; // Sectores escritos
+} hostdev_stats_t;
+
+// Abre la imagen. Con size != 0 la crea o la deja exactamente de size bytes.
+int hostdev_open(const char *path, uint64_t size);
+void hostdev_close(void);
+uint64_t hostdev_size(void);
+
+void hostdev_get_stats(hostdev_stats_t *out);
+void hostdev_reset_stats(void);
+
+// Corte de corriente simulado: tras writes peticiones de escritura más, las
+// siguientes se dan por hechas sin llegar a la imagen, como si se hubieran
+// perdido en la caché del disco. HOSTDEV_NO_CRASH lo desactiva.
+#define HOSTDEV_NO_CRASH 0xFFFFFFFFu
+void hostdev_crash_after(uint32_t writes);
+// Alguna escritura se ha perdido desde hostdev_crash_after
+int hostdev_crashed(void);
+
+// Las siguientes writes peticiones de escritura terminan con error sin
+// llegar a la imagen
+void hostdev_fail_writes(uint32_t writes);
+
+// Tiempo monótono del host en nanosegundos (para medir)
+uint64_t hostdev_now_ns(void);
+
+#endif
@@ -0,0 +1,90 @@
+// mkfs: crea un volumen en una imagen con la geometría indicada
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "fs.h"
+#include "hostdev.h"
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "uso: %s [-b tam_bloque] [-n bloques] [-i inodos] [-j bloques_diario] imagen\n"
+            "  -b  bytes por bloque, potencia de 2 entre %d y %d (por defecto %d)\n"
+            "  -n  bloques del volumen (por defecto, los que quepan en la imagen\n"
+            "      existente o %d)\n"
+            "  -i  inodos, incluido el del directorio raiz (por defecto %d)\n"
+            "  -j  bloques del diario, 0 = sin diario (por defecto %d)\n",
+            prog, FS_MIN_BLOCK_SIZE, FS_MAX_BLOCK_SIZE, FS_DEFAULT_BLOCK_SIZE,
+            FS_DEFAULT_BLOCKS, FS_DEFAULT_INODES, FS_DEFAULT_JOURNAL_BLOCKS);
+    exit(2);
+}
+
+static uint32_t parse_u32(const char *s, const char *prog)
+{
+    char *end;
+    unsigned long v = strtoul(s, &end, 0);
+    if (*s == '\0' || *end != '\0' || v > 0xFFFFFFFFul)
+        usage(prog);
+    return (uint32_t)v;
+}
+
+int main(int argc, char **argv)
+{
+    fs_geometry_t geo = {FS_DEFAULT_BLOCK_SIZE, 0, FS_DEFAULT_INODES, FS_DEFAULT_JOURNAL_BLOCKS};
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:n:i:j:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'b':
+            geo.block_size = parse_u32(optarg, argv[0]);
+            break;
+        case 'n':
+            geo.total_blocks = parse_u32(optarg, argv[0]);
+            break;
+        case 'i':
+            geo.total_inodes = parse_u32(optarg, argv[0]);
+            break;
+        case 'j':
+            geo.journal_blocks = parse_u32(optarg, argv[0]);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1 || geo.block_size == 0)
+        usage(argv[0]);
+    const char *path = argv[optind];
+
+    // Sin -n se usa la imagen tal como está, si existe
+    if (geo.total_blocks == 0)
+    {
+        if (access(path, F_OK) == 0 && hostdev_open(path, 0) == 0)
+        {
+            geo.total_blocks = (uint32_t)(hostdev_size() / geo.block_size);
+            hostdev_close();
+        }
+        if (geo.total_blocks == 0)
+            geo.total_blocks = FS_DEFAULT_BLOCKS;
+    }
+
+    if (hostdev_open(path, (uint64_t)geo.total_blocks * geo.block_size) != 0)
+        return 8;
+
+    int ret = fs_format_geometry(&geo);
+    if (ret == FS_SUCCESS)
+        ret = fs_unmount();
+    hostdev_close();
+    if (ret != FS_SUCCESS)
+    {
+        fprintf(stderr, "%s: no se pudo formatear %s (%d)\n", argv[0], path, ret);
+        return 8;
+    }
+
+    printf("%s: %u bloques de %u bytes, %u inodos, diario de %u bloques\n", path,
+           geo.total_blocks, geo.block_size, geo.total_inodes, geo.journal_blocks);
+    return 0;
+}